@@ -32,7 +32,7 @@ cd ..
 echo "==> Building galib_tester..."
 
 # Compile galib_tester.cpp linking with GALib
-g++ -std=c++98 -I. -L./ga galib_tester.cpp -lga -o galib_tester
+g++ -std=c++98 -pthread -I. -L./ga galib_tester.cpp -lga -o galib_tester
 
 # Check if executable was created
 if [ ! -f galib_tester ]; then
@@ -74,6 +74,8 @@ public:
 #endif
 
   virtual int equal(const GAGenome & c) const ;
+  virtual int saveContents(GASnapshot &) const;
+  virtual int loadContents(GASnapshot &);
 
   const T & gene(unsigned int x=0) const {return this->a[x];}
   T & gene(unsigned int x, const T & value){
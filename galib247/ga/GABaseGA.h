@@ -48,6 +48,8 @@
 #define gaSNflushFrequency       "ffreq"
 #define gaNscoreFilename         "score_filename"
 #define gaSNscoreFilename        "sfile"
+#define gaNscoreFormat           "score_format"
+#define gaSNscoreFormat          "sfmt"
 #define gaNselectScores          "select_scores"
 #define gaSNselectScores         "sscores"
 #define gaNelitism               "elitism"
@@ -107,6 +109,23 @@ evolve
   This method is provided as a convenience so that you don't have to increment
 the GA generation-by-generation by hand.  If you do decide to do it by hand,
 be sure that you initialize before you start evolving!
+
+save, load
+  Put the state of the GA into a snapshot or restore it from one.  The state
+is the parameters, the population (genomes and their scores), the statistics
+and the random number generator, so a GA that loads a snapshot and then steps
+makes exactly the same generations that the saved GA would have made.  Load
+instead of initialize, into a GA of the same class that was set up the same
+way (same genome type, operators, objective function, scaling and selection).
+Parameters set after the load override the saved ones, so you can (for
+example) give a resumed run more generations.  Each derived GA adds its own
+state in saveState/loadState.  The genomes must support save/load (see
+GAGenome).  save does not touch the disk, so it can be followed by a write from
+another thread while the GA goes on with the next generation.
+
+checkpoint, resume
+  Convenience versions of save and load that go straight to or from a file.
+The file is replaced atomically (see GASnapshot).
 ---------------------------------------------------------------------------- */
 class GAGeneticAlgorithm : public GAID {
 public:
@@ -137,6 +156,11 @@ public:
     while(!done()){step();} 
     if(stats.flushFrequency() > 0) stats.flushScores();
   }
+  int save(GASnapshot &) const;
+  int load(GASnapshot &);
+  int checkpoint(const char* filename) const;
+  int resume(const char* filename);
+
 #ifdef GALIB_USE_STREAMS
   virtual int write(const char*) const {return 0;}
   virtual int write(STD_OSTREAM &) const {return 0;}
@@ -206,6 +230,9 @@ public:
   const char* scoreFilename() const {return stats.scoreFilename();}
   const char* scoreFilename(const char* fn)
     {params.set(gaNscoreFilename, fn); return stats.scoreFilename(fn);}
+  int scoreFormat() const {return stats.scoreFormat();}
+  int scoreFormat(int f)
+    {params.set(gaNscoreFormat, f); return stats.scoreFormat(f);}
   int selectScores(){return stats.selectScores();}
   int selectScores(int w)
     {params.set(gaNselectScores, w); return stats.selectScores(w);}
@@ -248,6 +275,9 @@ protected:
   int minmax;
   GAGenome::SexualCrossover scross;	// sexual crossover to use
   GAGenome::AsexualCrossover across;	// asexual crossover to use
+
+  virtual int saveState(GASnapshot &) const;
+  virtual int loadState(GASnapshot &);
 };
 
 #endif
@@ -93,6 +93,9 @@ protected:
   GAPopulation* tmppop;		// temp pop for doing the evolutions
   GAStatistics* pstats;		// statistics for each population
   unsigned int nmig;		// number to migrate from each population
+
+  virtual int saveState(GASnapshot &) const;
+  virtual int loadState(GASnapshot &);
 };
 
 #ifdef GALIB_USE_STREAMS
@@ -22,6 +22,7 @@ it should operate on the data.  See comments below for further details.
 
 class GAGeneticAlgorithm;
 class GAGenome;
+class GASnapshot;
 
 
 /* ----------------------------------------------------------------------------
@@ -46,6 +47,11 @@ selected to cross with itself, and self-copying is not out of the question)
        virtual int read(istream&)
        virtual int write(ostream&) const
        virtual int equal(const GAGenome&) const
+
+  If you want to checkpoint a GA that uses your genome, also define:
+
+       virtual int saveContents(GASnapshot&) const
+       virtual int loadContents(GASnapshot&)
   
     When you derive a genome, don't forget to use the _evaluated flag to 
   indicate when the state of the genome has changed and an evaluation is 
@@ -107,6 +113,11 @@ crossover
 evaluator
   Set the genome's objective function.  This also sets marks the evaluated
   flag to indicate that the genome must be re-evaluated.
+
+evaluated
+  Whether the genome has a score that is up to date (from its objective
+  function, or one given with score(float)).  A population evaluator can use
+  this to find the genomes that changed since the last evaluation.
     Evaluation happens on-demand - the objective score is not calculated until
   it is requested.  Then it is cached so that it does not need to be re-
   calculated each time it is requested.  This means that any member function
@@ -171,6 +182,16 @@ clone(attr)
   Clone the attributes of the genome.  This method does nothing to the
   contents of the genome.  It does NOT call the initialization method.  For
   some data types this is the same thing as cloning the contents.
+
+save, load
+  Put the genome into a snapshot or get it back out of one.  The base class
+  takes care of the score, fitness, evaluated flag and evaluation count, and
+  calls saveContents/loadContents for whatever the derived class holds.  Only
+  the contents go into the snapshot - operators, user data and eval data are
+  what the genome was created with, so they must be set up the same way in the
+  program that loads the snapshot.  A loaded genome keeps its saved score, so
+  it is not evaluated again.  The default saveContents/loadContents post an
+  error and return 1 (genomes that do not define them cannot be checkpointed).
 ---------------------------------------------------------------------------- */
 class GAGenome : public GAID {
 public:
@@ -217,6 +238,13 @@ public:
   virtual int notequal(const GAGenome & g) const
     { return (equal(g) ? 0 : 1); }
 
+  int save(GASnapshot &) const;
+  int load(GASnapshot &);
+  virtual int saveContents(GASnapshot &) const
+    { GAErr(GA_LOC, className(), "saveContents", gaErrOpUndef); return 1; }
+  virtual int loadContents(GASnapshot &)
+    { GAErr(GA_LOC, className(), "loadContents", gaErrOpUndef); return 1; }
+
 public:
   int nevals() const {return _neval;}
   float score() const { evaluate(); return _score; }
@@ -235,6 +263,7 @@ public:
     {delete evd; evd = o.clone(); return evd;}
 
   float evaluate(GABoolean flag = gaFalse) const;
+  GABoolean evaluated() const {return _evaluated;}
   Evaluator evaluator() const {return eval;}
   Evaluator evaluator(Evaluator f) { _evaluated=gaFalse; return(eval=f); }
 
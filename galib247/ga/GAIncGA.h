@@ -80,6 +80,9 @@ protected:
   ReplacementScheme rs;	// replacement strategy
   ReplacementFunction rf;	// (optional) replacement function
   unsigned int noffspr;		// number of children to generate in crossover
+
+  virtual int saveState(GASnapshot &) const;
+  virtual int loadState(GASnapshot &);
 };
 
 
@@ -27,6 +27,12 @@ track of the fitness statistics for the genomes in the population.
 #undef min
 #endif
 
+// The sort works on these rather than on the genomes themselves.
+struct GAPopulationRank {
+  float score;
+  GAGenome* genome;
+};
+
 
 /* ----------------------------------------------------------------------------
 size
@@ -43,6 +49,13 @@ sort
 does not change the logical state of the population, but it does change its
 physical state.  We sort from best (0th individual) to worst (n-1).  The sort
 figures out whether high is best or low is best.
+  The sort works on an array of (score, genome) pairs, so each score is 
+fetched only once.  The individuals that are still in order are kept as they
+are and only the others are sorted and merged back in, so after a steady-state
+or incremental GA replaces a few individuals the sort is linear rather than 
+n log n.  If you only need the best few individuals, use top (best does this
+for you).  It puts the best k individuals in order at the front of the
+population without sorting the rest.
 
 evaluate
   If you want to force an evaluation, pass gaTrue to the evaluate member
@@ -62,6 +75,25 @@ diversity
 function can be particularly expensive, especially for large populations.  So
 we store the values and update them only as needed.  The population diversity
 measure is the average of the individual measures (less the diagonal scores).
+  The rows of the diversity matrix belong to genomes, not to positions, so 
+sorting does not cost any comparisons and add/remove/replace only cost the 
+rows of the genomes that came in.  If you change the contents of a genome 
+while it is in the population (rather than replacing it), then touch the 
+population so that it knows to recompute everything.  GASimpleGA does that
+every generation (it breeds into the genomes of its other population), so 
+only the steady-state and incremental GAs get the incremental rows; with 
+GASimpleGA the threads are what helps.
+  Use diversityThreads to spread the comparisons across threads (this requires
+a comparator that is safe to call concurrently, which the built-in ones are).
+Use diversitySamples to estimate the population diversity from that many
+random pairs rather than from the whole matrix.  This is for populations that
+are too big for an n*n matrix.  In that case div(i,j) is computed on demand.
+
+save, load
+  Put the whole population (genomes, scores, sort orders and statistics) into
+a snapshot or get it back out.  Loading resizes the population to the saved
+size, and the genomes must be of a type that can be saved (see GAGenome).  The
+operators (initializer, evaluator, scaling, selector) are not saved.
 ---------------------------------------------------------------------------- */
 class GAPopulation : public GAID {
 public:
@@ -86,6 +118,8 @@ public:
   virtual ~GAPopulation();
   virtual GAPopulation * clone() const {return new GAPopulation(*this);}
   virtual void copy(const GAPopulation & arg);
+  int save(GASnapshot &) const;
+  int load(GASnapshot &);
 
   int size() const { return n; }
   int size(unsigned int popsize);
@@ -93,13 +127,16 @@ public:
   int chunksize(unsigned int csize) { return csz=csize; }
   int compact();
 
-  void touch() 
-    { rsorted=ssorted=selectready=divved=statted=scaled=evaluated=gaFalse; }
+  void touch() {
+    rsorted=ssorted=selectready=divved=statted=scaled=evaluated=gaFalse;
+    rtop=stop=ndiv=0;
+  }
   void statistics(GABoolean flag=gaFalse) const;
   void diversity(GABoolean flag=gaFalse) const;
   void scale(GABoolean flag=gaFalse) const;
   void prepselect(GABoolean flag=gaFalse) const;
   void sort(GABoolean flag=gaFalse, SortBasis basis=RAW) const;
+  void top(unsigned int k, SortBasis basis=RAW) const;
 
   float sum() const {if(!statted) statistics(); return rawSum;}
   float ave() const {if(!statted) statistics(); return rawAve;}
@@ -108,8 +145,11 @@ public:
   float max() const {if(!statted) statistics(); return rawMax;}
   float min() const {if(!statted) statistics(); return rawMin;}
   float div() const {if(!divved)  diversity();  return popDiv;}
-  float div(unsigned int i, unsigned int j) const 
-    {if(!divved) diversity(); return indDiv[i*n+j];}
+  float div(unsigned int i, unsigned int j) const;
+  int diversityThreads() const { return divthr; }
+  int diversityThreads(unsigned int t) { return divthr=(t < 1 ? 1 : t); }
+  int diversitySamples() const { return divsmp; }
+  int diversitySamples(unsigned int s) { divved=gaFalse; return divsmp=s; }
   float fitsum() const {if(!scaled) scale(); return fitSum;}
   float fitave() const {if(!scaled) scale(); return fitAve;}
   float fitmax() const {if(!scaled) scale(); return fitMax;}
@@ -122,6 +162,7 @@ public:
     if(evaluated == gaFalse || flag == gaTrue){
       (*eval)(*this); neval++;
       scaled = statted = divved = rsorted = ssorted = gaFalse;
+      rtop = stop = 0;
     }
     evaluated = gaTrue;
   }
@@ -154,7 +195,7 @@ public:
 
   GAGenome& best(unsigned int i=0, SortBasis basis=RAW) const {
     if(basis == SCALED) scale();
-    sort(gaFalse, basis);
+    top(i+1, basis);
     return ((basis == RAW) ? *(rind[i]) : *(sind[i])); 
   }
   GAGenome& worst(unsigned int i=0, SortBasis basis=RAW) const {
@@ -185,6 +226,7 @@ protected:
   SortOrder sortorder;		// is best a high score or a low score?
   GABoolean rsorted;		// are the individuals sorted? (raw)
   GABoolean ssorted;		// are the individuals sorted? (scaled)
+  unsigned int rtop, stop;	// how many at the front are in order if not
   GABoolean scaled;		// has the population been scaled?
   GABoolean statted;		// are the stats valid?
   GABoolean evaluated;		// has the population been evaluated?
@@ -195,8 +237,14 @@ protected:
   float rawVar, rawDev;		// variance, standard deviation
   float popDiv;			// overall population diversity [0,)
   float* indDiv;		// table for genome similarities (diversity)
+  GAGenome** dind;		// genome that owns each row of the table
+  unsigned int ndiv;		// how many rows in the table are valid
+  unsigned int divthr;		// threads to use for diversity comparisons
+  unsigned int divsmp;		// pairs to sample for diversity (0 means all)
   GAGenome** rind;		// the individuals of the population (raw)
   GAGenome** sind;		// the individuals of the population (scaled)
+  GAPopulationRank* rank;	// (score, genome) pairs for sorting
+  unsigned int nrank;		// how many pairs are allocated
   float fitSum, fitAve;		// sum, ave of the population's fitness scores
   float fitMax, fitMin;		// max, min of the population's fitness scores
   float fitVar, fitDev;		// variance, standard deviation of fitness
@@ -209,11 +257,13 @@ protected:
   GAEvalData* evaldata;		// data for evaluator to use (optional)
 
   int grow(unsigned int);
+  void dropdiv(const GAGenome*);
+  void CompareRows(float*, const unsigned int*, unsigned int, const int*) const;
+
+  static void MatchRows(GAGenome* const*, unsigned int,
+			GAGenome* const*, unsigned int, int*);
 
-  static void QuickSortAscendingRaw(GAGenome**, int, int);
-  static void QuickSortDescendingRaw(GAGenome**, int, int);
-  static void QuickSortAscendingScaled(GAGenome**, int, int);
-  static void QuickSortDescendingScaled(GAGenome**, int, int);
+  GAPopulationRank* ranks() const;
 };
 
 
@@ -59,6 +59,9 @@ protected:
   float pRepl;			// percentage of population to replace each gen
   unsigned int nRepl;		// how many of each population to replace
   short which;			// 0 if prepl, 1 if nrepl
+
+  virtual int saveState(GASnapshot &) const;
+  virtual int loadState(GASnapshot &);
 };
 
 
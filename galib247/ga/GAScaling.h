@@ -24,6 +24,7 @@ it does know how to update itself, but it must be told when.
 #include <ga/gaid.h>
 #include <ga/gatypes.h>
 #include <ga/GAGenome.h>
+#include <math.h>
 
 class GAPopulation;
 
@@ -230,27 +231,67 @@ then it bases its min/max on the sort order of the population.
     GA::MAXIMIZE - scale by dividing the raw scores
     0            - minimize or maximize based upon the GA's settings
 
+  The derating is applied to the raw score minus the offset (0 by default).
+Fitness-proportional selectors need fitness values that are all of one sign,
+so if the objective can return negative scores set the offset to its lowest
+possible score.
+
+  If you do not give the sharing object a distance function, it uses the
+population's diversity table (and therefore the genomes' comparators).  That 
+table is kept from one generation to the next, so only the distances of new
+genomes are calculated (in parallel if the population has diversity threads).
+If you need a distance that differs from the comparator, pass it as the 
+distance function and the sharing object will compute its own table each time.
+  For big populations you can give the sharing object a bucket function that
+puts each genome in up to MAX_BUCKETS buckets (it writes their keys and
+returns how many).  A genome it gives no keys goes into a common bucket with
+the other genomes without keys.  Only genomes that share a bucket are compared, so no n*n
+table is needed.  The result is exact if any two genomes less than sigma
+apart share a bucket.  Banding does that for a distance that counts the
+positions that differ: with B bands, two genomes that differ in fewer than B
+positions agree on a whole band, so one key per band (a hash of the band and
+its contents) with B = ceil(sigma*positions) is exact.  Keys that don't
+promise this give an approximation in the style of locality-sensitive
+hashing.  The distances are remembered from one evaluation to the next by
+the keys of the two genomes, so the keys must determine the distance (bands
+that together cover the genome do): only pairs with new keys are compared,
+in parallel if the population has diversity threads.  Pairs with a genome in
+the common bucket are compared every time.
+
 *** This should be called TriangularSharing rather than simply Sharing.
 ---------------------------------------------------------------------------- */
 #if USE_SHARING == 1
+struct GASharingPair {			// a distance by the keys of its genomes
+  unsigned long a, b;			// a <= b
+  float d;
+};
+
 class GASharing : public GAScalingScheme {
 public:
   GADefineIdentity("GASharing", GAID::Sharing);
 
+  enum { MAX_BUCKETS = 32 };
+  typedef int (*Bucketer)(const GAGenome &, float sigma, unsigned long * keys);
+
   GASharing(GAGenome::Comparator func, 
 	    float cut=gaDefSharingCutoff, float a=1.0)
-    { N=0; d=(float*)0; df=func; _sigma = cut; _alpha = a; _minmax = 0; }
+    { N=0; d=(float*)0; df=func; bf=0; pc=(GASharingPair*)0; npc=0;
+      _sigma = cut; _alpha = a; _minmax = 0; _offset = 0.0; }
   GASharing(float cut=gaDefSharingCutoff, float a=1.0)
-    { N=0; d=(float*)0; df=0; _sigma = cut; _alpha = a; _minmax = 0; }
-  GASharing(const GASharing & arg) { N=0; d=(float*)0; copy(arg); }
+    { N=0; d=(float*)0; df=0; bf=0; pc=(GASharingPair*)0; npc=0;
+      _sigma = cut; _alpha = a; _minmax = 0; _offset = 0.0; }
+  GASharing(const GASharing & arg)
+    { N=0; d=(float*)0; pc=(GASharingPair*)0; npc=0; copy(arg); }
   GASharing & operator=(const GAScalingScheme & arg){copy(arg); return(*this);}
-  virtual ~GASharing(){ delete [] d;}
+  virtual ~GASharing(){ delete [] d; delete [] pc; }
   virtual GAScalingScheme * clone() const {return new GASharing(*this);}
   virtual void copy(const GAScalingScheme & arg);
   virtual void evaluate(const GAPopulation & p);
 
   GAGenome::Comparator distanceFunction(GAGenome::Comparator f){return df=f;}
   GAGenome::Comparator distanceFunction() const {return df;}
+  Bucketer bucketFunction(Bucketer f){return bf=f;}
+  Bucketer bucketFunction() const {return bf;}
 
   float sigma(float);
   float sigma() const { return _sigma; }
@@ -258,16 +299,29 @@ public:
   float alpha(float c) { return _alpha = c; }
   float alpha() const { return _alpha; }
 
+  float offset(float c) { return _offset = c; }
+  float offset() const { return _offset; }
+
   int minimaxi(int i);
   int minimaxi() const { return _minmax; }
 
 protected:
   GAGenome::Comparator df;		// the user-defined distance function
+  Bucketer bf;				// the user-defined niche keys (optional)
+  GASharingPair* pc;			// bucketed distances of the last evaluation
+  unsigned int npc;			// (sorted by keys)
   unsigned int N;			// how many do we have? (n of n-by-n)
   float *d;				// the distances for each genome pair
   float _sigma;				// absolute cutoff from central point
   float _alpha;				// controls the curvature of sharing f
   int _minmax;				// should we minimize or maximize?
+  float _offset;			// subtracted from the scores before derating
+
+  double share(float dist) const {
+    if(dist >= _sigma) return 0.0;
+    return (_alpha == 1) ? 1.0 - dist/_sigma : 1.0 - pow(dist/_sigma, _alpha);
+  }
+  void bucketed(const GAPopulation & p, double * sum);
 };
 #endif
 
@@ -0,0 +1,98 @@
+// $Header$
+/* ----------------------------------------------------------------------------
+  scorelog.h
+
+ DESCRIPTION:
+  Binary score log for the statistics object.  The statistics object collects
+the scores of each generation in columns (one array per measure), and when it
+flushes them it hands the whole block to the log.  The log copies the block
+into a buffer and puts it on a queue.  A background thread takes blocks off
+the queue and writes them to the file, so the GA never waits on the disk
+unless the queue is full (the queue is bounded so that a slow disk cannot eat
+all of the memory).  Without threads the blocks are written right away.
+
+  The file is a 16 byte header followed by any number of blocks:
+
+    header:  char[4] "GASL", uint32 version, uint32 0x01020304, uint32 0
+    block:   uint32 rows, uint32 columns,
+             int32 generation[rows],
+             float mean[rows]           if columns & GAStatistics::Mean
+             float maximum[rows]        if columns & GAStatistics::Maximum
+             float minimum[rows]        if columns & GAStatistics::Minimum
+             float deviation[rows]      if columns & GAStatistics::Deviation
+             float diversity[rows]      if columns & GAStatistics::Diversity
+             float best[rows]           if columns & GAStatistics::Best
+             double evaluations[rows]   if columns & GAStatistics::Evaluations
+
+Everything is in the byte order of the machine that wrote it.  The third word
+of the header tells the reader whether that matches its own.  Each block says
+which columns it has, so appending with a different selection is fine.
+
+  Use the reader to get the rows back one at a time (the scorelog tool uses it
+to print a summary or to export the log as CSV).
+---------------------------------------------------------------------------- */
+#ifndef _ga_scorelog_h_
+#define _ga_scorelog_h_
+
+#include <stdio.h>
+#include <ga/gaconfig.h>
+#include <ga/gatypes.h>
+
+struct GAScoreLogQueue;
+
+class GAScoreLog {
+public:
+  enum { MEAN, MAXIMUM, MINIMUM, DEVIATION, DIVERSITY, BEST, NCOLUMNS };
+
+  GAScoreLog(const char* filename, GABoolean append=gaFalse,
+	     unsigned int depth=4);
+  virtual ~GAScoreLog();
+
+  GABoolean good() const { return (fp ? gaTrue : gaFalse); }
+  unsigned int depth() const { return maxq; }
+  void post(unsigned int rows, int columns, const int* gen,
+	    const float* const* col, const unsigned long* evals);
+  void flush();
+
+protected:
+  FILE* fp;			// the log file
+  unsigned int maxq;		// most blocks that may wait to be written
+  GAScoreLogQueue* q;		// blocks waiting for the writer thread
+
+private:
+  GAScoreLog(const GAScoreLog&);
+  GAScoreLog& operator=(const GAScoreLog&);
+};
+
+
+// One generation's worth of scores as it comes out of the reader.  Columns
+// that are not in the block are set to 0 (and are not in 'columns').
+struct GAScoreRow {
+  int columns;
+  int gen;
+  float col[GAScoreLog::NCOLUMNS];
+  double evals;
+};
+
+class GAScoreLogReader {
+public:
+  GAScoreLogReader(const char* filename);
+  virtual ~GAScoreLogReader();
+
+  GABoolean good() const { return (fp ? gaTrue : gaFalse); }
+  GABoolean next(GAScoreRow&);
+
+protected:
+  FILE* fp;
+  GABoolean swap;		// written on a machine with other byte order?
+  unsigned int rows, row;	// size of the current block, next row in it
+  int columns;			// columns in the current block
+  char* buf;			// the current block
+  unsigned int nbuf;
+
+private:
+  GAScoreLogReader(const GAScoreLogReader&);
+  GAScoreLogReader& operator=(const GAScoreLogReader&);
+};
+
+#endif
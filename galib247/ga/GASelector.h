@@ -25,6 +25,9 @@ RouletteWheel - weighted selection where individuals with better fitness have
                 scores.
    Tournament - similar to roulette, but instead of choosing one, choose two
                 then pick the better of the two as the selected individuals
+        Alias - the same fitness-proportional probabilities as the roulette
+                wheel, but using Walker's alias method.  No sorting, O(n)
+                update and O(1) for each selection.
       Uniform - stochastic uniform selection picks randomly from the 
                 population.  Each individual has as much chance as any other.
           SRS - stochastic remainder selection does a preselection based on 
@@ -98,7 +101,7 @@ public:
    Roulette wheel uses a fitness-proportional algorithm for selecting 
 individuals.
 ---------------------------------------------------------------------------- */
-#if USE_ROULETTE_SELECTOR == 1 || USE_TOURNAMENT_SELECTOR == 1
+#if USE_ROULETTE_SELECTOR == 1
 class GARouletteWheelSelector : public GASelectionScheme {
 public:
   GADefineIdentity("GARouletteWheelSelector", GAID::RouletteWheelSelection);
@@ -133,17 +136,61 @@ protected:
 
   
 /* ----------------------------------------------------------------------------
-   This version of the tournament selector does two roulette wheel selections
-then picks the better of the two.  We derive from the roulette wheel class so
-that we can use its update method.
+   The alias selector picks individuals with exactly the same probabilities as
+the roulette wheel, but it does not need a sorted population.  The update
+builds Walker's alias tables (using Vose's construction) in O(n) and each 
+selection then costs one random integer and one random float.  Use this one 
+instead of the roulette wheel when the population is large.
+---------------------------------------------------------------------------- */
+#if USE_ALIAS_SELECTOR == 1 || USE_TOURNAMENT_SELECTOR == 1
+class GAAliasSelector : public GASelectionScheme {
+public:
+  GADefineIdentity("GAAliasSelector", GAID::AliasSelection);
+
+  GAAliasSelector(int w=GASelectionScheme::SCALED) : GASelectionScheme(w)
+    { prob = (float*)0; alias = (int*)0; n = 0; }
+  GAAliasSelector(const GAAliasSelector& orig)
+    { prob = (float*)0; alias = (int*)0; n = 0; copy(orig); }
+  GAAliasSelector& operator=(const GASelectionScheme& orig) 
+    { if(&orig != this) copy(orig); return *this; }
+  virtual ~GAAliasSelector() { delete [] prob; delete [] alias; }
+  virtual GASelectionScheme* clone() const { return new GAAliasSelector; }
+  virtual void copy(const GASelectionScheme& orig) {
+    GASelectionScheme::copy(orig);
+    const GAAliasSelector& sel = DYN_CAST(const GAAliasSelector&, orig);
+    delete [] prob;  delete [] alias;
+    n = sel.n; 
+    prob = new float [n];
+    alias = new int [n];
+    memcpy(prob, sel.prob, n * sizeof(float));
+    memcpy(alias, sel.alias, n * sizeof(int));
+  }
+  virtual GAGenome& select() const;
+  virtual void update();
+
+protected:
+  int n;
+  float* prob;			// chance of keeping the index of each column
+  int* alias;			// index to use when the column is rejected
+
+  int pick() const;
+};
+#endif
+
+  
+/* ----------------------------------------------------------------------------
+   This version of the tournament selector does two fitness-proportional 
+selections then picks the better of the two.  We derive from the alias 
+selector so that we can use its update method (and so that each of the two
+picks is O(1) and the population never has to be sorted).
 ---------------------------------------------------------------------------- */
 #if USE_TOURNAMENT_SELECTOR == 1
-class GATournamentSelector : public GARouletteWheelSelector {
+class GATournamentSelector : public GAAliasSelector {
 public:
   GADefineIdentity("GATournamentSelector", GAID::TournamentSelection);
 
   GATournamentSelector(int w=GASelectionScheme::SCALED) : 
-  GARouletteWheelSelector(w) {}
+  GAAliasSelector(w) {}
   GATournamentSelector(const GATournamentSelector& orig) { copy(orig); }
   GATournamentSelector& operator=(const GASelectionScheme& orig) 
     { if(&orig != this) copy(orig); return *this; }
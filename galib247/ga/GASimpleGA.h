@@ -56,6 +56,9 @@ public:
 protected:
   GAPopulation *oldPop;		// current and old populations
   GABoolean el;			// are we elitist?
+
+  virtual int saveState(GASnapshot &) const;
+  virtual int loadState(GASnapshot &);
 };
 
 
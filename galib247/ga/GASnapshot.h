@@ -0,0 +1,77 @@
+// $Header$
+/* ----------------------------------------------------------------------------
+  snapshot.h
+
+ DESCRIPTION:
+  A snapshot is a byte buffer that the GA, its population, its statistics and
+its genomes write themselves into (save) and read themselves back out of
+(load).  It is how we checkpoint a GA so that a long run can be picked up again
+after it was stopped.  The GA does not know anything about files while it
+saves; the buffer is written to disk afterwards (possibly by another thread),
+so the only time the GA has to wait is the time it takes to copy its state.
+
+  Values go into the buffer as raw bytes in the byte order of the machine that
+wrote them.  The file is a 20 byte header, the buffer, then a checksum:
+
+    header:  char[4] "GASN", uint32 version, uint32 0x01020304,
+             uint32 0, uint32 size
+    data:    char[size]
+    trailer: uint32 checksum (FNV-1a of the data)
+
+The file is first written with a temporary name then renamed to the real name,
+so a run that is killed while it writes a checkpoint leaves the previous one
+alone.  A snapshot from a machine with a different byte order (or a file that
+was cut short) is refused when it is read.
+
+  The get functions do not complain when they run off the end of the buffer;
+they return 0 and clear the good flag, so check good() after a load.
+---------------------------------------------------------------------------- */
+#ifndef _ga_snapshot_h_
+#define _ga_snapshot_h_
+
+#include <ga/gaconfig.h>
+#include <ga/gatypes.h>
+
+class GASnapshot {
+public:
+  GASnapshot();
+  GASnapshot(const GASnapshot&);
+  GASnapshot& operator=(const GASnapshot&);
+  virtual ~GASnapshot();
+
+  void clear() { n = pos = 0; ok = gaTrue; }
+  void rewind() { pos = 0; ok = gaTrue; }
+  GABoolean good() const { return ok; }
+  GABoolean done() const { return (pos >= n ? gaTrue : gaFalse); }
+  const char* data() const { return buf; }
+  unsigned int size() const { return n; }
+
+  void put(const void* x, unsigned int size);
+  void put(int x) { put(&x, sizeof(int)); }
+  void put(unsigned int x) { put(&x, sizeof(unsigned int)); }
+  void put(float x) { put(&x, sizeof(float)); }
+  void put(double x) { put(&x, sizeof(double)); }
+  void put(unsigned long x);
+  void put(const char* str);
+
+  GABoolean get(void* x, unsigned int size);
+  int getInt() { int x=0; get(&x, sizeof(int)); return x; }
+  unsigned int getUInt() { unsigned int x=0; get(&x, sizeof(x)); return x; }
+  float getFloat() { float x=0.0; get(&x, sizeof(float)); return x; }
+  double getDouble() { double x=0.0; get(&x, sizeof(double)); return x; }
+  unsigned long getULong();
+  char* getString();		// caller must delete [] what comes back
+
+  int write(const char* filename) const;
+  int read(const char* filename);
+
+protected:
+  char* buf;			// the contents of the snapshot
+  unsigned int n, N;		// how many bytes are used, allocated
+  unsigned int pos;		// where the next get reads from
+  GABoolean ok;			// did every get find what it wanted?
+
+  void copy(const GASnapshot&);
+};
+
+#endif
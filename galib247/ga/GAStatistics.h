@@ -16,6 +16,8 @@
 #include <ga/GAGenome.h>
 #include <ga/GAPopulation.h>
 
+class GAScoreLog;
+
 
 
 // Default settings and their names.
@@ -24,6 +26,7 @@ extern int  gaDefScoreFrequency1;
 extern int  gaDefScoreFrequency2;
 extern int  gaDefFlushFrequency;
 extern char gaDefScoreFilename[];
+extern int  gaDefScoreFormat;
 
 
 
@@ -34,6 +37,18 @@ Statistics class
 Whereas the parameters object keeps track of the user-definable settings for 
 the GA, the statistics object keeps track of the data that the GA generates 
 along the way.
+  The scores are written to the score file every flushFrequency generations.
+With the TextScores format each flush appends a row of text per generation.
+With BinaryScores each flush hands the block of scores to a GAScoreLog, which
+writes it from a background thread (see GAScoreLog.h for the file format and
+the reader).  Best is the maximum or the minimum depending on the sort order
+of the population, Evaluations is the number of genome evaluations so far.
+  save and load put the counters, the convergence history, the scores that
+have not been flushed yet and the best-of-all population into a snapshot (the
+GA does this when it checkpoints).  The settings (score file, frequencies,
+which scores) are not in the snapshot - they are whatever the program sets.
+If the run went on past the checkpoint, the generations after it will be in
+the score file twice once the resumed run writes them again.
 ---------------------------------------------------------------------------- */
 class GAStatistics {
 public:
@@ -44,14 +59,19 @@ public:
     Minimum=0x04,
     Deviation=0x08,
     Diversity=0x10,
+    Best=0x20,
+    Evaluations=0x40,
     AllScores=0xff
     };
+  enum ScoreFormat { TextScores=0, BinaryScores=1 };
   
   GAStatistics();
   GAStatistics(const GAStatistics&);
   GAStatistics& operator=(const GAStatistics& orig){copy(orig); return *this;}
   virtual ~GAStatistics();
   void copy(const GAStatistics &);
+  int save(GASnapshot &) const;
+  int load(GASnapshot &);
 
   float online() const {return on;}
   float offlineMax() const {return offmax;}
@@ -80,6 +100,8 @@ public:
   int flushFrequency() const { return Nscrs; }
   const char* scoreFilename(const char *filename);
   const char* scoreFilename() const { return scorefile; }
+  int scoreFormat(int f){ closeScores(); return scorefmt = f; }
+  int scoreFormat() const { return scorefmt; }
   int selectScores(int w){ return which = w; }
   int selectScores() const { return which; }
   GABoolean recordDiversity(GABoolean flag){ return dodiv=flag; }
@@ -141,7 +163,12 @@ protected:
   float * minScore;		// worst scores of each generation
   float * devScore;		// stddev of each generation
   float * divScore;		// diversity of each generation
+  float * bestScore;		// best score of each generation
+  unsigned long * evalScore;	// genome evaluations up to each generation
   char * scorefile;		// name of file to which scores get written
+  int scorefmt;			// text or binary?
+  GAScoreLog * scorelog;	// open binary score file (if any)
+  int flushed;			// last generation written to file (-1=none)
   int which;			// which data to write to file
   GAPopulation * boa;		// keep a copy of the best genomes
 
@@ -149,6 +176,8 @@ protected:
   void setScore(const GAPopulation&);
   void updateBestIndividual(const GAPopulation&, GABoolean flag=gaFalse);
   void writeScores();
+  void closeScores();
+  int lastScoreWritten() const;
   void resizeScores(unsigned int);
 
   friend class GA;
@@ -157,6 +186,7 @@ protected:
 
 
 inline const char* GAStatistics::scoreFilename(const char* filename){
+  closeScores();
   delete [] scorefile;
   scorefile = 0;
   if(filename){
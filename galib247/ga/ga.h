@@ -157,6 +157,12 @@ one copy of the genome type you want to use.
 #include <ga/GADemeGA.h>
 #include <ga/GADCrowdingGA.h>
 
+// The binary score log (and the reader for it).
+#include <ga/GAScoreLog.h>
+
+// Snapshots for checkpointing and resuming a GA.
+#include <ga/GASnapshot.h>
+
 // Here we include the headers for all of the various genome types.
 #include <ga/GA1DBinStrGenome.h>
 #include <ga/GA2DBinStrGenome.h>
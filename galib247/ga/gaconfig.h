@@ -95,6 +95,15 @@ incorporate it into the code base.
 		      forces an instantiation of all of the template classes
 		      that it uses (such as real genome and string genome).
 
+  GALIB_USE_PTHREADS
+
+                      Define this if the system has POSIX threads.  The
+                      population uses them to spread the diversity 
+                      comparisons across cores (see the diversityThreads
+                      member), and the binary score log writes from a
+                      background thread.  Without it everything runs in 
+                      one thread.
+
   GALIB_HAVE_NOT_ASSERT
 
                       Some platforms do not have assert.  So for those
@@ -365,6 +374,7 @@ incorporate it into the code base.
 #define GALIB_USE_BORLAND_INST
 #define GALIB_USE_STREAMS
 #define GALIB_USE_PID
+#define GALIB_USE_PTHREADS
 #define GALIB_USE_EMPTY_TEMPLATES
 #define GALIB_NEED_INSTANTIATION_PREFIX
 #if __GNUC__ > 2
@@ -548,6 +558,7 @@ of the objects in GAlib.
 #define USE_DS_SELECTOR              1
 #define USE_SRS_SELECTOR             1
 #define USE_UNIFORM_SELECTOR         1
+#define USE_ALIAS_SELECTOR           1
 
 // These are the compiled-in defaults for various genomes and GA objects
 #define DEFAULT_SCALING              GALinearScaling
@@ -40,6 +40,14 @@ GAUnitGaussian
 GAGaussianFloat, GAGaussianDouble
   Scaled versions of the gaussian distribution.  You must specify a stddev, 
 then these functions scale the distribution to that deviation.  Mean is still 0
+
+GARandomStateSize, GAGetRandomState, GASetRandomState
+  Copy the complete state of the generator (seed, bit generator, cached
+gaussian and the ran1/2/3 tables) to or from a buffer of GARandomStateSize
+bytes.  Restoring a saved state makes the generator repeat exactly the numbers
+it gave after the state was saved, which is what a GA checkpoint needs.  The
+system generators (rand, random, rand48) keep their state inside the C library,
+so with them only the seed is restored and a resumed run will not be the same.
 ---------------------------------------------------------------------------- */
 #ifndef _ga_random_h_
 #define _ga_random_h_
@@ -166,6 +174,9 @@ void GARandomSeed(unsigned int seed=0);
 void GAResetRNG(unsigned int seed);
 int GARandomBit();
 double GAUnitGaussian();
+unsigned int GARandomStateSize();
+void GAGetRandomState(void* state);
+void GASetRandomState(const void* state);
 
 inline GABoolean GAFlipCoin(float p){
   return((p == 1.0) ? gaTrue : (p == 0.0) ? gaFalse :
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "battle.h"   // wire format, shared with pmars_worker
+
+// An assembled warrior, the way it goes over the wire.
+struct WarriorCode {
+    int offset = 0;
+    std::vector<battle_inst> inst;
+};
+
+// Score table of one battle: score[i*warriors+k] is the number of rounds
+// warrior i was alive at the end with k+1 warriors left.
+struct BattleScores {
+    int warriors = 0;
+    int rounds = 0;
+    std::vector<int> score;
+    std::uint64_t instructions = 0;   // executed by the simulator, all rounds
+};
+
+// The P-space of each warrior and its last result (cell 0), as a battle of
+// a session left them (BATTLE_SESSION). Empty (size 0) before the first.
+struct PspaceState {
+    int size = 0;                  // cells per warrior
+    std::vector<int> lastResult;   // per warrior
+    std::vector<int> cells;        // warrior i's are [i*size, (i+1)*size)
+};
+
+// Rounds of one warrior against another, from the first one's view.
+struct PairResult {
+    int wins = 0, ties = 0, losses = 0;
+
+    int rounds() const { return wins + ties + losses; }
+};
+
+// Default battle parameters (pmars defaults, our core size).
+battle_params defaultBattleParams();
+
+// Something that assembles warriors and runs battles: the local worker pool
+// (WorkerPool) or a farm of nodes over TCP (BattleFarm). Both take the same
+// requests, so the evaluator doesn't care which one it talks to.
+// Any thread may call assemble()/run(); they block until the reply is in.
+class BattleBackend {
+public:
+    virtual ~BattleBackend() = default;
+
+    // false if the request could not be carried out; for assemble() that
+    // includes source that does not assemble (the reason is in *status).
+    virtual bool assemble(const std::string& source, const battle_params& params,
+                          WarriorCode& code, int* status = nullptr) = 0;
+    // With pspace the battle goes on from the P-spaces in it and leaves
+    // them there for the next (BATTLE_SESSION); see BattleSession.
+    virtual bool run(const battle_params& params,
+                     const std::vector<const WarriorCode*>& warriors,
+                     BattleScores& scores, PspaceState* pspace = nullptr) = 0;
+
+    // how many battles it can run at the same time
+    virtual unsigned concurrency() const = 0;
+};
+
+// The battles of warriors that use P-space (LDP/STP, see usesPspace() in
+// WarriorAnalysis.h): what a round loads depends on what the rounds before
+// stored, so splitting the rounds over several requests would start each
+// from an empty P-space. A session owns the P-spaces and plays its battles
+// one after the other, each going on from where the last one left. Rounds
+// of warriors without P-space don't need one and can go anywhere at once.
+class BattleSession {
+public:
+    BattleSession(BattleBackend& backend, std::vector<const WarriorCode*> warriors)
+        : backend(backend), warriors(std::move(warriors)) {}
+
+    // Runs of one session wait for each other; a run that fails leaves the
+    // P-spaces as they were.
+    bool run(const battle_params& params, BattleScores& scores);
+
+private:
+    BattleBackend& backend;
+    std::vector<const WarriorCode*> warriors;
+    PspaceState pspace;
+    std::mutex lock;
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BattleBackend.h"
+
+class WorkerPool;
+class BattleNode;
+
+// Sends battles to farm nodes (corewar_node) over TCP, with the same
+// requests the local WorkerPool takes.
+//
+// Every node has its own queue of jobs. A node gets one connection (and one
+// thread here) per worker it reports in its HELLO reply; a connection that
+// is idle takes the next job of its node, or steals the last one of the
+// node with the longest queue. If a connection breaks, its job goes back on
+// the queue (at most MAX_ATTEMPTS tries) and the connection is made again
+// later. If no node can be reached for GIVE_UP_AFTER, the waiting jobs fail.
+//
+// Warriors go to a node by content hash: the code is sent once per node
+// (BATTLE_STORE) and battles only carry the hashes.
+class BattleFarm : public BattleBackend {
+public:
+    static constexpr int MAX_ATTEMPTS = 3;
+    static constexpr std::chrono::seconds GIVE_UP_AFTER{30};
+    static constexpr std::chrono::seconds REPLY_TIMEOUT{120};
+
+    // nodes: "host:port,host:port,..." or "loopback", which starts a node in
+    // this process on 127.0.0.1 (running `workers` of `program`, 0 = one per
+    // core) and talks to it over TCP like to any other.
+    BattleFarm(const std::string& nodes, const std::string& program, unsigned workers = 0);
+    ~BattleFarm() override;
+
+    BattleFarm(const BattleFarm&) = delete;
+    BattleFarm& operator=(const BattleFarm&) = delete;
+
+    bool assemble(const std::string& source, const battle_params& params,
+                  WarriorCode& code, int* status = nullptr) override;
+    bool run(const battle_params& params,
+             const std::vector<const WarriorCode*>& warriors,
+             BattleScores& scores, PspaceState* pspace = nullptr) override;
+
+    unsigned concurrency() const override;
+    unsigned retries() const { return nRetries; }
+    unsigned steals() const { return nSteals; }
+
+private:
+    struct Job {
+        int type = 0;
+        std::vector<char> payload;                 // BATTLE_ASSEMBLE
+        battle_params params{};                    // BATTLE_RUN, BATTLE_SESSION
+        std::vector<const WarriorCode*> warriors;
+        std::vector<std::uint64_t> hashes;
+        const PspaceState* pspace = nullptr;       // BATTLE_SESSION
+        std::vector<char> reply;
+        int attempts = 0;
+        bool done = false, ok = false;
+    };
+
+    struct Node {
+        std::string host, port;
+        std::deque<Job*> queue;
+        std::set<std::uint64_t> known;             // code it has been sent
+        std::vector<int> fds;                      // open connections
+        int workers = 0;                           // from its HELLO reply
+        bool spawned = false, refused = false;
+    };
+
+    bool submit(Job& job);
+    void finish(Job& job, bool ok);
+    Job* take(size_t node);
+    void connection(size_t node);
+    int connectTo(size_t node);
+    bool perform(int fd, size_t node, Job& job);
+    bool exchange(int fd, int type, const std::vector<char>& payload,
+                  std::vector<char>& reply);
+
+    std::unique_ptr<WorkerPool> localPool;          // loopback only
+    std::unique_ptr<BattleNode> localNode;
+
+    mutable std::mutex lock;
+    std::condition_variable work;                   // a job was queued
+    std::condition_variable doneCv;                 // a job finished
+    std::vector<Node> nodes;
+    std::vector<std::thread> threads;
+    std::chrono::steady_clock::time_point lastUp;
+    bool stopping = false;
+    std::atomic<int> nextId{0};
+    std::atomic<unsigned> nRetries{0}, nSteals{0};
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "BattleBackend.h"
+
+// A farm node: takes battle.h requests over TCP and runs them on a local
+// backend (a WorkerPool). Every connection gets its own thread and is served
+// one request at a time, so a coordinator opens as many connections as the
+// HELLO reply says the node has workers.
+//
+// Code sent with BATTLE_STORE is kept (at most STORE_SIZE entries, oldest
+// out first) so that opponents go over the network once per node, not once
+// per battle.
+class BattleNode {
+public:
+    static constexpr size_t STORE_SIZE = 4096;
+
+    // port 0 picks a free one (see port()); host nullptr listens on all
+    // interfaces
+    BattleNode(BattleBackend& backend, int port, const char* host = nullptr);
+    ~BattleNode();
+
+    BattleNode(const BattleNode&) = delete;
+    BattleNode& operator=(const BattleNode&) = delete;
+
+    bool good() const { return listenFd >= 0; }
+    int port() const { return boundPort; }
+
+    void serve();   // accept connections until stop()
+    void start();   // serve() on a background thread
+    void stop();
+
+private:
+    void session(int fd);
+    bool store(std::uint64_t hash, WarriorCode code);
+    bool find(std::uint64_t hash, WarriorCode& code);
+
+    BattleBackend& backend;
+    int listenFd = -1;
+    int boundPort = 0;
+    bool stopping = false;
+    std::thread acceptor;
+
+    std::mutex lock;                       // sessions and the code store
+    std::condition_variable finished;
+    std::vector<int> sessionFds;           // one per session thread
+    std::unordered_map<std::uint64_t, WarriorCode> codes;
+    std::deque<std::uint64_t> codeOrder;
+};
@@ -0,0 +1,70 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs the evaluator's battles on runner threads, one per battle the
+// backend can run at once (BattleBackend::concurrency()). That can go up
+// while a run goes on (a farm node that connects late): grow() adds the
+// runners for it. Runners are never taken away; with fewer battles to run
+// than runners, the extra ones just wait.
+//
+// A job comes with its expected cost (any unit; the evaluator uses
+// measured seconds). submit() deals a set of jobs out longest first,
+// each to the runner with the least expected work queued, so the long
+// battles start early instead of keeping one worker busy after the others
+// are done. Every runner has its own queue and takes from its front; a
+// runner whose queue is empty steals the front (the longest job) of the
+// runner with the most expected work left.
+class BattleScheduler {
+public:
+    struct Job {
+        double cost = 0;                // expected
+        std::function<void()> run;
+    };
+
+    // What a runner has done since the scheduler started
+    struct RunnerStats {
+        double busy = 0;                // seconds spent in jobs
+        std::int64_t jobs = 0;
+        std::int64_t stolen = 0;        // of those, taken from another runner
+    };
+
+    explicit BattleScheduler(unsigned runners);
+    ~BattleScheduler();
+
+    // Starts runners until there are at least n.
+    void grow(unsigned n);
+
+    BattleScheduler(const BattleScheduler&) = delete;
+    BattleScheduler& operator=(const BattleScheduler&) = delete;
+
+    // Queues the jobs and returns; they report back by themselves (through
+    // a promise, say). Any thread may call it.
+    void submit(std::vector<Job> jobs);
+
+    std::vector<RunnerStats> stats() const;
+    double seconds() const;             // since the scheduler started
+
+private:
+    struct Runner {
+        std::deque<Job> queue;          // longest first
+        double queued = 0;              // expected cost of the queue
+        RunnerStats stats;
+    };
+
+    bool take(size_t runner, Job& job);
+    void run(size_t runner);
+
+    mutable std::mutex lock;
+    std::condition_variable work;       // a job was queued
+    std::vector<Runner> runners;
+    std::vector<std::thread> threads;
+    const std::chrono::steady_clock::time_point started;
+    bool stopping = false;
+};
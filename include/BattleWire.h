@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "BattleBackend.h"
+
+// Reading and writing battle.h messages on a stream socket, and packing the
+// payloads. Used by the worker pool, the farm and the farm nodes.
+
+bool sendAll(int fd, const void* buf, size_t n);
+bool recvAll(int fd, void* buf, size_t n);
+
+bool sendMessage(int fd, int type, int id, const std::vector<char>& payload);
+bool recvMessage(int fd, battle_header& h, std::vector<char>& payload);
+
+template <class T>
+void append(std::vector<char>& buf, const T* x, size_t n = 1)
+{
+    const char* p = reinterpret_cast<const char*>(x);
+    buf.insert(buf.end(), p, p + n*sizeof(T));
+}
+
+// Copies x into buf (sized for it already) at `at`, moves `at` past it. The
+// encoders size a payload up front and place its parts: appending to an
+// empty vector makes GCC's -O2 warn of an overflow (-Wstringop-overflow).
+template <class T>
+void place(std::vector<char>& buf, size_t& at, const T* x, size_t n = 1)
+{
+    if (n > 0) std::memcpy(buf.data() + at, x, n*sizeof(T));
+    at += n*sizeof(T);
+}
+
+// Content hash of assembled code (FNV-1a, 64 bit), used to refer to code a
+// node already has.
+std::uint64_t codeHash(const WarriorCode& code);
+
+// BATTLE_ASSEMBLE
+std::vector<char> encodeAssemble(const std::string& source, const battle_params& params);
+std::vector<char> encodeCode(int status, const WarriorCode& code);
+bool decodeCode(const std::vector<char>& payload, WarriorCode& code, int* status);
+
+// BATTLE_RUN, or BATTLE_SESSION with pspace. With byRef, the warriors go as
+// hashes (BATTLE_BYREF) instead of code; the node must have been sent them
+// with BATTLE_STORE.
+std::vector<char> encodeRun(const battle_params& params,
+                            const std::vector<const WarriorCode*>& warriors,
+                            bool byRef = false, const PspaceState* pspace = nullptr);
+// Returns a battle.h status. find() looks up code sent by reference.
+int decodeRun(const std::vector<char>& payload, battle_params& params,
+              std::vector<WarriorCode>& warriors,
+              const std::function<bool(std::uint64_t, WarriorCode&)>& find,
+              PspaceState* pspace = nullptr);
+std::vector<char> encodeScores(int status, const BattleScores& scores,
+                               const PspaceState* pspace = nullptr);
+bool decodeScores(const std::vector<char>& payload, int warriors, BattleScores& scores,
+                  PspaceState* pspace = nullptr);
+
+// BATTLE_STORE
+std::vector<char> encodeStore(const WarriorCode& code);
+bool decodeStore(const std::vector<char>& payload, std::uint64_t& hash, WarriorCode& code);
+
+// Every reply payload starts with a battle.h status.
+int replyStatus(const std::vector<char>& payload);
@@ -0,0 +1,37 @@
+#pragma once
+#include <ga/ga.h>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <string>
+
+// Periodic GA checkpoints that don't stall the generation loop.
+// save() copies the GA state into a snapshot on the calling thread (cheap),
+// then the file is written on a background thread. The file is replaced
+// atomically (temp file + rename), so a kill mid-write keeps the previous
+// checkpoint. Only one write is in flight at a time. After the GA state
+// comes the evaluator's evaluation count, so a resumed run goes on where
+// this one stopped instead of starting again at evaluation 0, then the
+// surrogate's state if there is one (without it, a resumed run would take
+// its predicted scores for simulated ones).
+class Surrogate;
+
+class Checkpointer {
+public:
+    explicit Checkpointer(std::string filename);
+    ~Checkpointer();
+
+    bool save(const GAGeneticAlgorithm& ga, std::int64_t evaluations,
+              const Surrogate* surrogate = nullptr);
+    bool wait();    // block until the last write is done, true if it worked
+
+private:
+    std::string filename;
+    std::future<int> writing;
+};
+
+// Loads a checkpoint into the GA; evaluations gets the count saved with it
+// (0 for a checkpoint written without one), the surrogate (if given) the
+// state saved with it. False if it can't be used.
+bool resumeCheckpoint(GAGeneticAlgorithm& ga, const std::string& filename,
+                      std::int64_t& evaluations, Surrogate* surrogate = nullptr);
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+#include "BattleBackend.h"
+
+// Compiled warriors (.rcb), written by `pmars --compile` (the format is in
+// rcb.h): the assembled cells of a warrior with its ORG offset, the settings
+// it was assembled for and a hash of its source. Loading one maps the file
+// and copies the cells, without a trip to the assembler.
+//
+// A .rcb fits a battle if assembling its source with those battle_params
+// would give the same code: same core size, the code within maxLength and
+// every predefined constant the source refers to (ROUNDS, WARRIORS ...)
+// unchanged. The opcode set must be the one pmars_worker is built with.
+
+// FNV-1a (64 bit) of a source, as pmars stores it in a .rcb
+std::uint64_t sourceHash(const std::string& source);
+
+// x.red -> x.rcb, "" if file is not a .red
+std::string compiledName(const std::string& file);
+bool isCompiled(const std::string& file);
+
+// Loads the .rcb file into code; false (after saying why on stderr) if it
+// can't be read, is not a compiled warrior or doesn't fit params.
+// *source gets the hash of the source it was compiled from.
+bool loadCompiled(const std::string& file, const battle_params& params,
+                  WarriorCode& code, std::uint64_t* source = nullptr);
+
+// The compiled form of the .red file with this source, if there is one next
+// to it that was compiled from the same source and fits params. Quiet: a
+// missing or stale .rcb just means the source has to be assembled.
+bool findCompiled(const std::string& file, const std::string& source,
+                  const battle_params& params, WarriorCode& code);
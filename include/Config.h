@@ -1,5 +1,9 @@
 #pragma once
 
+// Compile-time defaults. Most of them can be changed per run in a config
+// file or on the command line (see RunConfig.h, e.g. instructions=20,
+// core_size=8000, max_rounds=50, racing=false).
+
 // Each Core War instruction is encoded as 5 integers in the genome:
 // [ opcode, A_mode, A_value, B_mode, B_value ]
 constexpr int INSTR_FIELDS = 5;
@@ -12,8 +16,58 @@ constexpr int INSTR_COUNT  = 15;
 constexpr int GENOME_SIZE  = INSTR_FIELDS * INSTR_COUNT;
 
 
-constexpr int ROUNDS = 50;
+// Fitness = mean - VARIANCE_LAMBDA*variance of the per-opponent scores.
+// One round scores WIN_SCORE, TIE_SCORE or LOSS_SCORE.
 constexpr float VARIANCE_LAMBDA = 0.1f;
+constexpr float WIN_SCORE  = 5.0f;
+constexpr float TIE_SCORE  = 0.4f;
+constexpr float LOSS_SCORE = -1.0f;
+
+// Rounds per opponent are allocated adaptively: every opponent gets
+// MIN_ROUNDS, then rounds (in batches of ROUND_BATCH, at most MAX_ROUNDS per
+// opponent) go where they cut the standard error of the fitness the most,
+// until it is at most TARGET_SE.
+constexpr int MIN_ROUNDS  = 20;
+constexpr int MAX_ROUNDS  = 200;
+constexpr int ROUND_BATCH = 10;
+constexpr float TARGET_SE = 0.1f;
+
+// CoreWar core size, and pmars' default minimum distance between warriors
+constexpr int CORESIZE = 8000;
+constexpr int MIN_SEPARATION = 100;
+
+// GA checkpoint: written every CHECKPOINT_INTERVAL generations (and after the
+// initial population). Resume with: ./corewar_ga ... <sharing> <checkpoint>
+constexpr const char* CHECKPOINT_FILE = "checkpoint.gasn";
+constexpr int CHECKPOINT_INTERVAL = 5;
+
+// pmars_worker program (built with 'make' in pmars-0.9.4/src), started once
+// per core to run the battles
+constexpr const char* PMARS_WORKER = "../pmars-0.9.4/src/build/pmars_worker";
+
+// Evaluation farm. Battles run on the local workers unless FARM_NODES (or
+// the COREWAR_NODES environment variable) lists nodes: "host:port,..." of
+// machines running ./corewar_node, or "loopback" for a node in this process
+// reached over TCP (to try the farm on one box).
+constexpr const char* FARM_NODES = "";
+constexpr int FARM_PORT = 7421;
+
+// Round-robin tournaments (./corewar_tournament): the hill the population
+// plays against, and rounds per pair
+constexpr const char* HILL_DIR = "../warriors";
+constexpr int TOURNAMENT_ROUNDS = 100;
+
+// Co-evolution: with HALL_OF_FAME > 0 (or COREWAR_HOF=<size> in the
+// environment) fitness is measured against the fixed opponents plus the last
+// HALL_OF_FAME best warriors, HOF_ROUNDS rounds each. The members and all
+// their battle results are kept in HOF_FILE, so a later run starts from them.
+constexpr int HALL_OF_FAME = 0;
+constexpr int HOF_ROUNDS = 50;
+constexpr const char* HOF_FILE = "halloffame.bin";
 
-// CoreWar core size
-constexpr int CORESIZE = 8000;
\ No newline at end of file
+// Surrogate pre-screening (see Surrogate.h). With SURROGATE_FRACTION > 0 (or
+// COREWAR_SURROGATE=<fraction> in the environment) only that share of the
+// offspring, best predicted first, plus SURROGATE_EXPLORE of the rest at
+// random are simulated; the others get the predicted score.
+constexpr float SURROGATE_FRACTION = 0.0f;
+constexpr float SURROGATE_EXPLORE = 0.1f;
@@ -1,5 +1,7 @@
 #pragma once
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <ga/ga.h>  // <- Include GALib core headers
 
 struct MatchResult {
@@ -8,8 +10,50 @@ struct MatchResult {
     int wins;
     int ties;
     int losses;
+    bool failed = false;    // couldn't be played (then no rounds count)
 };
 
-MatchResult runMatch(const std::string& opponent);
+struct WarriorCode;
+struct RunConfig;
+class BattleSession;
+
+// The evaluator keeps a copy of the run's configuration; call this before
+// the first evaluation (otherwise the Config.h defaults are used).
+void initEvaluator(const RunConfig& config);
+
+MatchResult runMatch(const WarriorCode& warrior, const WarriorCode& opponent,
+                     int rounds, int seed, BattleSession* session = nullptr);
 float evaluateFitness(const GA1DArrayGenome<int>& genome);
+// No evaluation scores below this (fitness sharing offsets the scores by it,
+// so that the shared fitness is never negative).
+float lowestFitness();
+
+// Work done by the evaluator so far (all threads), for benchmarks and logs.
+struct EvaluatorStats {
+    std::int64_t evaluations = 0;
+    std::int64_t battles = 0;       // battle requests (batches of rounds)
+    std::int64_t rounds = 0;
+    std::int64_t instructions = 0;  // executed by the simulator
+    std::int64_t failedBattles = 0; // couldn't be played
+
+    // Per runner of the battle scheduler (BattleScheduler.h): seconds spent
+    // in battles, battles run and how many of them were stolen, out of
+    // runnerSeconds since it started. Empty before the first battle.
+    std::vector<double> runnerBusy;
+    std::vector<std::int64_t> runnerJobs, runnerSteals;
+    double runnerSeconds = 0;
+};
+EvaluatorStats evaluatorStats();
+
+// A resumed run carries on numbering evaluations where the checkpoint was
+// taken (the number seeds the start positions of an evaluation's battles).
+void resumeEvaluations(std::int64_t evaluations);
+
+// Co-evolution (see HallOfFame.h): while a hall of fame is set, fitness is
+// measured against it and the fixed opponents. nullptr turns it off.
+class HallOfFame;
+void useHallOfFame(HallOfFame* hof);
+// Adds a warrior to the hall of fame; true if it changed (then all scores
+// are out of date).
+bool addToHallOfFame(const GA1DArrayGenome<int>& genome);
 
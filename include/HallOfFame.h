@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BattleBackend.h"
+
+// Results of past battles, keyed by the code hashes (codeHash) of the two
+// warriors, so a battle is only played once however often the same warriors
+// meet again. Warriors get a small index and a cell is three 16-bit counts,
+// which keeps the table small enough to save with the hall of fame. The
+// evaluator only puts battles against hall of fame members here and forgets
+// the warriors that are gone, so it holds the results of the live warriors.
+// Not thread-safe.
+class ResultMatrix {
+public:
+    // a against b; false if they haven't met
+    bool find(std::uint64_t a, std::uint64_t b, PairResult& r) const;
+    void put(std::uint64_t a, std::uint64_t b, const PairResult& r);
+    // drops every result of warrior h (and its index, for the next warrior)
+    void forget(std::uint64_t h);
+    // drops every result that isn't between two of these warriors
+    void retain(const std::vector<std::uint64_t>& live);
+
+    size_t size() const { return cells.size(); }
+    size_t warriors() const { return index.size(); }
+
+    // only the results between the warriors in `only`
+    bool write(std::ostream& out, const std::vector<std::uint64_t>& only) const;
+    bool read(std::istream& in);
+
+private:
+    struct Cell {
+        std::uint16_t wins, ties, losses;
+    };
+    static std::uint64_t key(std::uint32_t a, std::uint32_t b)
+        { return static_cast<std::uint64_t>(a) << 32 | b; }
+    std::uint32_t indexOf(std::uint64_t hash);
+
+    std::vector<std::uint64_t> hashes;                     // index -> hash
+    std::vector<std::uint32_t> unused;                     // forgotten indices
+    std::unordered_map<std::uint64_t, std::uint32_t> index;
+    std::unordered_map<std::uint64_t, Cell> cells;         // key(lower, higher index)
+};
+
+// Rolling hall of fame of past best warriors, for co-evolution: fitness is
+// measured against its members (and the fixed opponents), and the results
+// are kept in a ResultMatrix, so when a member comes in only battles against
+// it are new. At most `capacity` members; the oldest one leaves first, and
+// its results with it. Only the results among members are saved: the other
+// warriors are the population's, whose code is made again on a new run.
+// The file records the battle parameters (`params`, with the rounds of a
+// battle against a member): under other cycles, processes, minimum distance
+// or rounds the results are dropped, and under another core size or
+// maximum length, whose code it was assembled for, the whole file is.
+class HallOfFame {
+public:
+    struct Member {
+        std::vector<int> genome;
+        WarriorCode code;
+        std::uint64_t hash;
+    };
+
+    HallOfFame(size_t capacity, const battle_params& params)
+        : capacity(capacity), params(params) {}
+
+    // false if a warrior with the same code is already in
+    bool add(std::vector<int> genome, WarriorCode code);
+
+    const std::deque<Member>& members() const { return hall; }
+    bool isMember(std::uint64_t hash) const;
+    ResultMatrix& results() { return matrix; }
+
+    // The file is replaced atomically (temp file + rename), like checkpoints.
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+private:
+    size_t capacity;
+    battle_params params;
+    std::deque<Member> hall;
+    ResultMatrix matrix;
+};
@@ -0,0 +1,81 @@
+#pragma once
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "BattleBackend.h"
+#include "Config.h"
+
+// Everything a run can be tuned with. The defaults are the constants in
+// Config.h; a config file and the command line override them (see
+// loadRunConfig). It is read once at startup and not changed after that:
+// main hands it to the evaluator (initEvaluator) as a const object.
+struct RunConfig {
+    // GA
+    int population = 20;
+    int generations = 100;
+    double mutation = 0.05;
+    double crossover = 0.9;
+    double sharing = 0.0;               // sharing sigma, 0 = off
+    unsigned seed = 0;                  // GA random seed, 0 = from the clock
+    std::string resume;                 // checkpoint to resume from
+    int instructions = INSTR_COUNT;     // genome = instructions*INSTR_FIELDS
+
+    // Battles
+    int coreSize = CORESIZE;
+    int cycles = 80000;
+    int processes = 8000;
+    int maxLength = 100;
+    int minDistance = MIN_SEPARATION;
+    std::vector<std::string> opponents = {
+        "../warriors/dwarf.red",
+        "../warriors/Imp.red",
+        "../warriors/paper.red"
+    };
+
+    // Rounds per opponent. Racing: rounds go (in batches) to the opponents
+    // where they cut the error of the fitness most; without it every
+    // opponent gets maxRounds. Early stop: once the standard error is at
+    // most targetSE (0 = never, play up to maxRounds). minRounds is capped
+    // at maxRounds.
+    bool racing = true;
+    int minRounds = MIN_ROUNDS;
+    int maxRounds = MAX_ROUNDS;
+    int roundBatch = ROUND_BATCH;
+    float targetSE = TARGET_SE;
+    float varianceLambda = VARIANCE_LAMBDA;
+
+    // Where battles run
+    std::string pmarsWorker = PMARS_WORKER;
+    unsigned workers = 0;               // local pmars workers, 0 = one per core
+    std::string farmNodes = FARM_NODES;
+    int codeCache = 4096;               // genomes whose code is kept (co-evolution)
+
+    // Co-evolution, surrogate, checkpoints
+    int hallOfFame = HALL_OF_FAME;
+    int hofRounds = HOF_ROUNDS;
+    std::string hofFile = HOF_FILE;
+    float surrogateFraction = SURROGATE_FRACTION;
+    float surrogateExplore = SURROGATE_EXPLORE;
+    std::string checkpointFile = CHECKPOINT_FILE;
+    int checkpointInterval = CHECKPOINT_INTERVAL;
+
+    int genomeSize() const { return instructions * INSTR_FIELDS; }
+    battle_params battleParams() const;
+};
+
+// Builds the configuration of a run, later sources overriding earlier ones:
+// the defaults, the config file given with --config, the environment
+// (COREWAR_NODES, COREWAR_HOF, COREWAR_SURROGATE), then the command line:
+//   ./corewar_ga [--config file] [key=value ...]
+//                [population generations mutation crossover [sharing] [checkpoint]]
+// A config file has one "key = value" per line; # starts a comment. The keys
+// are the ones printRunConfig writes. false (after saying why) if something
+// can't be used.
+bool loadRunConfig(int argc, char* argv[], RunConfig& config);
+
+// Sets one key; false if the key is unknown or the value doesn't parse.
+bool setRunConfig(RunConfig& config, const std::string& key, const std::string& value);
+
+// Every key with its value, in config file syntax.
+void printRunConfig(std::ostream& out, const RunConfig& config);
@@ -0,0 +1,67 @@
+#pragma once
+#include <ga/ga.h>
+#include <cstdint>
+#include <deque>
+#include <unordered_set>
+
+// Surrogate fitness model that screens offspring before they are simulated.
+//
+// It is a k-nearest-neighbour model over the decoded warriors: the distance
+// is warriorDistance (the one fitness sharing uses), the prediction the
+// distance-weighted mean score of the `k` nearest of the last `samples`
+// simulated warriors. It learns from every warrior that is simulated.
+//
+// Installed as the population evaluator (see install()), it looks at the
+// genomes that changed since the last evaluation. Once it has `minSamples`
+// to go on, it ranks them by predicted score: the top `fraction` and a
+// random `explore` share of the rest are simulated, the others get the
+// predicted score. The exploration slice is a fair sample, so the error on
+// it is the model's accuracy. The best of the population is what the GA
+// keeps as elite, the hall of fame takes and best.red gets, so it is never
+// left with a predicted score: a predicted warrior that comes out on top is
+// simulated, until the best one is a simulated one.
+class Surrogate {
+public:
+    Surrogate(float fraction, float explore, int k = 5, size_t samples = 512,
+              size_t minSamples = 40);
+
+    // Makes this the evaluator of `pop` (set the population on the GA
+    // afterwards, so that both of its populations get it).
+    void install(GAPopulation& pop);
+
+    float predict(const GAGenome& g) const;
+    void learn(const GAGenome& g, float score);
+    // true while g's score is a prediction (copies of it included)
+    bool isPredicted(const GAGenome& g) const;
+
+    // The samples, which scores are predictions and the counts, for the
+    // checkpoint; load() makes the sample genomes like `like`. Non-zero if
+    // the state can't be saved or loaded.
+    int save(GASnapshot& s) const;
+    int load(GASnapshot& s, const GAGenome& like);
+
+    long simulated() const { return nSimulated; }
+    long predicted() const { return nPredicted; }
+    float exploreError() const { return nExplored ? errExplored / nExplored : 0.0f; }
+    void report() const;
+
+private:
+    static void evaluatePopulation(GAPopulation& pop);
+    void screen(GAPopulation& pop);
+    int simulateBest(GAPopulation& pop);
+
+    struct Sample {
+        GA1DArrayGenome<int> genome;
+        float score;
+    };
+
+    float fraction, explore;
+    int k;
+    size_t samples, minSamples;
+    std::deque<Sample> known;
+    // genes of the warriors in the population whose score is a prediction
+    std::unordered_set<std::uint64_t> guessed;
+
+    long nSimulated = 0, nPredicted = 0, nExplored = 0;
+    double errExplored = 0.0;
+};
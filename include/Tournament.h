@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BattleBackend.h"
+
+// Round robin over a pool of warriors (e.g. a population plus a hill): every
+// warrior meets every other one. Each warrior is assembled once when it is
+// added; the battles then run on the backend, as many at the same time as
+// it has workers.
+//
+// pmars alternates the warrior that moves first from round to round, so a
+// pair is played once and the result goes in both cells of the matrix.
+class Tournament {
+public:
+    explicit Tournament(BattleBackend& backend,
+                        const battle_params& params = defaultBattleParams());
+
+    // Index of the new warrior, or -1 if it does not assemble.
+    int add(const std::string& name, const std::string& source);
+    // A .red or a compiled .rcb (see CompiledWarrior.h); a .red with an up
+    // to date .rcb next to it is loaded from that.
+    int addFile(const std::string& file);
+    // Every *.red and *.rcb file in dir, by name, a warrior once.
+    // Returns how many were added.
+    int addDirectory(const std::string& dir);
+
+    // Plays all pairs, `rounds` rounds each. Every pair gets its own start
+    // positions, derived from `seed`, so a tournament can be repeated.
+    // Returns the number of pairs that could not be played (left at 0/0/0).
+    int run(int rounds, std::uint32_t seed = 1);
+
+    int size() const { return static_cast<int>(names.size()); }
+    const std::string& name(int i) const { return names[i]; }
+
+    // result(i, j): warrior i against warrior j (i == j is empty)
+    const PairResult& result(int i, int j) const { return matrix[i*size() + j]; }
+
+    // Mean score per round of warrior i over all its opponents
+    // (WIN_SCORE / TIE_SCORE / LOSS_SCORE per round).
+    float score(int i) const;
+
+private:
+    int addCode(const std::string& name, WarriorCode&& code);
+
+    BattleBackend& backend;
+    battle_params params;
+    std::vector<std::string> names;
+    std::vector<WarriorCode> codes;
+    std::vector<PairResult> matrix;    // size() x size(), row-major
+};
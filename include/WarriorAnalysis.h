@@ -0,0 +1,36 @@
+#pragma once
+#include "BattleBackend.h"
+
+// Static analysis of assembled code, to score warriors that can't do
+// anything without simulating them.
+//
+// It follows the code from its start like a process would, taking both ways
+// at every conditional jump (and both after SPL). Anything outside the
+// warrior is empty core (DAT) and kills the process. Writes (MOV, ADD, ...,
+// DJN, LDP and < > { } operands) are harmful unless they go, by a direct or
+// immediate address, to a cell of the warrior that is never executed.
+// Indirect jumps and writes, DIV and MOD count as harmful too: the analysis
+// gives up on them.
+//
+// The opponent is assumed to be a working warrior (it can overwrite us; we
+// don't rely on anything it does).
+enum class WarriorClass {
+    Viable,            // might hurt the opponent: simulate it
+    DiesImmediately,   // every process runs into a DAT within a few cycles
+    NeverWrites,       // pure loop: never writes, never dies by itself
+    OwnDataWrites,     // writes only into its own data, never dies by itself
+};
+
+// The last two can't win, but they aren't safe from a working opponent
+// either (a lone JMP 0 loses rounds to a dwarf).
+inline bool isHarmless(WarriorClass c)
+{
+    return c == WarriorClass::NeverWrites || c == WarriorClass::OwnDataWrites;
+}
+
+WarriorClass classifyWarrior(const WarriorCode& code, int coreSize);
+const char* warriorClassName(WarriorClass c);
+
+// The code has LDP or STP, so its rounds depend on the ones before through
+// its P-space: they have to be played in order, in a BattleSession.
+bool usesPspace(const WarriorCode& code);
@@ -1,6 +1,7 @@
 #pragma once
 #include <ga/ga.h>
 #include <string>
+#include <ostream>
 
 
 // Biased initialization and Dwarf-based mutation
@@ -9,6 +10,12 @@ void initGenomeFromDwarf(GAGenome& g, int generation = 0);
 int mutateGenomeFromDwarf(GA1DArrayGenome<int>& genome, int generation);
 
 // Helper functions to write warriors
+void setEncoderCoreSize(int size);   // default CORESIZE
 int getOpcode(int val);
 char getAddrMode(int val);
 void writeWarrior(const GA1DArrayGenome<int>& g, const std::string& filename);
+void writeWarrior(const GA1DArrayGenome<int>& g, std::ostream& out);
+
+// Fitness sharing: decoded-code distance and niche keys (one per band)
+float warriorDistance(const GAGenome& a, const GAGenome& b);
+int warriorNiche(const GAGenome& g, float sigma, unsigned long* keys);
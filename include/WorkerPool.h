@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+#include "BattleBackend.h"
+
+// A pool of pmars_worker processes, one per core by default. Each worker
+// talks to us over a Unix domain socket (socketpair) using battle.h.
+// A call blocks until a worker is free, then until the reply is in. A worker
+// that dies (or sends garbage) is restarted and the request is sent again,
+// up to MAX_ATTEMPTS times, so one crashing battle can't take the GA down
+// with it.
+class WorkerPool : public BattleBackend {
+public:
+    static constexpr int MAX_ATTEMPTS = 3;
+
+    explicit WorkerPool(std::string program, unsigned workers = 0);
+    ~WorkerPool() override;
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    bool assemble(const std::string& source, const battle_params& params,
+                  WarriorCode& code, int* status = nullptr) override;
+    bool run(const battle_params& params,
+             const std::vector<const WarriorCode*>& warriors,
+             BattleScores& scores, PspaceState* pspace = nullptr) override;
+
+    unsigned concurrency() const override { return static_cast<unsigned>(workers.size()); }
+    unsigned restarts() const { return nRestarts; }
+
+private:
+    struct Worker {
+        pid_t pid = -1;
+        int fd = -1;
+        bool busy = false;
+    };
+
+    bool request(int type, const std::vector<char>& payload,
+                 std::vector<char>& reply);
+    bool exchange(Worker& w, int type, const std::vector<char>& payload,
+                  std::vector<char>& reply);
+    bool start(Worker& w);
+    void stop(Worker& w, bool quit);
+
+    std::string program;
+    std::vector<Worker> workers;
+    std::mutex lock;
+    std::condition_variable idle;
+    std::atomic<int> nextId{0};
+    std::atomic<unsigned> nRestarts{0};
+};
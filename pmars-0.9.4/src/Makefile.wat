@@ -17,7 +17,7 @@ CC = wcc386
 CFLAGS  = /mf /wx /s /oneatx /DWATCOM /DEXT94 /DGRAPHX /DDOSTXTGRAPHX /DPERMUTATE
 
 OBJS = pmars.obj asm.obj eval.obj disasm.obj cdb.obj pos.obj &
-       clparse.obj global.obj token.obj str_eng.obj sim.obj
+       clparse.obj global.obj token.obj str_eng.obj sim.obj rcb.obj
 
 # Use whichever of these two you wish...
 pmars.exe: $(OBJS) pmars.lnk makefile config.h global.h
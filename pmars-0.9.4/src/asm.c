@@ -30,6 +30,10 @@
  *     globals:
  *      if errorcode is not SUCCESS, errmsg[] contains the last error
  *      message and errorlevel is set
+ *
+ *    assemble_buffer() (assemble.h) does the same for source in memory,
+ *    without the globals.  The assembler state below is THREAD_LOCAL, the
+ *    settings it reads are in par and it writes the warrior through curW.
  */
 
 #if defined(MPW)
@@ -39,9 +43,11 @@
 #include <ctype.h>
 #include <string.h>
 #include <stdio.h>
+#include <setjmp.h>
 
 #include "global.h"
 #include "asm.h"
+#include "assemble.h"
 
 #ifdef MACGRAPHX
 extern void macputs(char *);
@@ -77,7 +83,7 @@ extern char *StartDia, *Region, *AllLine, *LineQualifier, *Label, *LSEWarn,
 /* ********************** macros + type definitions ********************** */
 
 #define LOGICERROR do { fprintf(STDOUT, logicErr, __FILE__, __LINE__); \
-                        Exit(PARSEERR); } while(0)
+                        fatal(PARSEERR); } while(0)
 
 #define MEMORYERROR errprn(MLCERR, (line_st *) NULL, "")
 
@@ -113,7 +119,8 @@ typedef struct line_st {
 }       line_st;
 
 typedef struct grp_st {
-  char   *symn;
+  char   *symn;                        /* the interned name (sym->name) */
+  struct sym_st *sym;
   struct grp_st *nextsym;
 }       grp_st;
 
@@ -122,12 +129,53 @@ typedef struct ref_st {
   line_st *sline;
   uShrt   value, visit;
   RType   reftype;
+  uChar   predef;                /* PREDEF_x + 1 of a predefined constant */
   struct ref_st *nextref;
 }       ref_st;
 
 typedef struct err_st {
   uShrt   code, loc, num;
 }       err_st;
+
+/*
+ * Symbols are interned in a hash table.  Each one keeps the tables (ref_st)
+ * that define it, newest first, so lookup() is one hash probe instead of a
+ * walk over every table.  A FOR counter's table is unbound again at ROF.
+ */
+typedef struct bind_st {
+  ref_st *tbl;
+  struct bind_st *nextbind;
+}       bind_st;
+
+typedef struct sym_st {
+  char   *name;
+  unsigned long hash;
+  bind_st *bind;
+  struct sym_st *nextsym;
+}       sym_st;
+
+#define SYMHASH 512                /* buckets, a power of 2 */
+
+/*
+ * Everything an assembly allocates for itself (lines, sources, tables,
+ * symbols) comes from an arena of chunks that is released in one go by
+ * cleanmem() and at the start of the next assemble().
+ */
+typedef struct chunk_st {
+  struct chunk_st *nextchunk;
+  size_t  size, used;
+}       chunk_st;
+
+#define CHUNKSIZE 16384
+#define CHUNKALIGN sizeof(union { long l; double d; char *p; })
+#define CHUNKHEAD ((sizeof(chunk_st) + CHUNKALIGN - 1) / CHUNKALIGN * CHUNKALIGN)
+
+/* the pmars settings an assembly depends on */
+typedef struct par_st {
+  long    coreSize, taskNum, cycles, instrLim, separation, warriors, rounds;
+  long    readLimit, writeLimit, pSpaceSize;
+  int     sw8, swV;                /* par.sw8, par.swV */
+}       par_st;
 /* ************************* some globals *************************** */
 
 #ifdef NEW_MODES
@@ -183,24 +231,42 @@ char   *swname[] = {"ASSERT", ""};
 #define GRPMAX   7                /* max group */
 #define LEXCMAX  50                /* max number of excess lines */
 
-static char noassert;
-static uChar errnum, warnum;        /* Number of error and warning */
-static uChar symnum;
+static THREAD_LOCAL char noassert;
+static THREAD_LOCAL uChar errnum, warnum;        /* Number of error and warning */
+static THREAD_LOCAL uChar symnum;
+
+static THREAD_LOCAL ref_st *reftbl;
+static THREAD_LOCAL grp_st *symtbl;
+static THREAD_LOCAL sym_st *symhash[SYMHASH];
+static THREAD_LOCAL chunk_st *arena;
+static THREAD_LOCAL src_st *srctbl;
+static THREAD_LOCAL line_st *sline[2], *lline[2];
+static THREAD_LOCAL err_st *errkeep;
 
-static ref_st *reftbl;
-static grp_st *symtbl;
-static src_st *srctbl;
-static line_st *sline[2], *lline[2];
-static err_st *errkeep;
+static THREAD_LOCAL FIELD_T dbginfo;
+static THREAD_LOCAL int dbgproceed;
+static THREAD_LOCAL warrior_struct *curW;        /* the warrior assembled */
+static THREAD_LOCAL par_st par;
+static THREAD_LOCAL unsigned int pass;
+static THREAD_LOCAL int ierr;
+static THREAD_LOCAL int errcode, errlevel;
+static THREAD_LOCAL unsigned int predefs;        /* 1 << PREDEF_x looked up */
 
-static FIELD_T dbginfo;
-static int dbgproceed;
-static unsigned int curWarrior;
-static unsigned int pass;
-static int ierr;
+static THREAD_LOCAL char buf[MAXALLCHAR], buf2[MAXALLCHAR];
+static THREAD_LOCAL char token[MAXALLCHAR], outs[MAXALLCHAR];
 
-static char buf[MAXALLCHAR], buf2[MAXALLCHAR];
-static char token[MAXALLCHAR], outs[MAXALLCHAR];
+/* the source: a file (srcfp), or srcp up to srcend */
+static THREAD_LOCAL FILE *srcfp;
+static THREAD_LOCAL const char *srcp, *srcend;
+
+/* set while in assemble_buffer(): fatal errors jump to bail, messages go to
+   diag (if any) */
+static THREAD_LOCAL jmp_buf *bail;
+static THREAD_LOCAL diagnostics *diag;
+
+/* set while pmars --batch assembles a file: fatal errors jump here, so the
+   battle fails instead of pmars */
+static THREAD_LOCAL jmp_buf *giveup;
 
 
 #ifdef VMS
@@ -212,8 +278,9 @@ FILE   *dias;
 #ifdef NEW_STYLE
 static void textout(char *);
 static void errprn(errType, line_st *, char *);
+static void fatal(int);
 #else
-static void textout(), errprn();
+static void textout(), errprn(), fatal();
 #endif
 
 /* ***************** conforming local prototypes ******************** */
@@ -228,17 +295,23 @@ static int normalize(long);
 static int blkfor(char *, char *);
 static int equtbl(char *);
 static int equsub(char *, char *, int, ref_st *);
+static char *amalloc(size_t), *astrdup(char *);
+static void arelease(int);
+static sym_st *intern(char *, int);
+static void bindtbl(ref_st *, grp_st *), unbindtbl(ref_st *);
 static ref_st *lookup(char *);
 static grp_st *addsym(char *, grp_st *);
 static src_st *addlinesrc(char *, uShrt);
 static void newtbl(void);
-static void addpredef(char *, U32_T);
+static void addpredef(char *, int, U32_T);
 static void addpredefs(void);
 static void addline(char *, src_st *, uShrt);
 static void show_info(uShrt), show_lbl(void);
-static void disposeline(line_st *), disposegrp(grp_st *);
-static void disposetbl(ref_st *, ref_st *);
 static void cleanmem(void);
+static void loadpar(void);
+static void asmstart(void), asmpasses(uShrt), asmreport(void);
+static int asmread(char *, char *), asmfile(char *, int);
+static char *srcgets(char *, int);
 static void nocmnt(char *);
 static void automaton(char *, stateCol, mem_struct *);
 static void dfashell(char *, mem_struct *);
@@ -249,32 +322,165 @@ static void lineswitch();
 #endif
 static int globalswitch(), trav2(), normalize();
 static int blkfor(), equtbl(), equsub();
+static char *amalloc(), *astrdup();
+static void arelease();
+static sym_st *intern();
+static void bindtbl(), unbindtbl();
 static ref_st *lookup();
 static grp_st *addsym();
 static src_st *addlinesrc();
 static void newtbl(), addpredef(), addline();
 static void addpredefs();
 static void show_info(), show_lbl();
-static void disposeline(), disposegrp(), disposetbl();
 static void cleanmem(), nocmnt();
+static void loadpar();
+static void asmstart(), asmpasses(), asmreport();
+static int asmread(), asmfile();
+static char *srcgets();
 static void automaton(), dfashell(), expand(), encode();
 #endif
 
 /* ************************** Functions ***************************** */
 
+/* n bytes from the arena; NULL if out of memory */
+static char *
+amalloc(n)
+  size_t  n;
+{
+  chunk_st *chunk;
+  char   *p;
+
+  n = (n + CHUNKALIGN - 1) / CHUNKALIGN * CHUNKALIGN;
+  if (!arena || arena->size - arena->used < n) {
+    size_t  size = n > CHUNKSIZE ? n : CHUNKSIZE;
+
+    if ((chunk = (chunk_st *) MALLOC(CHUNKHEAD + size)) == NULL)
+      return NULL;
+    chunk->size = size;
+    chunk->used = 0;
+    chunk->nextchunk = arena;
+    arena = chunk;
+  }
+  p = (char *) arena + CHUNKHEAD + arena->used;
+  arena->used += n;
+  return p;
+}
+
+/* ******************************************************************* */
+
+static char *
+astrdup(str)
+  char   *str;
+{
+  char   *p;
+
+  if ((p = amalloc(strlen(str) + 1)) != NULL)
+    strcpy(p, str);
+  return p;
+}
+
+/* ******************************************************************* */
+
+/* release the arena (with keep, the first chunk is kept for the next
+   assembly) and forget all symbols */
+static void
+arelease(keep)
+  int     keep;
+{
+  chunk_st *chunk;
+
+  while (arena && (arena->nextchunk || !keep)) {
+    chunk = arena;
+    arena = arena->nextchunk;
+    FREE(chunk);
+  }
+  if (arena)
+    arena->used = 0;
+  memset(symhash, 0, sizeof(symhash));
+}
+
+/* ******************************************************************* */
+
+/* the symbol named symn; a new one if add is set, else NULL if unknown */
+static sym_st *
+intern(symn, add)
+  char   *symn;
+  int     add;
+{
+  unsigned long h = 2166136261UL;        /* FNV-1a */
+  unsigned char *c;
+  sym_st *sym;
+
+  for (c = (unsigned char *) symn; *c; c++)
+    h = ((h ^ *c) * 16777619UL) & 0xffffffffUL;
+
+  for (sym = symhash[h & (SYMHASH - 1)]; sym; sym = sym->nextsym)
+    if (sym->hash == h && !strcmp(sym->name, symn))
+      return sym;
+  if (!add)
+    return NULL;
+
+  if (((sym = (sym_st *) amalloc(sizeof(sym_st))) != NULL) &&
+      ((sym->name = astrdup(symn)) != NULL)) {
+    sym->hash = h;
+    sym->bind = NULL;
+    sym->nextsym = symhash[h & (SYMHASH - 1)];
+    symhash[h & (SYMHASH - 1)] = sym;
+  } else
+    MEMORYERROR;
+  return sym;
+}
+
+/* ******************************************************************* */
+
+/* give tbl the symbols of grp; tbl is the newest table */
+static void
+bindtbl(tbl, grp)
+  ref_st *tbl;
+  grp_st *grp;
+{
+  bind_st *bind;
+
+  tbl->grpsym = grp;
+  for (; grp; grp = grp->nextsym)
+    if ((bind = (bind_st *) amalloc(sizeof(bind_st))) != NULL) {
+      bind->tbl = tbl;
+      bind->nextbind = grp->sym->bind;
+      grp->sym->bind = bind;
+    } else
+      MEMORYERROR;
+}
+
+/* ******************************************************************* */
+
+static void
+unbindtbl(tbl)
+  ref_st *tbl;
+{
+  grp_st *grp;
+  bind_st **bind;
+
+  for (grp = tbl->grpsym; grp; grp = grp->nextsym)
+    for (bind = &grp->sym->bind; *bind; bind = &(*bind)->nextbind)
+      if ((*bind)->tbl == tbl) {
+        *bind = (*bind)->nextbind;
+        break;
+      }
+}
+
+/* ******************************************************************* */
+
 static ref_st *
 lookup(symn)
   char   *symn;
 {
-  ref_st *curtbl;
-  grp_st *symtable;
-
-  for (curtbl = reftbl; curtbl; curtbl = curtbl->nextref)
-    for (symtable = curtbl->grpsym; symtable;
-         symtable = symtable->nextsym)
-      if (!strcmp(symtable->symn, symn))
-        return curtbl;
+  sym_st *sym;
 
+  if ((sym = intern(symn, FALSE)) != NULL && sym->bind) {
+    if (sym->bind->tbl->predef)
+      predefs |= 1U << (sym->bind->tbl->predef - 1);
+    return sym->bind->tbl;
+  }
   return NULL;
 }
 
@@ -284,10 +490,11 @@ static void
 newtbl()
 {
   ref_st *curtbl;
-  if ((curtbl = (ref_st *) MALLOC(sizeof(ref_st))) != NULL) {
+  if ((curtbl = (ref_st *) amalloc(sizeof(ref_st))) != NULL) {
     curtbl->grpsym = NULL;
     curtbl->sline = NULL;
     curtbl->visit = FALSE;        /* needed to detect recursive reference */
+    curtbl->predef = 0;
     curtbl->nextref = reftbl;
     reftbl = curtbl;
   } else
@@ -303,13 +510,12 @@ addsym(symn, curgroup)
 {
   grp_st *symgrp;
 
-  if ((symgrp = (grp_st *) MALLOC(sizeof(grp_st))) != NULL)
-    if ((symgrp->symn = pstrdup(symn)) != NULL)
-      symgrp->nextsym = curgroup;
-    else {
-      FREE(symgrp);
-      MEMORYERROR;
-    }
+  if (((symgrp = (grp_st *) amalloc(sizeof(grp_st))) != NULL) &&
+      ((symgrp->sym = intern(symn, TRUE)) != NULL)) {
+    symgrp->symn = symgrp->sym->name;
+    symgrp->nextsym = curgroup;
+  } else
+    MEMORYERROR;
 
   return symgrp;
 }
@@ -317,8 +523,9 @@ addsym(symn, curgroup)
 /* ******************************************************************* */
 
 static void
-addpredef(symn, value)
+addpredef(symn, idx, value)
   char   *symn;
+  int     idx;
   U32_T   value;
 {
   grp_st *lsymtbl = NULL;
@@ -327,10 +534,11 @@ addpredef(symn, value)
   lsymtbl = addsym(symn, lsymtbl);
   sprintf(token, "%lu", (unsigned long) value);
   newtbl();
-  reftbl->grpsym = lsymtbl;
+  bindtbl(reftbl, lsymtbl);
   reftbl->reftype = RTEXT;
-  if (((aline = (line_st *) MALLOC(sizeof(line_st))) != NULL) &&
-      ((aline->vline = pstrdup(token)) != NULL)) {
+  reftbl->predef = (uChar) (idx + 1);
+  if (((aline = (line_st *) amalloc(sizeof(line_st))) != NULL) &&
+      ((aline->vline = astrdup(token)) != NULL)) {
     aline->nextline = NULL;
     reftbl->sline = aline;
   } else
@@ -343,20 +551,20 @@ static void
 addpredefs()
 {
   /* predefined constants */
-  addpredef("CORESIZE", (U32_T) coreSize);
-  addpredef("MAXPROCESSES", (U32_T) taskNum);
-  addpredef("MAXCYCLES", (U32_T) cycles);
-  addpredef("MAXLENGTH", (U32_T) instrLim);
-  addpredef("MINDISTANCE", (U32_T) separation);
-  addpredef("VERSION", (U32_T) PMARSVER);
-  addpredef("WARRIORS", (U32_T) warriors);
-  addpredef("ROUNDS", (U32_T) rounds);
+  addpredef("CORESIZE", PREDEF_CORESIZE, (U32_T) par.coreSize);
+  addpredef("MAXPROCESSES", PREDEF_MAXPROCESSES, (U32_T) par.taskNum);
+  addpredef("MAXCYCLES", PREDEF_MAXCYCLES, (U32_T) par.cycles);
+  addpredef("MAXLENGTH", PREDEF_MAXLENGTH, (U32_T) par.instrLim);
+  addpredef("MINDISTANCE", PREDEF_MINDISTANCE, (U32_T) par.separation);
+  addpredef("VERSION", PREDEF_VERSION, (U32_T) PMARSVER);
+  addpredef("WARRIORS", PREDEF_WARRIORS, (U32_T) par.warriors);
+  addpredef("ROUNDS", PREDEF_ROUNDS, (U32_T) par.rounds);
 #ifdef RWLIMIT
-  addpredef("READLIMIT", (U32_T) readLimit);
-  addpredef("WRITELIMIT", (U32_T) writeLimit);
+  addpredef("READLIMIT", PREDEF_READLIMIT, (U32_T) par.readLimit);
+  addpredef("WRITELIMIT", PREDEF_WRITELIMIT, (U32_T) par.writeLimit);
 #endif
 #ifdef PSPACE
-  addpredef("PSPACESIZE", (U32_T) pSpaceSize);
+  addpredef("PSPACESIZE", PREDEF_PSPACESIZE, (U32_T) par.pSpaceSize);
 #endif
 }
 
@@ -371,19 +579,17 @@ addline(vline, src, lspnt)
   uShrt   lspnt;
 {
   line_st *temp;
-  if ((temp = (line_st *) MALLOC(sizeof(line_st))) != NULL)
-    if ((temp->vline = pstrdup(vline)) != NULL) {
-      temp->dbginfo = (dbginfo ? TRUE : FALSE);
-      temp->linesrc = src;
-      temp->nextline = NULL;
-      if (sline[lspnt])                /* First come first serve */
-        lline[lspnt] = lline[lspnt]->nextline = temp;
-      else                        /* lline init depends on sline */
-        sline[lspnt] = lline[lspnt] = temp;
-    } else {
-      FREE(temp);
-      MEMORYERROR;
-    }
+  if (((temp = (line_st *) amalloc(sizeof(line_st))) != NULL) &&
+      ((temp->vline = astrdup(vline)) != NULL)) {
+    temp->dbginfo = (dbginfo ? TRUE : FALSE);
+    temp->linesrc = src;
+    temp->nextline = NULL;
+    if (sline[lspnt])                /* First come first serve */
+      lline[lspnt] = lline[lspnt]->nextline = temp;
+    else                        /* lline init depends on sline */
+      sline[lspnt] = lline[lspnt] = temp;
+  } else
+    MEMORYERROR;
 }
 
 /* ******************************************************************* */
@@ -395,10 +601,10 @@ addlinesrc(src, loc)
 {
   src_st *alinesrc;
 
-  if ((alinesrc = (src_st *) MALLOC(sizeof(src_st))) == NULL)
+  if (((alinesrc = (src_st *) amalloc(sizeof(src_st))) == NULL) ||
+      ((alinesrc->src = astrdup(src)) == NULL))
     MEMORYERROR;
   else {
-    alinesrc->src = pstrdup(src);
     alinesrc->loc = loc;
     alinesrc->nextsrc = srctbl;
     srctbl = alinesrc;
@@ -409,63 +615,16 @@ addlinesrc(src, loc)
 
 /* ******************************************************************* */
 
-static void
-disposeline(aline)
-  line_st *aline;
-{
-  line_st *tmp;
-
-  while ((tmp = aline) != NULL) {
-    FREE(tmp->vline);
-    aline = aline->nextline;
-    FREE(tmp);
-  }
-}
-
-/* ******************************************************************* */
-
-static void
-disposegrp(agrp)
-  grp_st *agrp;
-{
-  grp_st *tmp;
-
-  while ((tmp = agrp) != NULL) {
-    FREE(tmp->symn);
-    agrp = agrp->nextsym;
-    FREE(tmp);
-  }
-}
-
-/* ******************************************************************* */
-
-static void
-disposetbl(atbl, btbl)
-  ref_st *atbl, *btbl;
-{
-  ref_st *tmp;
-
-  while ((tmp = atbl) != btbl) {
-    disposegrp(tmp->grpsym);
-    atbl = atbl->nextref;
-    FREE(tmp);
-  }
-}
-
-/* ******************************************************************* */
-
-/* clear all allocated mem */
+/* clear all allocated mem: it all lives in the arena */
 static void
 cleanmem()
 {
-  disposeline(sline[0]);
-  disposeline(sline[1]);
   sline[0] = sline[1] = NULL;
-  disposetbl(reftbl, NULL);
   reftbl = NULL;
-  disposegrp(symtbl);
   symtbl = NULL;
+  srctbl = NULL;
   symnum = 0;
+  arelease(TRUE);
 }
 
 /* ******************************************************************* */
@@ -573,29 +732,29 @@ globalswitch(str, idx, loc, lspnt)
     i++;
 
   if (strcmp(token, "NAME") == 0) {
-    FREE(warrior[curWarrior].name);
+    FREE(curW->name);
     if (str[i] == '\0')
-      warrior[curWarrior].name = pstrdup(unknown);
+      curW->name = pstrdup(unknown);
     else
-      warrior[curWarrior].name = pstrdup((char *) str + i);
+      curW->name = pstrdup((char *) str + i);
   } else if (strcmp(token, "AUTHOR") == 0) {
-    FREE(warrior[curWarrior].authorName);
+    FREE(curW->authorName);
     if (str[i] == '\0')
-      warrior[curWarrior].authorName = pstrdup(anonymous);
+      curW->authorName = pstrdup(anonymous);
     else
-      warrior[curWarrior].authorName = pstrdup((char *) str + i);
+      curW->authorName = pstrdup((char *) str + i);
   } else if (strcmp(token, "DATE") == 0) {
-    FREE(warrior[curWarrior].date);
+    FREE(curW->date);
     if (str[i] == '\0')
-      warrior[curWarrior].date = pstrdup("");
+      curW->date = pstrdup("");
     else
-      warrior[curWarrior].date = pstrdup((char *) str + i);
+      curW->date = pstrdup((char *) str + i);
   } else if (strcmp(token, "VERSION") == 0) {
-    FREE(warrior[curWarrior].version);
+    FREE(curW->version);
     if (str[i] == '\0')
-      warrior[curWarrior].version = pstrdup("");
+      curW->version = pstrdup("");
     else
-      warrior[curWarrior].version = pstrdup((char *) str + i);
+      curW->version = pstrdup((char *) str + i);
   } else if (str_in_set(token, swname) < SWNUM) {
     nocmnt(str + i);                /* don't remove first comment */
     addline(str, addlinesrc(str, loc), lspnt);
@@ -621,8 +780,13 @@ lineswitch(str, idx, aline)        /* line switch */
     get_token(str, &i, token);
     to_upper(token);
     if ((dbgproceed = strcmp(token, "OFF")) != 0) {
-      debugState = BREAK;
-      if ((copyDebugInfo = strcmp(token, "STATIC") ? TRUE : FALSE) == TRUE)
+      int     copy = strcmp(token, "STATIC") ? TRUE : FALSE;
+
+      if (!bail) {                /* assemble_buffer() leaves them alone */
+        debugState = BREAK;
+        copyDebugInfo = copy;
+      }
+      if (copy == TRUE)
         if (*token)
           errprn(IGNORE, aline, str);
     }
@@ -652,6 +816,14 @@ static void
 textout(str)
   char   *str;
 {
+  if (bail) {
+    if (diag) {
+      size_t  len = strlen(diag->text);
+
+      strncat(diag->text, str, sizeof(diag->text) - 1 - len);
+    }
+    return;
+  }
 #ifdef MACGRAPHX
   macputs(str);
 #else
@@ -701,13 +873,13 @@ errprn(code, aline, arg)
 {
   char    abuf[MAXALLCHAR];
 
-  errorcode = PARSEERR;
-  errorlevel = SERIOUS;
+  errcode = PARSEERR;
+  errlevel = SERIOUS;
 
   switch (code) {
   case ANNERR:
     strcpy(abuf, illegalAppendErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case BUFERR:
     strcpy(abuf, bufferOverflowErr);
@@ -723,18 +895,18 @@ errprn(code, aline, arg)
     break;
   case ROFERR:
     strcpy(abuf, unclosedROFErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case M88ERR:
     sprintf(abuf, bad88FormatErr, arg);
     break;
   case ZLNERR:
     strcpy(abuf, noInstErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case DLBERR:
     sprintf(abuf, discardLabelErr, arg);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case TOKERR:
     sprintf(abuf, tokenErr, arg);
@@ -765,33 +937,33 @@ errprn(code, aline, arg)
     break;
   case OFLERR:
     strcpy(abuf, overflowErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case NASERR:
     strcpy(abuf, missingAssertErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case OFSERR:
     strcpy(abuf, badOffsetErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case CATERR:
     sprintf(abuf, concatErr, arg);
     break;
   case DOEERR:
     strcpy(abuf, ignoreENDErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case BASERR:
     strcpy(abuf, invalidAssertErr);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case EXXERR:
     sprintf(abuf, tooMuchStuffErr, MAXINSTR);
     break;
   case IGNORE:
     sprintf(abuf, extraTokenErr, arg);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case APPERR:
     sprintf(abuf, improperPlaceErr, arg);
@@ -804,11 +976,11 @@ errprn(code, aline, arg)
     break;
   case IDNERR:
     sprintf(abuf, redefinitionErr, arg);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case UDFERR:
     sprintf(abuf, undefinedLabelErr, arg);
-    errorlevel = WARNING;
+    errlevel = WARNING;
     break;
   case CHKERR:
     strcpy(abuf, assertionFailErr);
@@ -827,13 +999,16 @@ errprn(code, aline, arg)
 #ifdef __MAC__
     textout(notEnoughMemErr);
 #else
-    fprintf(stderr, notEnoughMemErr);
+    if (bail)
+      textout(notEnoughMemErr);
+    else
+      fprintf(stderr, notEnoughMemErr);
 #endif
-    Exit(MEMERR);
+    fatal(MEMERR);
     break;
   }
 
-  if (errorlevel == WARNING)
+  if (errlevel == WARNING)
     warnum++;
   else
     errnum++;
@@ -850,7 +1025,7 @@ errprn(code, aline, arg)
       i++;
 
     if (i == ierr) {
-      sprintf(outs, "%s", errorlevel == WARNING ? warning : error);
+      sprintf(outs, "%s", errlevel == WARNING ? warning : error);
 #ifndef VMS
       textout(outs);
 #else                                /* if defined(VMS) */
@@ -859,8 +1034,8 @@ errprn(code, aline, arg)
       else {
         fprintf(dias, "%s", StartDia);
         fprintf(dias, "%s %s %s %s %d %s\"%s\"\n", Region,
-                warrior[curWarrior].fileName, AllLine, LineQualifier, aline->
-             linesrc->loc, Label, errorlevel == WARNING ? LSEWarn : LSEErr);
+                curW->fileName, AllLine, LineQualifier, aline->
+             linesrc->loc, Label, errlevel == WARNING ? LSEWarn : LSEErr);
       }
 
       if (!SWITCH_D) {
@@ -882,7 +1057,7 @@ errprn(code, aline, arg)
       errkeep[i].num++;
   } else {
     sprintf(outs, "%s:\n",
-            errorlevel == WARNING ? warning : error);
+            errlevel == WARNING ? warning : error);
 
 #ifndef VMS
     textout(outs);
@@ -892,8 +1067,8 @@ errprn(code, aline, arg)
     else {
       fprintf(dias, "%s", StartDia);
       fprintf(dias, "%s %s %s %s\"%s\"\n", Region,
-              warrior[curWarrior].fileName, AllLine, Label,
-              errorlevel == WARNING ? LSEWarn : LSEErr);
+              curW->fileName, AllLine, Label,
+              errlevel == WARNING ? LSEWarn : LSEErr);
     }
 #endif
     sprintf(outs, "        %s\n", abuf);
@@ -923,10 +1098,31 @@ errprn(code, aline, arg)
     }
 #endif
 
-    Exit(PARSEERR);
+    fatal(PARSEERR);
 
   }
-  strcpy(errmsg, abuf);
+  if (!bail) {
+    errorcode = errcode;
+    errorlevel = errlevel;
+    strcpy(errmsg, abuf);
+  } else if (diag) {
+    strncpy(diag->message, abuf, sizeof(diag->message) - 1);
+    diag->message[sizeof(diag->message) - 1] = '\0';
+  }
+}
+
+/* ******************************************************************* */
+
+/* give up: pmars exits, assemble_buffer() and pmars --batch return */
+static void
+fatal(code)
+  int     code;
+{
+  if (bail)
+    longjmp(*bail, code);
+  if (giveup)
+    longjmp(*giveup, code);
+  Exit(code);
 }
 
 /* ******************************************************************* */
@@ -934,14 +1130,14 @@ errprn(code, aline, arg)
 #define A_expr buf
 #define B_expr buf2
 #define vallen 8
-static uChar opcode, modifier;
-static uChar statefine;
-static stateCol laststate;
+static THREAD_LOCAL uChar opcode, modifier;
+static THREAD_LOCAL uChar statefine;
+static THREAD_LOCAL stateCol laststate;
 
-static uShrt line, linemax;
-static uChar vcont;
-static uShrt dspnt;
-static line_st *aline;
+static THREAD_LOCAL uShrt line, linemax;
+static THREAD_LOCAL uChar vcont;
+static THREAD_LOCAL uShrt dspnt;
+static THREAD_LOCAL line_st *aline;
 
 /* ******************************************************************* */
 
@@ -983,7 +1179,7 @@ automaton(expr, state, cell)
       cell->A_mode = (FIELD_T) ch_in_set(*token, addr_sym);
 #ifdef NEW_MODES
       if (cell->A_mode > 4) {
-        if (SWITCH_8)
+        if (par.sw8)
           errprn(M88ERR, aline, "[*{}]");
         else
           cell->A_mode = SYM_TO_INDIR_A(cell->A_mode);
@@ -1053,7 +1249,7 @@ automaton(expr, state, cell)
       cell->A_mode = (FIELD_T) ch_in_set(*token, addr_sym);
 #ifdef NEW_MODES
       if (cell->A_mode > 4) {
-        if (SWITCH_8)
+        if (par.sw8)
           errprn(M88ERR, aline, "[*{}]");
         else
           cell->A_mode = SYM_TO_INDIR_A(cell->A_mode);
@@ -1169,7 +1365,7 @@ automaton(expr, state, cell)
       cell->B_mode = (FIELD_T) ch_in_set(*token, addr_sym);
 #ifdef NEW_MODES
       if (cell->B_mode > 4) {
-        if (SWITCH_8)
+        if (par.sw8)
           errprn(M88ERR, aline, "[*{}]");
         else
           cell->B_mode = SYM_TO_INDIR_A(cell->B_mode);
@@ -1292,13 +1488,13 @@ dfashell(expr, cell)
   modifier = MODNUM;                /* marked as not used */
   A_expr[0] = B_expr[0] = '\0';
 
-  errorcode = SUCCESS;
+  errcode = SUCCESS;
   automaton(expr, S_OP, cell);
 
   if (opcode < OPNUM) {
 
 /* This is also represented in a NONE case in automaton function call */
-    if ((statefine == FALSE) && (errorcode == SUCCESS))
+    if ((statefine == FALSE) && (errcode == SUCCESS))
       errprn(SYNERR, aline, opname[opcode]);
 
     else if (B_expr[0] == '\0')        /* If there's only one argument */
@@ -1321,7 +1517,7 @@ dfashell(expr, cell)
         errprn(NOPERR, aline, opname[opcode]);        /* opcode < OPNUM */
       }
 
-    if (SWITCH_8) {
+    if (par.sw8) {
       switch (opcode) {
       case DAT:
         if (((cell->A_mode != (FIELD_T) IMMEDIATE) &&
@@ -1427,10 +1623,10 @@ static int
 normalize(value)
   long    value;
 {
-  while (value >= (long) coreSize)
-    value -= (long) coreSize;
+  while (value >= par.coreSize)
+    value -= par.coreSize;
   while (value < 0)
-    value += (long) coreSize;
+    value += par.coreSize;
   return ((int) value);
 }
 
@@ -1447,14 +1643,14 @@ encode(sspnt)
 
   if (line <= MAXINSTR) {
 
-    if (line > (uShrt) instrLim) {
-      sprintf(buf, "%d", (int) line - instrLim);
+    if (line > (uShrt) par.instrLim) {
+      sprintf(buf, "%d", (int) (line - par.instrLim));
       errprn(LINERR, (line_st *) NULL, buf);
     }
-    warrior[curWarrior].instLen = line;
+    curW->instLen = line;
 
     if (line)
-      if ((warrior[curWarrior].instBank = base = (mem_struct *)
+      if ((curW->instBank = base = (mem_struct *)
            MALLOC((line + 1) * sizeof(mem_struct))) != NULL) {
         for (aline = sline[sspnt], line = 0; aline; aline = aline->nextline) {
           dfashell(aline->vline, (mem_struct *) base + line);
@@ -1478,24 +1674,24 @@ encode(sspnt)
                 if (evalerrA == OVERFLOW)
                   errprn(OFLERR, aline, "");
 
-                if ((opcode == ORGOP || opcode == PINOP) && SWITCH_8)
+                if ((opcode == ORGOP || opcode == PINOP) && par.sw8)
                   errprn(M88ERR, aline, opname[opcode]);
 
                 if (opcode == ORGOP)
-                  warrior[curWarrior].offset = normalize(resultB);
+                  curW->offset = normalize(resultB);
 #ifdef SHARED_PSPACE
                 else if (opcode == PINOP) {
-                  warrior[curWarrior].pSpaceIDNumber = resultB;        /* not an address, no
+                  curW->pSpaceIDNumber = resultB;        /* not an address, no
                                                                  * need to normalize */
-                  warrior[curWarrior].pSpaceIndex = PIN_APPEARED;        /* to indicate PIN has
+                  curW->pSpaceIndex = PIN_APPEARED;        /* to indicate PIN has
                                                                          * been set */
                 }
 #endif
                 else if (resultB)
-                  if (warrior[curWarrior].offset)
+                  if (curW->offset)
                     errprn(DOEERR, aline, "");
                   else
-                    warrior[curWarrior].offset = normalize(resultB);
+                    curW->offset = normalize(resultB);
                 /* else ignore 'end' with parameter == 0L */
               }
             else if ((evalerrA = eval_expr(A_expr, &resultA)) < OK_EXPR) {
@@ -1514,12 +1710,13 @@ encode(sspnt)
               base[line].A_value = (ADDR_T) normalize(resultA);
               base[line].B_value = (ADDR_T) normalize(resultB);
               if ((base[line++].debuginfo = (FIELD_T) aline->dbginfo) != 0)
-                debugState = BREAK;
+                if (!bail)
+                  debugState = BREAK;
             }
           }
         }
-        if ((warrior[curWarrior].offset < 0) ||
-            (warrior[curWarrior].offset >= warrior[curWarrior].instLen))
+        if ((curW->offset < 0) ||
+            (curW->offset >= curW->instLen))
           errprn(OFSERR, (line_st *) NULL, "");
       } else
         MEMORYERROR;
@@ -1557,7 +1754,7 @@ blkfor(expr, dest)
     if (symtbl->nextsym) {
       newtbl();
       reftbl->reftype = RLABEL;
-      reftbl->grpsym = symtbl->nextsym;
+      bindtbl(reftbl, symtbl->nextsym);
       reftbl->value = line;
     }
     symtbl = NULL;
@@ -1568,7 +1765,7 @@ blkfor(expr, dest)
   *dest = '\0';
   trav2(expr, dest, SVAL);
 
-  if (SWITCH_V) {
+  if (par.swV) {
     sprintf(outs, currentFORMsg, dest);
     textout(outs);
   }
@@ -1587,7 +1784,7 @@ blkfor(expr, dest)
 
     newtbl();
     reftbl->reftype = RSTACK;
-    reftbl->grpsym = forSymGr;
+    bindtbl(reftbl, forSymGr);
     reftbl->visit = 1;
     atbl = reftbl;
 
@@ -1621,7 +1818,7 @@ blkfor(expr, dest)
     else
       reftbl = atbl->nextref;
 
-    disposetbl(atbl, atbl->nextref);
+    unbindtbl(atbl);
   }
 
   return SFOR;
@@ -1640,12 +1837,12 @@ equtbl(expr)
 
     newtbl();
     reftbl->reftype = RTEXT;
-    reftbl->grpsym = symtbl;
+    bindtbl(reftbl, symtbl);
     symtbl = NULL;
     symnum = 0;
 
-    if (((cline = (line_st *) MALLOC(sizeof(line_st))) != NULL) &&
-        ((cline->vline = pstrdup(expr)) != NULL)) {
+    if (((cline = (line_st *) amalloc(sizeof(line_st))) != NULL) &&
+        ((cline->vline = astrdup(expr)) != NULL)) {
       cline->linesrc = aline->linesrc;
       cline->nextline = NULL;
       pline = reftbl->sline = cline;
@@ -1660,8 +1857,8 @@ equtbl(expr)
       if (strcmp(token, "EQU") == 0) {
         aline = aline->nextline;
 
-        if (((cline = (line_st *) MALLOC(sizeof(line_st))) != NULL) &&
-            ((cline->vline = pstrdup((char *) aline->vline + i)) != NULL)) {
+        if (((cline = (line_st *) amalloc(sizeof(line_st))) != NULL) &&
+            ((cline->vline = astrdup((char *) aline->vline + i)) != NULL)) {
           cline->linesrc = aline->linesrc;
           cline->nextline = NULL;
           pline = pline->nextline = cline;
@@ -1749,7 +1946,7 @@ trav2(buffer, dest, wdecl)
 
         trav2((char *) buffer + idx, dest, SVAL);
 
-        if (SWITCH_V) {
+        if (par.swV) {
           sprintf(outs, currentAssertMsg, dest);
           textout(outs);
         }
@@ -1842,7 +2039,7 @@ trav2(buffer, dest, wdecl)
               newtbl();
               reftbl->reftype = RLABEL;
               reftbl->value = line;
-              reftbl->grpsym = symtbl;
+              bindtbl(reftbl, symtbl);
               symtbl = NULL;
               symnum = 0;
             }
@@ -1946,12 +2143,11 @@ expand(sspnt)
   uShrt   sspnt;
 {
   dspnt = 1 - sspnt;
-  disposeline(sline[dspnt]);
   sline[dspnt] = NULL;
 
   vcont = TRUE;
   statefine = 0;
-  linemax = (uShrt) instrLim + LEXCMAX;
+  linemax = (uShrt) par.instrLim + LEXCMAX;
 
   aline = sline[sspnt];
   while (aline && vcont) {
@@ -1986,6 +2182,7 @@ parse(expr, cell, loc)
   uChar   i = 0;
   uShrt   sspnt = 0;
 
+  loadpar();
   errnum = warnum = 0;
   ierr = 0;
   aline = NULL;
@@ -2004,7 +2201,6 @@ parse(expr, cell, loc)
 
   line = (uShrt) dloc;
   expand(sspnt);
-  disposeline(sline[sspnt]);
   sline[sspnt] = NULL;
   sspnt = 1 - sspnt;
 
@@ -2040,18 +2236,9 @@ parse(expr, cell, loc)
           }
         }
   }
-  disposeline(sline[0]);
-  disposeline(sline[1]);
+  /* the lines stay in the arena until the next assemble() */
   sline[0] = sline[1] = NULL;
-
-  while (srctbl) {
-    src_st *tmp;
-
-    tmp = srctbl;
-    srctbl = srctbl->nextsrc;
-    FREE(tmp->src);
-    FREE(tmp);
-  }
+  srctbl = NULL;
 
   if (dloc < loc)
     dloc = coreSize - loc + dloc;
@@ -2066,287 +2253,377 @@ parse(expr, cell, loc)
 
 /* ******************************************************************* */
 
-static char stdinstart = 0;
+static THREAD_LOCAL char stdinstart = 0;
 
-int
-assemble(fName, aWarrior)
-  char   *fName;
-  int     aWarrior;
+/* assemble() and parse() use the pmars settings */
+static void
+loadpar()
 {
-  FILE   *infp;
-  uChar   cont = TRUE, conLine = FALSE, i;
-  uShrt   lines;                /* logical and physical lines */
-  uShrt   spnt = 0;                /* index/pointer to sline and lline */
-
-#ifdef VMS
-  char    DIAfilename[256], *temp;
+  par.coreSize = (long) coreSize;
+  par.taskNum = (long) taskNum;
+  par.cycles = (long) cycles;
+  par.instrLim = (long) instrLim;
+  par.separation = (long) separation;
+  par.warriors = (long) warriors;
+  par.rounds = (long) rounds;
+#ifdef RWLIMIT
+  par.readLimit = (long) readLimit;
+  par.writeLimit = (long) writeLimit;
 #endif
-
-#ifdef ASM_DEBUG
-  printf("Entering assemble sub\n");
+#ifdef PSPACE
+  par.pSpaceSize = (long) pSpaceSize;
 #endif
+  par.sw8 = SWITCH_8;
+  par.swV = SWITCH_V;
+}
 
-  errorlevel = WARNING;
-  errorcode = SUCCESS;
-  *errmsg = '\0';
+/* ******************************************************************* */
+
+/* fgets() on the source */
+static char *
+srcgets(s, n)
+  char   *s;
+  int     n;
+{
+  int     k = 0;
+
+  if (srcfp)
+    return fgets(s, n, srcfp);
+  if (srcp >= srcend)
+    return NULL;
+  while (k < n - 1 && srcp < srcend)
+    if ((s[k++] = *srcp++) == '\n')
+      break;
+  s[k] = '\0';
+  return s;
+}
+
+/* ******************************************************************* */
+
+/* start on curW */
+static void
+asmstart()
+{
   errnum = warnum = 0;
 
   pass = 0;
 
-  srctbl = NULL;
-  sline[0] = sline[1] = NULL;
-  reftbl = NULL;
-  symtbl = NULL;
-  symnum = 0;
+  /* the predefined symbols left for cdb() (and what parse() added) */
+  cleanmem();
 
-  lines = 0;
   ierr = 0;
 
   if ((errkeep = (err_st *) MALLOC(sizeof(err_st) * ERRMAX)) == NULL)
     MEMORYERROR;
 
-  curWarrior = aWarrior;
-  warrior[curWarrior].name = pstrdup(unknown);
-  warrior[curWarrior].authorName = pstrdup(anonymous);
-  warrior[curWarrior].date = pstrdup("");
-  warrior[curWarrior].version = pstrdup("");
+  curW->name = pstrdup(unknown);
+  curW->authorName = pstrdup(anonymous);
+  curW->date = pstrdup("");
+  curW->version = pstrdup("");
 #ifdef PSPACE
-  warrior[curWarrior].pSpaceIndex = UNSHARED;        /* tag */
-#endif
-  /* These two inits turn out to be neccessary */
-  warrior[curWarrior].instBank = NULL;
-  warrior[curWarrior].instLen = 0;
-
-#ifdef VMS
-  if (SWITCH_D) {
-    temp = strstr(warrior[curWarrior].fileName, "]");        /* Look for dir spec */
-    if (temp == NULL) {
-      temp = strstr(warrior[curWarrior].fileName, ":");
-      if (temp == NULL)
-        temp = warrior[curWarrior].fileName;
-      else
-        temp++;                        /* Bypass ":" */
-    } else
-      temp++;                        /* bypass "]" */
-    strcpy(DIAfilename, temp);
-    temp = strstr(DIAfilename, ".");
-    if (temp == NULL)
-      strcat(DIAfilename, ".DIA");
-    else
-      strcpy(temp, ".DIA");
-    printf("%s %s.", Opening, DIAfilename);
-    dias = fopen(DIAfilename, "w");
-    fprintf(dias, "%s", StartMod);
-  }
+  curW->pSpaceIndex = UNSHARED;        /* tag */
 #endif
+  /* These inits turn out to be neccessary */
+  curW->instBank = NULL;
+  curW->instLen = 0;
+  curW->offset = 0;
+  curW->predefs = predefs = 0;
 
   dbgproceed = TRUE;
   dbginfo = FALSE;
   noassert = TRUE;
 
   addpredefs();
+}
+
+/* ******************************************************************* */
+
+/* read the source into sline[0]; FALSE on a read error. *pstart counts
+   the ;redcode lines seen (stdin may hold several warriors) */
+static int
+asmread(fName, pstart)
+  char   *fName;
+  char   *pstart;
+{
+  uChar   cont = TRUE, conLine = FALSE, i;
+  uShrt   lines;                /* logical and physical lines */
+  uShrt   spnt = 0;                /* index/pointer to sline and lline */
 
 #ifdef ASM_DEBUG
   printf("Entering file reading module\n");
 #endif
 
-  if ((*fName == '\0') || (infp = fopen(fName, "r")) != NULL) {
-
-    char    pstart;
-
-    if (*fName == '\0') {
-      infp = stdin;
-      pstart = stdinstart;
-    } else
-      pstart = 0;
-
-    lines = 0;
-    aline = NULL;
+  lines = 0;
+  aline = NULL;
 
-    while (cont) {
+  while (cont) {
+
+    /*
+     * Read characters until newline or EOF encountered. newline is
+     * excluded. Need to be non-strict boolean evaluation
+     */
+    *buf = '\0';
+    i = 0;                        /* pointer to line buffer start */
+    int commentfound = FALSE;
+    do {
+      if (srcgets(buf + i, MAXALLCHAR - i)) {
+        for (; buf[i]; i++) {
+          if (buf[i] == ';') commentfound = TRUE;
+          if (buf[i] == '\n' || buf[i] == '\r')
+            break;
+          }
+        buf[i] = 0;
+        if (i > 0 && buf[i - 1] == '\\' && commentfound == FALSE) {        /* line continued */
+          conLine = TRUE;
+          buf[--i] = 0;        /* reset */
+        } else
+          conLine = FALSE;
+      } else if (srcfp && ferror(srcfp)) {
+        errprn(DSKERR, (line_st *) NULL, fName);
+        return FALSE;
+      } else
+        cont = (srcfp && feof(srcfp) == 0);
+    } while (conLine == TRUE);
+    lines++;
+    i = 0;
 
+    switch (get_token(buf, &i, token)) {
       /*
-       * Read characters until newline or EOF encountered. newline is
-       * excluded. Need to be non-strict boolean evaluation
+       * COMMTOKEN before any non-whitespace chars may contains switches.
+       * We treat them first and therefore we don't have to save it in
+       * sline
        */
-      *buf = '\0';
-      i = 0;                        /* pointer to line buffer start */
-      int commentfound = FALSE;
-      do {
-        if (fgets(buf + i, MAXALLCHAR - i, infp)) {
-          for (; buf[i]; i++) {
-            if (buf[i] == ';') commentfound = TRUE;
-            if (buf[i] == '\n' || buf[i] == '\r')
-              break;
-            }
-          buf[i] = 0;
-          if (buf[i - 1] == '\\' && commentfound == FALSE) {        /* line continued */
-            conLine = TRUE;
-            buf[--i] = 0;        /* reset */
-          } else
-            conLine = FALSE;
-        } else if (ferror(infp)) {
-          errprn(DSKERR, (line_st *) NULL, fName);
-          fclose(infp);
-          return PARSEERR;
-        } else
-          cont = (feof(infp) == 0);
-      } while (conLine == TRUE);
-      lines++;
-      i = 0;
-
-      switch (get_token(buf, &i, token)) {
-        /*
-         * COMMTOKEN before any non-whitespace chars may contains switches.
-         * We treat them first and therefore we don't have to save it in
-         * sline
-         */
-      case COMMTOKEN:
-        if (globalswitch(buf, (uShrt) i, lines, spnt))        /* REDCODE? */
-          switch (pstart) {
-          case 0:
-            disposeline(sline[spnt]);
-            sline[spnt] = lline[spnt] = NULL;
-            pstart++;
-            break;
-          case 1:
-            pstart++;
-            /* fallthru */
-          case 2:
-            cont = 0;
-            break;
-          }
-        break;
+    case COMMTOKEN:
+      if (globalswitch(buf, (uShrt) i, lines, spnt))        /* REDCODE? */
+        switch (*pstart) {
+        case 0:
+          sline[spnt] = lline[spnt] = NULL;
+          (*pstart)++;
+          break;
+        case 1:
+          (*pstart)++;
+          /* fallthru */
+        case 2:
+          cont = 0;
+          break;
+        }
+      break;
 #if 0                                /* no longer scanning for END, ;redcode req'd
                                  * between warriors in stdin */
-      case CHARTOKEN:
-        nocmnt(buf);
-        do {
-          to_upper(token);
-          if (strcmp(token, "END") == 0) {
-            cont = 0;
-            break;
-          }
-        } while (get_token(buf, &i, token) != NONE);
-        addline(buf, addlinesrc(buf, lines), spnt);
-        break;
+    case CHARTOKEN:
+      nocmnt(buf);
+      do {
+        to_upper(token);
+        if (strcmp(token, "END") == 0) {
+          cont = 0;
+          break;
+        }
+      } while (get_token(buf, &i, token) != NONE);
+      addline(buf, addlinesrc(buf, lines), spnt);
+      break;
 #endif
-      case NONE:
-        break;
-      default:
-        nocmnt(buf);                /* saving some space */
-        addline(buf, addlinesrc(buf, lines), spnt);
-        break;
-      }
+    case NONE:
+      break;
+    default:
+      nocmnt(buf);                /* saving some space */
+      addline(buf, addlinesrc(buf, lines), spnt);
+      break;
     }
+  }
 
-    if (pstart)
-      pstart--;
+  if (*pstart)
+    (*pstart)--;
+  return TRUE;
+}
 
-    if (*fName)
-      fclose(infp);
-    else
-      stdinstart = pstart;        /* save value for next stdin reference */
+/* ******************************************************************* */
 
-    if (SWITCH_V) {
-      show_info(spnt);
-      textout(paramCheckMsg);
-    }
+/* expand, then encode into curW */
+static void
+asmpasses(spnt)
+  uShrt   spnt;
+{
+  if (par.swV) {
+    show_info(spnt);
+    textout(paramCheckMsg);
+  }
 #ifdef ASM_DEBUG
-    printf("Entering pass 1 (expand and shrink)\n");
+  printf("Entering pass 1 (expand and shrink)\n");
 #endif
 
-    line = 0;
-    expand(spnt);
+  line = 0;
+  expand(spnt);
 
-    if (symtbl) {
-      grp_st *tmp;
+  if (symtbl) {
+    grp_st *tmp;
 
-      *buf = '\0';
-      for (tmp = symtbl; tmp; tmp = tmp->nextsym) {
-        if (*buf)
-          if (!concat(buf, " "))
-            break;
-        if (!concat(buf, tmp->symn))
+    *buf = '\0';
+    for (tmp = symtbl; tmp; tmp = tmp->nextsym) {
+      if (*buf)
+        if (!concat(buf, " "))
           break;
-      }
-
-      errprn(DLBERR, (line_st *) NULL, buf);
-      disposegrp(symtbl);        /* discount any symtbl with empty reference */
-      symtbl = NULL;
-      symnum = 0;
+      if (!concat(buf, tmp->symn))
+        break;
     }
-    spnt = 1 - spnt;
-    pass++;
 
-    if (noassert)
-      errprn(NASERR, (line_st *) NULL, "");
+    errprn(DLBERR, (line_st *) NULL, buf);
+    symtbl = NULL;                /* discount any symtbl with empty reference */
+    symnum = 0;
+  }
+  spnt = 1 - spnt;
+  pass++;
 
-    if (SWITCH_V) {
-      textout("\n");
-      show_info(spnt);
-      show_lbl();
-    }
+  if (noassert)
+    errprn(NASERR, (line_st *) NULL, "");
+
+  if (par.swV) {
+    textout("\n");
+    show_info(spnt);
+    show_lbl();
+  }
 #ifdef ASM_DEBUG
-    printf("Entering pass 2 (parsing and loading)\n");
+  printf("Entering pass 2 (parsing and loading)\n");
 #endif
-    encode(spnt);
+  encode(spnt);
+  curW->predefs = predefs;
 
-    dbginfo = FALSE;
-    dbgproceed = TRUE;
+  dbginfo = FALSE;
+  dbgproceed = TRUE;
 
 #ifdef ASM_DEBUG
-    printf("Disclaiming all temporary storage\n");
+  printf("Disclaiming all temporary storage\n");
 #endif
-    /* release all allocated memory */
-    cleanmem();
-    while (srctbl) {
-      src_st *tmp;
-
-      tmp = srctbl;
-      srctbl = srctbl->nextsrc;
-      FREE(tmp->src);
-      FREE(tmp);
-    }
+  /* release all allocated memory */
+  cleanmem();
+}
 
-    /* leave it for cdb() */
-    addpredefs();
+/* ******************************************************************* */
 
-    if (errnum) {
-      FREE(warrior[curWarrior].instBank);
-      warrior[curWarrior].instBank = NULL;
-      warrior[curWarrior].instLen = 0;
-    }
+/* drop the code if there were errors, and sum up the messages */
+static void
+asmreport()
+{
+  if (errnum) {
+    FREE(curW->instBank);
+    curW->instBank = NULL;
+    curW->instLen = 0;
+  }
 #ifndef SERVER
-    if (errnum + warnum) {
-      if (*warrior[curWarrior].fileName)
-        sprintf(outs, "\nSource: filename '%s'\n", warrior[curWarrior].fileName);
-      else
-        sprintf(outs, "\nSource: standard input (%s by %s)\n",
-                warrior[curWarrior].name, warrior[curWarrior].authorName);
-      textout(outs);
-    }
+  if (errnum + warnum) {
+    if (bail)
+      sprintf(outs, "\nSource: %s by %s\n", curW->name, curW->authorName);
+    else if (*curW->fileName)
+      sprintf(outs, "\nSource: filename '%s'\n", curW->fileName);
+    else
+      sprintf(outs, "\nSource: standard input (%s by %s)\n",
+              curW->name, curW->authorName);
+    textout(outs);
+  }
 #endif
-    if (errnum) {
-      sprintf(outs, errNumMsg, errnum);
-      textout(outs);
-    }
-    if (warnum) {
-      sprintf(outs, warNumMsg, warnum);
+  if (errnum) {
+    sprintf(outs, errNumMsg, errnum);
+    textout(outs);
+  }
+  if (warnum) {
+    sprintf(outs, warNumMsg, warnum);
+    textout(outs);
+  }
+  while (ierr)
+    if (errkeep[--ierr].num > 1) {
+      sprintf(outs, duplicateMsg, errkeep[ierr].loc, errkeep[ierr].num);
       textout(outs);
     }
-    while (ierr)
-      if (errkeep[--ierr].num > 1) {
-        sprintf(outs, duplicateMsg, errkeep[ierr].loc, errkeep[ierr].num);
-        textout(outs);
-      }
-    if (errnum + warnum) {
-      sprintf(outs, "\n");
-      textout(outs);
+  if (errnum + warnum) {
+    sprintf(outs, "\n");
+    textout(outs);
+  }
+}
+
+/* ******************************************************************* */
+
+static int
+asmfile(fName, aWarrior)
+  char   *fName;
+  int     aWarrior;
+{
+#ifdef VMS
+  char    DIAfilename[256], *temp;
+#endif
+
+#ifdef ASM_DEBUG
+  printf("Entering assemble sub\n");
+#endif
+
+  errorlevel = WARNING;
+  errorcode = SUCCESS;
+  *errmsg = '\0';
+
+  loadpar();
+  curW = &warrior[aWarrior];
+
+#ifdef VMS
+  if (SWITCH_D) {
+    temp = strstr(curW->fileName, "]");        /* Look for dir spec */
+    if (temp == NULL) {
+      temp = strstr(curW->fileName, ":");
+      if (temp == NULL)
+        temp = curW->fileName;
+      else
+        temp++;                        /* Bypass ":" */
+    } else
+      temp++;                        /* bypass "]" */
+    strcpy(DIAfilename, temp);
+    temp = strstr(DIAfilename, ".");
+    if (temp == NULL)
+      strcat(DIAfilename, ".DIA");
+    else
+      strcpy(temp, ".DIA");
+    printf("%s %s.", Opening, DIAfilename);
+    dias = fopen(DIAfilename, "w");
+    fprintf(dias, "%s", StartMod);
+  }
+#endif
+
+  asmstart();
+
+  if ((*fName == '\0') || (srcfp = fopen(fName, "r")) != NULL) {
+
+    char    pstart;
+
+    if (*fName == '\0') {
+      srcfp = stdin;
+      pstart = stdinstart;
+    } else
+      pstart = 0;
+
+    if (!asmread(fName, &pstart)) {
+      if (*fName)
+        fclose(srcfp);
+      srcfp = NULL;
+      FREE(errkeep);
+      errkeep = NULL;
+      return PARSEERR;
     }
+
+    if (*fName)
+      fclose(srcfp);
+    else
+      stdinstart = pstart;        /* save value for next stdin reference */
+    srcfp = NULL;
+
+    asmpasses(0);
+
+    /* leave it for cdb() */
+    addpredefs();
+
+    asmreport();
   } else
     errprn(FNFERR, (line_st *) NULL, fName);
 
+  /* assemble() may be called many times by a worker, don't leak this */
+  FREE(errkeep);
+  errkeep = NULL;
+
   if (errnum)
     errorcode = PARSEERR;
   else
@@ -2361,3 +2638,184 @@ assemble(fName, aWarrior)
 #endif
   return (errorcode);
 }
+
+int
+assemble(fName, aWarrior)
+  char   *fName;
+  int     aWarrior;
+{
+  jmp_buf jb;
+  int     code;
+
+  if (!batchMode)
+    return asmfile(fName, aWarrior);
+  if (setjmp(jb)) {                /* out of memory, too many errors */
+    giveup = NULL;
+    if (srcfp && srcfp != stdin)
+      fclose(srcfp);
+    srcfp = NULL;
+    cleanmem();
+    FREE(curW->instBank);
+    curW->instBank = NULL;
+    curW->instLen = 0;
+    FREE(errkeep);
+    errkeep = NULL;
+    reset_regs();
+    return errorcode = PARSEERR;
+  }
+  giveup = &jb;
+  code = asmfile(fName, aWarrior);
+  giveup = NULL;
+  return code;
+}
+
+/* ******************************************************************* */
+
+static THREAD_LOCAL warrior_struct memW;        /* what assemble_buffer()
+                                                 * assembles into */
+
+int
+assemble_buffer(src, len, params, out, dg)
+  const char *src;
+  size_t  len;
+  const battle_params *params;
+  assembled_warrior *out;
+  diagnostics *dg;
+{
+  warrior_struct *saveW = curW;
+  jmp_buf jb;
+  int     status, i;
+
+  memset(out, 0, sizeof(*out));
+  if (dg) {
+    dg->errors = dg->warnings = 0;
+    dg->message[0] = dg->text[0] = '\0';
+  }
+
+  if (params) {                        /* the limits of clparse.c */
+    if (params->coreSize < 1 || params->coreSize > MAXCORESIZE ||
+        params->maxLength < 1 || params->maxLength > MAXINSTR ||
+        params->minDistance < params->maxLength ||
+        params->minDistance > MAXSEPARATION ||
+        params->cycles < 1 || params->processes < 1 || params->rounds < 1 ||
+        params->warriors < 0 || params->warriors > MAXWARRIOR)
+      return BATTLE_BADREQ;
+    par.coreSize = params->coreSize;
+    par.taskNum = params->processes;
+    par.cycles = params->cycles;
+    par.instrLim = params->maxLength;
+    par.separation = params->minDistance;
+    par.rounds = params->rounds;
+    par.warriors = params->warriors ? params->warriors : DEFAULTWARRIOR;
+  } else {
+    par.coreSize = DEFAULTCORESIZE;
+    par.taskNum = DEFAULTTASKNUM;
+    par.cycles = DEFAULTCYCLES;
+    par.instrLim = DEFAULTINSTRLIM;
+    par.separation = DEFAULTSEPARATION;
+    par.rounds = DEFAULTROUNDS;
+    par.warriors = DEFAULTWARRIOR;
+  }
+  par.readLimit = par.writeLimit = par.coreSize;
+  par.pSpaceSize = 0;
+  for (i = 16; i > 0 && !par.pSpaceSize; --i)        /* as clparse.c does */
+    if (!(par.coreSize % i))
+      par.pSpaceSize = par.coreSize / i;
+  par.sw8 = par.swV = FALSE;
+
+  memset(&memW, 0, sizeof(memW));
+  memW.fileName = "";
+  curW = &memW;
+  srcfp = NULL;
+  srcp = src;
+  srcend = src + len;
+  diag = dg;
+  bail = &jb;
+
+  if (setjmp(jb)) {                /* out of memory, too many errors */
+    cleanmem();
+    FREE(memW.instBank);
+    memW.instBank = NULL;
+    memW.instLen = 0;
+    if (!errnum)
+      errnum = 1;
+    status = BATTLE_ASMERR;
+  } else {
+    char    pstart = 0;
+
+    asmstart();
+    asmread("", &pstart);
+    asmpasses(0);
+    asmreport();
+    status = errnum ? BATTLE_ASMERR : BATTLE_OK;
+  }
+  FREE(errkeep);
+  errkeep = NULL;
+  arelease(FALSE);                /* the thread may not come back */
+  reset_regs();
+  if (dg) {
+    dg->errors = errnum;
+    dg->warnings = warnum;
+  }
+
+  if (status == BATTLE_OK && memW.instLen > 0 &&
+      (out->inst = (battle_inst *)
+       MALLOC(memW.instLen * sizeof(battle_inst))) == NULL) {
+    if (dg) {
+      dg->errors++;
+      strcpy(dg->message, notEnoughMemErr);
+    }
+    status = BATTLE_ASMERR;
+  }
+  if (status == BATTLE_OK) {
+    for (i = 0; i < memW.instLen; ++i) {
+      battle_inst *b = out->inst + i;
+      mem_struct *m = memW.instBank + i;
+
+      b->a_value = m->A_value;
+      b->b_value = m->B_value;
+      b->opcode = m->opcode;
+      b->a_mode = m->A_mode;
+      b->b_mode = m->B_mode;
+      b->debuginfo = m->debuginfo;
+    }
+    out->length = memW.instLen;
+    out->offset = memW.offset;
+    out->predefs = memW.predefs;
+    out->usesPspace = pspace_used(memW.instBank, memW.instLen);
+    out->name = memW.name;
+    out->author = memW.authorName;
+    out->date = memW.date;
+    out->version = memW.version;
+#ifdef SHARED_PSPACE
+    out->hasPin = memW.pSpaceIndex == PIN_APPEARED;
+    out->pin = memW.pSpaceIDNumber;
+#endif
+  } else {
+    FREE(memW.name);
+    FREE(memW.authorName);
+    FREE(memW.date);
+    FREE(memW.version);
+  }
+  FREE(memW.instBank);
+  memset(&memW, 0, sizeof(memW));
+
+  curW = saveW;
+  bail = NULL;
+  diag = NULL;
+  return status;
+}
+
+/* ******************************************************************* */
+
+void
+free_assembled(out)
+  assembled_warrior *out;
+{
+  FREE(out->name);
+  FREE(out->author);
+  FREE(out->date);
+  FREE(out->version);
+  FREE(out->inst);
+  memset(out, 0, sizeof(*out));
+}
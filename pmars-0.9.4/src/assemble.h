@@ -0,0 +1,75 @@
+/*
+ * assemble.h: the assembler as a library call
+ *
+ * assemble_buffer() assembles redcode held in memory, the way assemble()
+ * assembles a file, but it leaves the pmars globals alone: the settings it
+ * assembles for are given as battle_params, the code and the ;name etc.
+ * lines come back in an assembled_warrior and the messages in diagnostics
+ * instead of in warrior[], errorcode and errmsg and on standard error.
+ *
+ * It is reentrant: every thread has its own assembler state (the symbol
+ * tables, buffers and the arena in asm.c, the registers of eval.c), so many
+ * threads can assemble at the same time.  Errors that make pmars exit (out
+ * of memory, too many errors) make it return instead.
+ *
+ * The C++ side includes this too.
+ */
+
+#ifndef ASSEMBLE_INCLUDED
+#define ASSEMBLE_INCLUDED
+
+#include <stddef.h>
+#include "battle.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the predefined constants (CORESIZE ...), as bits 1 << PREDEF_x */
+enum {
+  PREDEF_CORESIZE, PREDEF_MAXPROCESSES, PREDEF_MAXCYCLES, PREDEF_MAXLENGTH,
+  PREDEF_MINDISTANCE, PREDEF_VERSION, PREDEF_WARRIORS, PREDEF_ROUNDS,
+  PREDEF_READLIMIT, PREDEF_WRITELIMIT, PREDEF_PSPACESIZE, PREDEF_COUNT
+};
+
+typedef struct assembled_warrior {
+  char   *name, *author, *date, *version;        /* ;name ;author ;date ;version */
+  int     offset;                /* start offset (ORG/END) */
+  int     length;                /* battle_inst in inst */
+  battle_inst *inst;                /* NULL if length is 0 */
+  int     hasPin;                /* a PIN was given, its value is pin */
+  long    pin;
+  unsigned int predefs;                /* the predefined constants the source
+                                 * refers to */
+  int     usesPspace;                /* it has LDP or STP: its rounds depend
+                                 * on each other (see BATTLE_SESSION) */
+}       assembled_warrior;
+
+#define DIAG_TEXTMAX 4096
+
+typedef struct diagnostics {
+  int     errors, warnings;
+  char    message[256];                /* the last error or warning */
+  char    text[DIAG_TEXTMAX];        /* what assemble() would have printed,
+                                 * cut off when full */
+}       diagnostics;
+
+/*
+ * Assembles len bytes of src (NUL bytes need not follow) for a battle with
+ * params (coreSize, cycles, processes, maxLength, minDistance, rounds and
+ * warriors are used: they set the predefined constants and the limits);
+ * NULL means the pmars defaults.  diag may be NULL.  Returns BATTLE_OK,
+ * BATTLE_ASMERR (out is empty then, diag says why) or BATTLE_BADREQ (params
+ * out of range).  What is in out is the caller's, see free_assembled().
+ */
+extern int assemble_buffer(const char *src, size_t len,
+                           const battle_params * params,
+                           assembled_warrior * out, diagnostics * diag);
+
+extern void free_assembled(assembled_warrior * out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif                                /* ASSEMBLE_INCLUDED */
@@ -0,0 +1,300 @@
+/*
+ * batch.c: pmars --batch, one process for many battles
+ *
+ * The battles come from standard input, a line each: the warrior files
+ * (sources, or .rcb compiled by pmars --compile), and for that battle only
+ * "-r rounds" and "-F position" (the seed; see -F) if the command line's
+ * won't do.  Empty lines and lines starting with # are skipped.  Everything
+ * else is as the command line says (-s, -c, -P, -f, -= ...; -t is for
+ * single battles).  For each battle one line goes to standard output: the
+ * number of the input line, then what -k says of each warrior on one line
+ * (wins and ties for two warriors; score, results and deaths for more), or
+ * "error" and why, the assembler's messages going to standard error as
+ * usual.  The output is flushed after every line, so a program can feed
+ * pmars a battle and wait for its result.
+ *
+ * A warrior is assembled (or loaded) once: what the assembler made of the
+ * file is kept, and used again while the file is unchanged and, if the
+ * source refers to WARRIORS or ROUNDS, those are the same.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <signal.h>
+#define BATCH_STAT
+#endif
+
+#include "global.h"
+#include "asm.h"
+#include "rcb.h"
+
+extern char *batchFilesErr, *batchStdinErr, *batchOptionErr,
+       *batchRoundsErr, *batchFErr, *batchWarriorsErr, *batchCoreErr,
+       *batchPErr, *batchLoadErr, *batchLineErr;
+extern int pspP;                /* pmars.c */
+#ifdef PSPACE
+#ifdef NEW_STYLE
+extern void pspace_init(void);
+#else
+extern void pspace_init();
+#endif
+#endif
+
+#define CACHESIZE 256                /* hash buckets */
+
+typedef struct cached_warrior {
+  char   *fileName;
+#ifdef BATCH_STAT
+  time_t  mtime;
+  off_t   size;
+#endif
+  int     warriors, rounds;        /* as it was assembled */
+  warrior_struct w;                /* owns instBank and the strings */
+  struct cached_warrior *next;
+}       cached_warrior;
+
+static cached_warrior *cache[CACHESIZE];
+
+/* ******************************************************************* */
+
+static unsigned int
+hashname(s)
+  char   *s;
+{
+  unsigned int h = 5381;
+
+  while (*s)
+    h = h * 33 + (unsigned char) *s++;
+  return h % CACHESIZE;
+}
+
+/* e still is what assembling the file for this battle would give */
+static int
+fresh(e)
+  cached_warrior *e;
+{
+#ifdef BATCH_STAT
+  struct stat st;
+
+  if (stat(e->fileName, &st) || st.st_mtime != e->mtime ||
+      st.st_size != e->size)
+    return FALSE;
+#endif
+  if ((e->w.predefs & (1 << PREDEF_WARRIORS)) && e->warriors != warriors)
+    return FALSE;
+  if ((e->w.predefs & (1 << PREDEF_ROUNDS)) && e->rounds != rounds)
+    return FALSE;
+  return TRUE;
+}
+
+static void
+freecode(w)
+  warrior_struct *w;
+{
+  FREE(w->instBank);
+  FREE(w->name);
+  FREE(w->authorName);
+  FREE(w->date);
+  FREE(w->version);
+  w->instBank = NULL;
+  w->name = w->authorName = w->date = w->version = NULL;
+}
+
+/*
+ * Puts the warrior in fName into warrior[n], from the cache if it can;
+ * FALSE if it won't assemble (or load).
+ */
+static int
+getwarrior(fName, n)
+  char   *fName;
+  int     n;
+{
+  warrior_struct *w = &warrior[n];
+  cached_warrior *e, **at = &cache[hashname(fName)];
+  int     i;
+
+  for (e = *at; e && strcmp(e->fileName, fName); e = e->next);
+  if (e && !fresh(e)) {
+    freecode(&e->w);
+    for (; *at != e; at = &(*at)->next);
+    *at = e->next;
+    FREE(e->fileName);
+    FREE(e);
+    e = NULL;
+  }
+
+  if (e == NULL) {
+#ifdef BATCH_STAT
+    struct stat st;
+#endif
+
+    w->instBank = NULL;                /* still the cache's */
+    w->name = w->authorName = w->date = w->version = NULL;
+    w->fileName = fName;
+#ifdef BATCH_STAT
+    if (stat(fName, &st))
+      st.st_mtime = 0, st.st_size = -1;        /* assemble() will complain */
+#endif
+    if ((i = rcb_load(fName, n)) == RCB_NOTRCB)
+      i = assemble(fName, n);
+    if (i != SUCCESS || w->instBank == NULL) {
+      freecode(w);
+      errorcode = SUCCESS;        /* the next battle */
+      return FALSE;
+    }
+    if ((e = (cached_warrior *) MALLOC(sizeof(cached_warrior))) == NULL ||
+        (e->fileName = pstrdup(fName)) == NULL)
+      Exit(MEMERR);
+#ifdef BATCH_STAT
+    e->mtime = st.st_mtime;
+    e->size = st.st_size;
+#endif
+    e->warriors = warriors;
+    e->rounds = rounds;
+    e->w = *w;
+    e->next = cache[hashname(fName)];
+    cache[hashname(fName)] = e;
+  }
+
+  *w = e->w;
+  w->fileName = e->fileName;
+  w->position = 0;                /* warrior 0's, the others get one */
+  for (i = 0; i < MAXWARRIOR * 2 - 1; ++i)
+    w->score[i] = 0;
+  return TRUE;
+}
+
+/* ******************************************************************* */
+
+/* a non-negative number, or -1 */
+static long
+number(s)
+  char   *s;
+{
+  char   *end;
+  long    n;
+
+  if (s == NULL || !*s)
+    return -1;
+  n = strtol(s, &end, 10);
+  return *end || n < 0 ? -1 : n;
+}
+
+/* fights the battle in line, NULL or why not */
+static char *
+fight(line)
+  char   *line;
+{
+  char   *file[MAXWARRIOR], *tok;
+  long    r = rounds, F = -1;
+  int     n = 0, i;
+
+  for (tok = strtok(line, " \t\r\n"); tok; tok = strtok(NULL, " \t\r\n")) {
+    if (!strcmp(tok, "-"))
+      return batchStdinErr;
+    if (!strcmp(tok, "-r")) {
+      if ((r = number(strtok(NULL, " \t\r\n"))) < 1)
+        return batchRoundsErr;
+    } else if (!strcmp(tok, "-F")) {
+      if ((F = number(strtok(NULL, " \t\r\n"))) < 0)
+        return batchFErr;
+    } else if (*tok == '-')
+      return batchOptionErr;
+    else if (n == MAXWARRIOR)
+      return batchWarriorsErr;
+    else
+      file[n++] = tok;
+  }
+  if (n == 0)
+    return batchWarriorsErr;
+  if (coreSize < n * separation)
+    return batchCoreErr;
+#ifdef PERMUTATE
+  if (SWITCH_P && n != 2)
+    return batchPErr;
+#endif
+  if (F >= 0 && F < separation)
+    return batchFErr;
+
+  warriors = n;
+  rounds = (int) r;
+  for (i = 0; i < n; ++i)
+    if (!getwarrior(file[i], i)) {
+      static char why[MAXALLCHAR];
+
+      sprintf(why, batchLoadErr, file[i]);
+      return why;
+    }
+  if (F >= 0)
+    SWITCH_Fnum = (ADDR_T) F;
+
+#ifdef PSPACE
+  /* every battle starts with empty P-spaces */
+  pspP = 0;
+  pspace_init();
+  for (i = 0; i < pspP; ++i)
+    memset(pSpace[i], 0, pSpaceSize * sizeof(ADDR_T));
+#endif
+  debugState = NOBREAK;                /* cdb would read the battles */
+  simulator1();
+  return NULL;
+}
+
+/* ******************************************************************* */
+
+void
+batch()
+{
+  char    line[MAXALLCHAR], *why, *p;
+  int     saveRounds = rounds, i, j;
+  ADDR_T  saveFnum = SWITCH_Fnum;
+  long    lineNum = 0;
+
+  if (warriors) {
+    errout(batchFilesErr);
+    errorcode = CLP_NOGOOD;
+    return;
+  }
+#if defined(BATCH_STAT) && defined(SIGINT)
+  signal(SIGINT, SIG_DFL);        /* no debugger to drop into */
+#endif
+  SWITCH_e = 0;
+
+  while (fgets(line, MAXALLCHAR, stdin)) {
+    ++lineNum;
+    if (strchr(line, '\n') == NULL && !feof(stdin)) {
+      while ((i = getchar()) != EOF && i != '\n');
+      why = batchLineErr;
+    } else {
+      for (p = line; *p == ' ' || *p == '\t'; ++p);
+      if (*p == '\n' || *p == '\r' || *p == '\0' || *p == '#')
+        continue;
+      why = fight(p);
+    }
+
+    if (why)
+      fprintf(STDOUT, "%ld error %s\n", lineNum, why);
+    else {
+      fprintf(STDOUT, "%ld", lineNum);
+      set_reg('W', (long) warriors);        /* 'W' used in score calculation */
+      if (warriors == 2)
+        fprintf(STDOUT, " %d %d %d %d", warrior[0].score[0],
+             warrior[0].score[1], warrior[1].score[0], warrior[1].score[1]);
+      else
+        for (i = 0; i < warriors; i++) {
+          fprintf(STDOUT, " %d", score(i));
+          for (j = 0; j < warriors; j++)
+            fprintf(STDOUT, " %d", warrior[i].score[j]);
+          fprintf(STDOUT, " %d", deaths(i));
+        }
+      fprintf(STDOUT, "\n");
+    }
+    fflush(STDOUT);
+    rounds = saveRounds;
+    SWITCH_Fnum = saveFnum;
+  }
+}
@@ -0,0 +1,133 @@
+/*
+ * battle.h: wire format spoken by pmars_worker (worker.c)
+ *
+ * A client sends requests and reads replies over one stream (a pipe pair or a
+ * Unix domain socket).  Every message is a battle_header followed by 'size'
+ * bytes of payload.  All fields are 32-bit ints in the byte order of the
+ * machine (client and worker run on the same host; a farm node tells its
+ * byte order in the BATTLE_HELLO reply and a client refuses one that
+ * differs).
+ *
+ * BATTLE_ASSEMBLE   request: battle_params, then the redcode source text
+ *                   reply:   battle_code, then code.length battle_inst
+ * BATTLE_RUN        request: battle_params, then for each warrior a
+ *                            battle_code followed by its battle_inst
+ *                   reply:   battle_result (with the number of
+ *                            instructions the simulator executed in all
+ *                            rounds), then warriors*warriors ints:
+ *                            score[i*warriors+k] is the number of rounds that
+ *                            warrior i was alive at the end with k+1 warriors
+ *                            left (for two warriors: k=0 win, k=1 tie)
+ * BATTLE_SESSION    request: as BATTLE_RUN, then for each warrior a
+ *                            battle_pspace followed by its size P-space
+ *                            cells (size 0: the session starts, P-space is
+ *                            empty)
+ *                   reply:   as BATTLE_RUN, then for each warrior a
+ *                            battle_pspace and the cells as the last round
+ *                            left them, to go with the next request of the
+ *                            session
+ * BATTLE_QUIT       request: no payload, no reply; the worker exits
+ *
+ * The reply carries the id of the request.  A status other than
+ * BATTLE_OK means the request was not carried out (the worker stays up).
+ *
+ * The farm nodes (corewar_node, which hand the battles to their own
+ * pmars_workers) also take these, over TCP:
+ *
+ * BATTLE_HELLO      request: no payload
+ *                   reply:   battle_hello
+ * BATTLE_STORE      request: battle_ref, battle_code, then its battle_inst;
+ *                            the node keeps the code under that hash
+ *                   reply:   int status
+ * and in a BATTLE_RUN or BATTLE_SESSION request a warrior may be given as a battle_code with
+ * length BATTLE_BYREF followed by a battle_ref.  If the node does not have
+ * that code (any more), the reply is a battle_result with BATTLE_UNKNOWN.
+ */
+
+#ifndef BATTLE_INCLUDED
+#define BATTLE_INCLUDED
+
+#define BATTLE_MAGIC    0x4c544142        /* "BATL" */
+
+#define BATTLE_ASSEMBLE 1
+#define BATTLE_RUN      2
+#define BATTLE_QUIT     3
+#define BATTLE_STORE    4
+#define BATTLE_HELLO    5
+#define BATTLE_SESSION  6
+
+#define BATTLE_OK       0
+#define BATTLE_BADREQ   1                /* malformed request or bad params */
+#define BATTLE_ASMERR   2                /* source did not assemble */
+#define BATTLE_UNKNOWN  3                /* code by reference we don't have */
+
+#define BATTLE_BYREF    (-1)                /* battle_code.length of a reference */
+#define BATTLE_BYTEORDER 0x01020304
+
+/* most warriors in one battle (MAXWARRIOR) */
+#define BATTLE_MAXWARRIORS 36
+
+/* most bytes of payload a worker accepts in one request */
+#define BATTLE_MAXPAYLOAD (1L << 24)
+
+typedef struct battle_header {
+  int     magic;                        /* BATTLE_MAGIC */
+  int     type;                        /* BATTLE_ASSEMBLE, ... */
+  int     id;                        /* echoed in the reply */
+  int     size;                        /* bytes of payload that follow */
+}       battle_header;
+
+/* the pmars command line switches that matter for a battle */
+typedef struct battle_params {
+  int     coreSize;                /* -s */
+  int     cycles;                /* -c */
+  int     processes;                /* -p */
+  int     maxLength;                /* -l */
+  int     minDistance;                /* -d */
+  int     rounds;                /* -r */
+  int     seed;                        /* position seed, 1 .. 2^30 (see -F) */
+  int     warriors;                /* warriors that follow (BATTLE_RUN) */
+}       battle_params;
+
+/* one assembled instruction; opcode is opcode*8+modifier as in mem_struct */
+typedef struct battle_inst {
+  int     a_value, b_value;
+  unsigned char opcode, a_mode, b_mode, debuginfo;
+}       battle_inst;
+
+typedef struct battle_code {
+  int     status;                /* BATTLE_OK, BATTLE_ASMERR (reply only) */
+  int     offset;                /* start offset (ORG/END) */
+  int     length;                /* battle_inst that follow */
+}       battle_code;
+
+typedef struct battle_ref {
+  unsigned int hash[2];                /* content hash of the code, low word first */
+}       battle_ref;
+
+typedef struct battle_hello {
+  int     status;
+  int     byteOrder;                /* BATTLE_BYTEORDER as the node sees it */
+  int     workers;                /* battles the node runs at the same time */
+}       battle_hello;
+
+/*
+ * A warrior's P-space between the requests of a session: what its rounds
+ * load with LDP depends on what the rounds before stored, so they have to
+ * be played in order, each request going on from where the last one left.
+ * Warriors without LDP and STP don't need sessions.
+ */
+typedef struct battle_pspace {
+  int     lastResult;                /* P-space cell 0 */
+  int     size;                        /* cells that follow: 0 or the
+                                 * P-space size of the core size */
+}       battle_pspace;
+
+typedef struct battle_result {
+  int     status;
+  int     warriors;
+  int     rounds;
+  unsigned int instructions[2];        /* executed, low word first */
+}       battle_result;
+
+#endif                                /* BATTLE_INCLUDED */
@@ -1496,103 +1496,86 @@ substitute(in, repl, with, out)
  LINES number of cdb display lines
 
  (others can be easily added)
- ---------------------------------------------------------------------------*/
-int
-subst_eval(inpStr, result)
-  char   *inpStr;
-  long   *result;
-{
-  int evalerr;
-  char    buf[2][MAXARG + 1], outs2[MAXARG + 1], *pos;
-  int     bi1 = 0, bi2 = 1, tmp, i;
-#define SWITCHBI do {bi1 = !bi1; bi2 = !bi2;} while(0)
-
-  if (TERMINAL(inpStr))
-    return RANGE_T;
-
-  /* relative address +-expr is just .+-expr */
-  if ((*inpStr == '-') || (*inpStr == '+')) {
-    buf[bi1][0] = '.';
-    buf[bi1][1] = 0;
-    strcat(buf[bi1], inpStr);
-  } else
-    strcpy(buf[bi1], inpStr);
-
-  sprintf(outs, "%d", curAddr);
-  substitute(buf[bi1], ".", outs, buf[bi2]);
-
-  SWITCHBI;
-  sprintf(outs, "%d", (targetID == QUEUE && !QW->tasks ?
-                       targetSize - 2 : targetSize - 1));
-  substitute(buf[bi1], "$", outs, buf[bi2]);
-
-  /* short cut: skip replacements if there are no letters in buffer */
-  for (pos = buf[bi2]; *pos && !isupper(*pos); ++pos);
-  if (*pos) {
 
-    SWITCHBI;
-    sprintf(outs, "%d", targetID == PSP ? QW->pSpaceIndex : memory[targetSelect(curAddr)].A_value);
-    substitute(buf[bi1], "A", outs, buf[bi2]);
+ A range is substituted with slots (EXPR_SLOT) instead of the values and
+ compiled the first time it is seen; after that only the values are put in,
+ which is what makes macro loops fast. A range where a value would run
+ into the text around it (say "1A") is substituted and evaluated each time.
+ ---------------------------------------------------------------------------*/
 
-    SWITCHBI;
-    sprintf(outs, "%d", targetID == PSP ? QW->pSpaceIndex : memory[targetSelect(curAddr)].B_value);
-    substitute(buf[bi1], "B", outs, buf[bi2]);
+/* the symbols as slots of the compiled range */
+#define SYM_DOT   0
+#define SYM_END   1                /* $ */
+#define SYM_A     2
+#define SYM_B     3
+#define SYM_PC    4
+#define SYM_CYCLE 5
+#define SYM_ROUND 6
+#define SYM_LINES 7
+#define SYM_PCN   8                /* PC1 ... */
+#define SYMBOLS   (SYM_PCN + MAXWARRIOR)
+
+#define RANGECACHE 8
+
+/* ranges compiled so far; expr is NULL in an unused one */
+static struct {
+  char   *expr;
+  int     warriors;                /* PC# depends on it */
+  int     letters;                /* the symbols past $ are used */
+  int     compiled;                /* FALSE: substitute it every time */
+  expr_code code;
+}       rangeCache[RANGECACHE];
+static int rangeNext = 0;
+
+/* the symbols of inpStr, by slot; the ones past $ only if letters */
+static void
+symbol_values(val, letters)
+  long   *val;
+  int     letters;
+{
+  int     i;
 
-    for (i = warriors - 1; i >= 0; --i) {
-      sprintf(outs, "%d", (targetID == QUEUE || targetID == PSP ?
-                           0 : (targetID == WARRIOR ?
-                 i : (W - warrior == i ? progCnt : *warrior[i].taskHead))));
-      sprintf(outs2, "PC%d", i + 1);
-      SWITCHBI;
-      substitute(buf[bi1], outs2, outs, buf[bi2]);
-    }
-    if (warriors < MAXWARRIOR) {/* PCN where N==warriors is PC */
-      sprintf(outs, "%d", (targetID == QUEUE || targetID == PSP ?
-                           0 : (targetID == WARRIOR ?
-                                W - warrior : progCnt)));
-      sprintf(outs2, "PC%d", warriors);
-      SWITCHBI;
-      substitute(buf[bi1], outs2, outs, buf[bi2]);
-    }
-    SWITCHBI;
-    sprintf(outs, "%d", (targetID == QUEUE || targetID == PSP ?
-                         0 : (targetID == WARRIOR ?
-                              W - warrior : progCnt)));
-    substitute(buf[bi1], "PC", outs, buf[bi2]);
-    SWITCHBI;
-    sprintf(outs, "%d", (cycle + (warriorsLeft ? warriorsLeft : 1) - 1) /
-            (warriorsLeft ? warriorsLeft : 1));
-    substitute(buf[bi1], "CYCLE", outs, buf[bi2]);
-    SWITCHBI;
-    sprintf(outs, "%d", round_num);
-    substitute(buf[bi1], "ROUND", outs, buf[bi2]);
-
-    SWITCHBI;
+  val[SYM_DOT] = curAddr;
+  val[SYM_END] = (targetID == QUEUE && !QW->tasks ?
+                  targetSize - 2 : targetSize - 1);
+  if (!letters)
+    return;
+  val[SYM_A] = targetID == PSP ? QW->pSpaceIndex : memory[targetSelect(curAddr)].A_value;
+  val[SYM_B] = targetID == PSP ? QW->pSpaceIndex : memory[targetSelect(curAddr)].B_value;
+  for (i = warriors - 1; i >= 0; --i)
+    val[SYM_PCN + i] = (targetID == QUEUE || targetID == PSP ?
+                        0 : (targetID == WARRIOR ?
+                 i : (W - warrior == i ? progCnt : *warrior[i].taskHead)));
+  val[SYM_PC] = (targetID == QUEUE || targetID == PSP ?
+                 0 : (targetID == WARRIOR ? W - warrior : progCnt));
+  val[SYM_CYCLE] = (int) ((cycle + (warriorsLeft ? warriorsLeft : 1) - 1) /
+                          (warriorsLeft ? warriorsLeft : 1));
+  val[SYM_ROUND] = round_num;
 #if defined(DOSALLGRAPHX)
-    if (displayMode != TEXT)
-      sprintf(outs, "%d", bgiTextLines - 1);
-    else
-      sprintf(outs, "%d", screenY - 2);
+  if (displayMode != TEXT)
+    val[SYM_LINES] = bgiTextLines - 1;
+  else
+    val[SYM_LINES] = screenY - 2;
 #else
 #if defined(DOSGRXGRAPHX)
-    sprintf(outs, "%d", bgiTextLines - 1);
+  val[SYM_LINES] = bgiTextLines - 1;
 #else
 #if defined(CURSESGRAPHX)
-    sprintf(outs, "%d", LINES);
+  val[SYM_LINES] = LINES;
 #else
 #if defined(DOSTXTGRAPHX)
-    sprintf(outs, "%d", screenY - 2);
+  val[SYM_LINES] = screenY - 2;
 #else
 #if defined(MACGRAPHX)
-    sprintf(outs, "%d", mac_text_lines());
+  val[SYM_LINES] = mac_text_lines();
 #else
 #if defined(LINUXGRAPHX)
-    sprintf(outs, "%d", svgaTextLines);
+  val[SYM_LINES] = svgaTextLines;
 #else
 #if defined(XWINGRAPHX)
-    sprintf(outs, "%d", xWinTextLines);
+  val[SYM_LINES] = xWinTextLines;
 #else
-    sprintf(outs, "%d", TEXTLINES);
+  val[SYM_LINES] = TEXTLINES;
 #endif
 #endif
 #endif
@@ -1600,10 +1583,107 @@ subst_eval(inpStr, result)
 #endif
 #endif
 #endif
-    substitute(buf[bi1], "LINES", outs, buf[bi2]);
+}
+
+/* inpStr with the symbols replaced by their values, or by slots if val is
+   NULL, into out; returns whether the symbols past $ were looked for */
+static int
+subst_all(inpStr, val, out)
+  char   *inpStr, *out;
+  long   *val;
+{
+  char    buf[2][MAXARG + 1], outs2[MAXARG + 1], *pos;
+  int     bi1 = 0, bi2 = 1, i;
+#define SWITCHBI do {bi1 = !bi1; bi2 = !bi2;} while(0)
+#define SUBST(name, slot) do {\
+    if (val)\
+      sprintf(outs, "%ld", val[slot]);\
+    else {\
+      outs[0] = EXPR_SLOT;\
+      outs[1] = (char) ((slot) + 1);\
+      outs[2] = 0;\
+    }\
+    SWITCHBI;\
+    substitute(buf[bi1], name, outs, buf[bi2]);\
+  } while (0)
+
+  /* relative address +-expr is just .+-expr */
+  if ((*inpStr == '-') || (*inpStr == '+')) {
+    buf[bi2][0] = '.';
+    buf[bi2][1] = 0;
+    strcat(buf[bi2], inpStr);
+  } else
+    strcpy(buf[bi2], inpStr);
+
+  SUBST(".", SYM_DOT);
+  SUBST("$", SYM_END);
 
+  /* short cut: skip replacements if there are no letters in buffer */
+  for (pos = buf[bi2]; *pos && !isupper(*pos); ++pos);
+  if (*pos) {
+    SUBST("A", SYM_A);
+    SUBST("B", SYM_B);
+    for (i = warriors - 1; i >= 0; --i) {
+      sprintf(outs2, "PC%d", i + 1);
+      SUBST(outs2, SYM_PCN + i);
+    }
+    if (warriors < MAXWARRIOR) {/* PCN where N==warriors is PC */
+      sprintf(outs2, "PC%d", warriors);
+      SUBST(outs2, SYM_PC);
+    }
+    SUBST("PC", SYM_PC);
+    SUBST("CYCLE", SYM_CYCLE);
+    SUBST("ROUND", SYM_ROUND);
+    SUBST("LINES", SYM_LINES);
   }                                /* if (*pos) */
-  if ((evalerr = eval_expr(buf[bi2], result)) >= OK_EXPR) {
+  strcpy(out, buf[bi2]);
+  return *pos != 0;
+#undef SUBST
+}
+
+int
+subst_eval(inpStr, result)
+  char   *inpStr;
+  long   *result;
+{
+  int     evalerr, i;
+  long    val[SYMBOLS];
+  char    buf[MAXARG + 1];
+
+  if (TERMINAL(inpStr))
+    return RANGE_T;
+
+  for (i = 0; i < RANGECACHE; ++i)
+    if (rangeCache[i].expr && rangeCache[i].warriors == warriors &&
+        !strcmp(rangeCache[i].expr, inpStr))
+      break;
+  if (i == RANGECACHE) {        /* new one, replaces the oldest */
+    i = rangeNext;
+    rangeNext = (rangeNext + 1) % RANGECACHE;
+    if (rangeCache[i].expr) {
+      FREE(rangeCache[i].expr);
+      if (rangeCache[i].compiled)
+        free_expr(&rangeCache[i].code);
+    }
+    if ((rangeCache[i].expr = (char *) MALLOC(strlen(inpStr) + 1)) != NULL) {
+      strcpy(rangeCache[i].expr, inpStr);
+      rangeCache[i].warriors = warriors;
+      rangeCache[i].letters = subst_all(inpStr, NULL, buf);
+      rangeCache[i].compiled =
+        compile_expr(buf, &rangeCache[i].code, TRUE) == OK_EXPR;
+    }
+  }
+
+  if (rangeCache[i].expr && rangeCache[i].compiled) {
+    symbol_values(val, rangeCache[i].letters);
+    evalerr = run_expr(&rangeCache[i].code, val, result);
+  } else {
+    symbol_values(val, rangeCache[i].expr ? rangeCache[i].letters :
+                  subst_all(inpStr, NULL, buf));
+    subst_all(inpStr, val, buf);
+    evalerr = eval_expr(buf, result);
+  }
+  if (evalerr >= OK_EXPR) {
     if (evalerr == OVERFLOW) {
       cdb_fputs(overflowErr, COND);
       cdb_fputs("\n", COND);
@@ -2411,6 +2491,11 @@ pspaceview(loc, outp)
 }
 #endif
 
+/* the score formula, compiled the first time it is used (and again if
+   SWITCH_eq changes) */
+static expr_code scoreCode;
+static char *scoreSrc = NULL;
+
 int
 score(warnum)
   int     warnum;
@@ -2418,9 +2503,23 @@ score(warnum)
   int     surv, accu = 0;
   long    res;
 
+  if (!scoreSrc || strcmp(scoreSrc, SWITCH_eq)) {
+    if (scoreSrc) {
+      free_expr(&scoreCode);
+      FREE(scoreSrc);
+    }
+    if ((scoreSrc = (char *) MALLOC(strlen(SWITCH_eq) + 1)) == NULL)
+      return INT_MIN;
+    strcpy(scoreSrc, SWITCH_eq);
+    if (compile_expr(scoreSrc, &scoreCode, FALSE) < OK_EXPR) {
+      FREE(scoreSrc);
+      scoreSrc = NULL;
+      return INT_MIN;
+    }
+  }
   for (surv = 1; surv <= warriors; ++surv) {
     set_reg('S', (long) surv);
-    if (eval_expr(SWITCH_eq, &res) < OK_EXPR)
+    if (run_expr(&scoreCode, NULL, &res) < OK_EXPR)
       return INT_MIN;                /* hopefully clparse will catch errors
                                  * earlier */
     else
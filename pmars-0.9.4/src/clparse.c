@@ -73,6 +73,12 @@ extern char *credits_screen1, *credits_screen2, *credits_screen3, *usage_screen,
        *fFExclusive, *coreSizeTooSmall, *dLessThanl, *FLessThand,
        *outOfMemory, *badScoreFormula, *optPSpaceSize, *pSpaceTooBig,
        *optPermutate, *permutateMultiWarrior, *optAssemble;
+#ifdef TRACE
+extern char *optTrace;
+#endif
+#ifdef MELEE
+extern char *optThreads;
+#endif
 
 #ifdef RWLIMIT
 extern char *optReadLimit, *optWriteLimit, *badRWLimit;
@@ -465,7 +471,7 @@ parse_param(largc, largv)
   * command line parameters and options                              *
   ********************************************************************/
 
-#define OPTNUM 22                /* don't forget to increase when adding new
+#define OPTNUM 25                /* don't forget to increase when adding new
                                  * options */
   static clp_opt_t options[OPTNUM];
   int     optI = 0;                /* used by record() macro */
@@ -524,6 +530,12 @@ parse_param(largc, largv)
   record('A', clp_bool, &SWITCH_A, 0, 1,
 	 0, optAssemble);
   record('=', clp_str, &SWITCH_eq, 0, 0, 0, optScoreFormula);
+#ifdef TRACE
+  record('t', clp_str, &SWITCH_t, 0, 0, 0, optTrace);
+#endif
+#ifdef MELEE
+  record('j', clp_int, &SWITCH_j, 1, MAXTHREADS, 1, optThreads);
+#endif
   record('Q', clp_int, &SWITCH_Q, -1, INT_MAX, -1, NULL);
 #if defined(DOSTXTGRAPHX) || defined(DOSGRXGRAPHX)  || defined(LINUXGRAPHX) \
     || defined(XWINGRAPHX)
@@ -629,7 +641,7 @@ parse_param(largc, largv)
 #endif
 #ifdef PERMUTATE
       if (SWITCH_P) {
-	if (warriors != 2) {
+	if (warriors != 2 && !batchMode) {        /* --batch: checked per battle */
 	  print_usage(options);
 	  errout(permutateMultiWarrior);
 	  result = CLP_NOGOOD;
@@ -652,7 +664,7 @@ parse_param(largc, largv)
       /* further checks of the values */
 
 #ifndef OS2PMGRAPHX                /* jk - we can load files after the fact... */
-      if (warrior[0].fileName == NULL) {
+      if (warrior[0].fileName == NULL && !batchMode) {
         print_usage(options);
         errout(noWarriorFile);
         result = CLP_NOGOOD;
@@ -95,6 +95,51 @@
 #endif
 */
 
+/* ********************************************************************
+   TRACE: adds the -t switch, which records the battle into a file that
+   corewar_trace replays (see trace.h), and lets pmars_worker record sampled
+   battles.  Tracing runs a second copy of the simulator (simtrace.c), so
+   the untraced simulation is as fast as without TRACE.  Needs threads on
+   UNIX.  TRACE and GRAPHX are mutually exclusive.
+   ******************************************************************** */
+
+/*
+#ifndef TRACE
+#define TRACE
+#endif
+*/
+
+/* ********************************************************************
+   MELEE: adds the -j switch, which runs the rounds of a battle of more than
+   two warriors on several threads (melee.c).  The threads run a copy of the
+   simulator with state of their own (simmelee.c), so simulator1() is not
+   slowed down; the positions and the starter of each round are worked out
+   beforehand as one thread would, so the results do not depend on the
+   number of threads.  Needs pthreads (UNIX and gcc).  MELEE and GRAPHX are
+   mutually exclusive.
+   ******************************************************************** */
+
+/*
+#ifndef MELEE
+#define MELEE
+#endif
+*/
+
+/* ********************************************************************
+   STEADY: ends a round early once it can only end with the warriors left
+   all alive, that is when every process is on an imp (MOV.I $0, $1) or a
+   JMP $0 loop (see steady() in sim.c).  The scores, P-space results and
+   instruction counts are those of running the round to its last cycle.
+   Not with cdb (a round under the debugger runs every cycle) or traces.
+   STEADY and GRAPHX are mutually exclusive.
+   ******************************************************************** */
+
+/*
+#ifndef STEADY
+#define STEADY
+#endif
+*/
+
 /* ********************************************************************
    KEYPRESS: is only useful in conjunction with curses display libraries
    with broken support for interrupt handlers. Define KEYPRESS if you
@@ -346,6 +391,19 @@
 #ifdef SERVER
 #undef SERVER
 #endif
+#ifdef TRACE
+#undef TRACE
+#endif
+#ifdef MELEE
+#undef MELEE
+#endif
+#ifdef STEADY
+#undef STEADY
+#endif
+#endif
+
+#if defined(MELEE) && !(defined(unix) && defined(__GNUC__))
+#undef MELEE                        /* melee.c uses pthreads */
 #endif
 
 #if defined(XWINGRAPHX)
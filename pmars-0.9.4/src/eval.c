@@ -23,6 +23,7 @@
  */
 
 #include <ctype.h>
+#include <string.h>
 
 #include "global.h"
 
@@ -42,23 +43,27 @@
  * -26 registers named "a" thru "z", assignment operator =
  * -C-like comparison and logic operators: ==,!=,<,>,<=,>=,&&,||
  *
+ * An expression that is evaluated over and over (the score formula, cdb
+ * ranges) can be compiled once with compile_expr() and run with run_expr():
+ * the parser below does not compute values, it emits code for a small
+ * stack machine in the order it would have computed them, so running the
+ * code gives what parsing used to (eval_expr() just compiles and runs).
+ * Registers are read and set when the code runs.
+ *
  */
 
 #define STANDALONE 0
-#define BIGNUM 20                /* largest number taken */
+#define BIGNUM 20                /* longest number taken (digits) */
 
 /* two-char operators */
 enum {
   EQUAL, NEQU, GTE, LTE, AND, OR, IDENT
 };
 
-#ifdef DEBUG
-#define X(c) (c==IDENT ? '#' :\
-              (c==EQUAL ? '=' :\
-               (c==AND ? '&' :\
-                (c==OR ? '|' :\
-                 (c)))))
-#endif
+/* stack code: E_CALC applies calc() to the two values on top */
+enum {
+  E_PUSH, E_REG, E_SET, E_SLOT, E_NEG, E_NOT, E_CALC, E_BAD
+};
 
 #define TERMINAL(c) (((c)==')' || !(c)) ? 1 : 0)
 /* order of precedence (high to low):
@@ -78,29 +83,37 @@ enum {
 
 /* function prototypes */
 #ifdef NEW_STYLE
-char   *eval(int prevPrec, long val, char operator, char *expr, long *result);
-char   *getreg(char *expr, int regId, long *val);
-char   *getval(char *expr, long *val);
+char   *eval(int prevPrec, char operator, char *expr);
+char   *getreg(char *expr, int regId);
+char   *getval(char *expr);
 char   *getop(char *expr, char *op);
 long    calc(long x, long y, int op);
+static void emit(int op, long val);
 #else
 char   *eval();
 char   *getreg();
 char   *getval();
 char   *getop();
 long    calc();
+static void emit();
 #endif
 
-/* global error flag */
-int     evalerr;
+/* global error flag (each thread has its own, as the assembler may run in
+   several; see assemble_buffer()) */
+THREAD_LOCAL int evalerr;
 
 /* registers */
 
-static long regAr[26];
+static THREAD_LOCAL long regAr[26];
 
 /* kludge to implement several precedence levels - saveOper works like "push back" in token parsers */
 
-char    saveOper = 0;
+THREAD_LOCAL char saveOper = 0;
+
+/* compile_expr() state: the code being emitted, the stack height at this
+   point of it, whether EXPR_SLOT marks slots and whether it failed */
+static THREAD_LOCAL expr_code *out;
+static THREAD_LOCAL int height, slotted, failed;
 
 /*--------------------*/
 long
@@ -185,6 +198,37 @@ calc(x, y, op)
   return z;
 }
 
+/*--------------------*/
+static void
+emit(op, val)
+  int     op;
+  long    val;
+{
+  expr_inst *code;
+
+  if (out->len == out->size) {
+    if (failed)
+      return;
+    if ((code = (expr_inst *) MALLOC(2 * out->size * sizeof(expr_inst)))
+        == NULL) {
+      failed = TRUE;
+      return;
+    }
+    memcpy(code, out->code, out->len * sizeof(expr_inst));
+    if (out->code != out->fixed)
+      FREE(out->code);
+    out->code = code;
+    out->size *= 2;
+  }
+  out->code[out->len].op = op;
+  out->code[out->len++].val = val;
+  if (op == E_PUSH || op == E_REG || op == E_SLOT) {
+    if (++height > out->depth)
+      out->depth = height;
+  } else if (op == E_CALC)
+    --height;
+}
+
 /*--------------------*/
 char   *
 getop(expr, oper)
@@ -192,20 +236,28 @@ getop(expr, oper)
   char   *oper;
 {
   char    ch;
+
+  if (slotted && (*expr == EXPR_SLOT || (strchr("&|=!", *expr) && *expr &&
+                                          expr[1] == EXPR_SLOT)))
+    failed = TRUE;                /* a slot where an operator goes */
   switch (ch = *(expr++)) {
   case '&':
+    *oper = ch;                        /* not an operator, unless ... */
     if (*(expr++) == '&')
       *oper = AND;
     break;
   case '|':
+    *oper = ch;
     if (*(expr++) == '|')
       *oper = OR;
     break;
   case '=':
+    *oper = ch;
     if (*(expr++) == '=')
       *oper = EQUAL;
     break;
   case '!':
+    *oper = ch;
     if (*(expr++) == '=')
       *oper = NEQU;
     break;
@@ -231,148 +283,106 @@ getop(expr, oper)
 }
 /*--------------------*/
 char   *
-getreg(expr, regId, val)
+getreg(expr, regId)
   char   *expr;
   int     regId;
-  long   *val;
 {
   SKIP_SPACE(expr);
   if (*expr == '=' && *(expr + 1) != '=') {        /* assignment, not equality */
-    expr = eval(-1, 0L, IDENT, expr + 1, val);
-    regAr[regId] = *val;
+    emit(E_PUSH, 0L);
+    expr = eval(-1, IDENT, expr + 1);
+    emit(E_SET, (long) regId);
   } else
-    *val = regAr[regId];
+    emit(E_REG, (long) regId);
   return expr;
 }
 
 /*--------------------*/
 char   *
-getval(expr, val)
+getval(expr)
   char   *expr;
-  long   *val;
 {
-  char    buffer[BIGNUM];
-  int     regId;
-  int     bufptr = 0;
-  long    accum;
+  int     regId, digits;
+  long    val = 0;
 
   SKIP_SPACE(expr);
   if (*expr == '(') {                /* parenthetical expression */
-    expr = eval(-1, 0L, IDENT, expr + 1, val);
-    if (*expr != ')')
-      evalerr = BAD_EXPR;
+    emit(E_PUSH, 0L);
+    expr = eval(-1, IDENT, expr + 1);
+    if (*expr != ')') {
+      emit(E_BAD, 0L);
+      return expr;
+    }
     return expr + 1;
   }
   if (*expr == '-') {                /* unary minus */
-    expr = getval(expr + 1, &accum);
-    *val = accum * -1;
+    expr = getval(expr + 1);
+    emit(E_NEG, 0L);
     return expr;
   } else if (*expr == '!') {        /* logical NOT */
-    expr = getval(expr + 1, &accum);
-    *val = (accum ? 0 : 1);
+    expr = getval(expr + 1);
+    emit(E_NOT, 0L);
     return expr;
   } else if (*expr == '+')        /* unary plus */
-    return getval(expr + 1, val);
-  else if (((regId = (int) toupper(*expr)) >= 'A') && (regId <= 'Z'))
-    return getreg(expr + 1, regId - 'A', val);
-  else
-    while (isdigit(*expr) && bufptr < BIGNUM) /* FIXED (?): possible buffer overflow without the bufptr < BIGNUM? */
-      buffer[bufptr++] = *expr++;
-  if (bufptr == 0)
-    evalerr = BAD_EXPR;                /* no digits */
-  buffer[bufptr] = 0;
-  sscanf(buffer, "%ld", val); /* FIXME wouldn't it be simpler and more efficient to calculate val directly, ie val = val*10+digitvalueof(*expr++) in the loop? */
+    return getval(expr + 1);
+  else if (slotted && *expr == EXPR_SLOT) {
+    emit(E_SLOT, (long) (unsigned char) expr[1] - 1);
+    expr += 2;
+    if (isdigit(*expr) || *expr == EXPR_SLOT)
+      failed = TRUE;                /* its digits would run into these */
+    return expr;
+  } else if (((regId = (int) toupper(*expr)) >= 'A') && (regId <= 'Z'))
+    return getreg(expr + 1, regId - 'A');
+  for (digits = 0; isdigit(*expr); ++digits, ++expr)
+    if (val > (LONG_MAX - (*expr - '0')) / 10)
+      val = LONG_MAX;                /* as sscanf() had it */
+    else
+      val = val * 10 + (*expr - '0');
+  if (digits == 0 || digits > BIGNUM)
+    emit(E_BAD, 0L);                /* no digits, or too many */
+  emit(E_PUSH, val);
   return expr;
 }
 
 /*--------------------*/
 #ifdef NEW_STYLE
 char   *
-eval(int prevPrec, long val1, char oper1, char *expr, long *result)
+eval(int prevPrec, char oper1, char *expr)
 #else
 char   *
-eval(prevPrec, val1, oper1, expr, result)
+eval(prevPrec, oper1, expr)
   int     prevPrec;/* prevPrec is the precedence that ends the subevaluation, ie in 1 && 2+3*4-1 || 0 prevPrec would be prec of && while evaluating 2+3*4-1 */
   char    oper1, *expr;
-  long    val1, *result;
 #endif
 {
-  long    result2, val2;
+  /* the left operand of oper1 is on top of the stack when this code runs */
   char    oper2;
   int     prec1, prec2;
 
-#ifdef DEBUG
-      fprintf(stderr, "eval prev = %ld, val1 = %ld, op1 = %c \n", prevPrec, val1, X(oper1));
-#endif
-
   saveOper = 0;
 
-  expr = getval(expr, &val2);
+  expr = getval(expr);
   SKIP_SPACE(expr);
   if (TERMINAL(*expr)) {        /* trivial: expr is number or () */
-    *result = calc(val1, val2, oper1);
+    emit(E_CALC, (long) oper1);
     return expr;
   }
   expr = getop(expr, &oper2);
 
   if ((prec1 = PRECEDENCE(oper1)) >= (prec2 = PRECEDENCE(oper2))) {
-    if (prec2 > prevPrec /* don't understand this, so I removed it: || prec1 <= prevPrec */) {
+    emit(E_CALC, (long) oper1);
+    if (prec2 > prevPrec /* don't understand this, so I removed it: || prec1 <= prevPrec */)
       /* continue to gobble up expressions */
-
-#ifdef DEBUG
-      fprintf(stderr, "gobble prev = %ld, val1 = %ld, op1 = %c, val2 = %ld, op2 = %c \n", prevPrec, val1, X(oper1), val2, X(oper2));
-#endif
-
-      expr = eval(prevPrec, calc(val1, val2, oper1), oper2, expr, result);/* prec1 -> prevPrec */
-
-#ifdef DEBUG
-      fprintf(stderr, "gobbled (prev %ld) %ld = ((%ld %c %ld) %c ..)\n", prevPrec, *result, val1, X(oper1), val2, X(oper2));
-#endif
-
-    } else {
+      expr = eval(prevPrec, oper2, expr);/* prec1 -> prevPrec */
+    else
       /* return from subevaluation of terms with higher precedence */
-      *result = calc(val1, val2, oper1);
       saveOper = oper2;/* akin to "push back" in parsers */
-
-#ifdef DEBUG
-      fprintf(stderr, "return (prev %ld, save = %c) %ld = (%ld %c %ld)\n", prevPrec, X(saveOper), *result, val1, X(oper1), val2);
-#endif
-
-    }
   } else {
-
-#ifdef DEBUG
-      fprintf(stderr, "subevaluate op2, prev = %ld, val1 = %ld, op1 = %c, val2 = %ld, op2 = %c, saveOp = %c (%ld) \n", prevPrec, val1, X(oper1), val2, X(oper2), X(saveOper), saveOper);
-#endif
-
-    expr = eval(prec1, val2, oper2, expr, &result2);/* start subevaluation starting from val2 op2 */
-    *result = calc(val1, result2, oper1);
-
-#ifdef DEBUG
-      fprintf(stderr, "returned from subeval, result2 = %ld, result = %ld, prev = %ld, val1 = %ld, op1 = %c, val2 = %ld, op2 = %c, saveOp = %c (%ld) \n", result2, *result, prevPrec, val1, X(oper1), val2, X(oper2), X(saveOper), saveOper);
-#endif
-
-      if (saveOper && PRECEDENCE(saveOper) >= prevPrec) {/* otherwise (if saveOper, but precedence < prevPrec) yet more nested subevalutions to return from */
-
-#ifdef DEBUG
-      fprintf(stderr, "evaluate saveOper, prev = %ld, val1 = %ld, op1 = %c \n", prevPrec, *result , X(saveOper));
-#endif
-
-      expr = eval(prevPrec, *result, saveOper, expr, result);/* prec2 -> prevPrec */
-
-#ifdef DEBUG
-      fprintf(stderr, "return, no more subevals (prev %ld, old Saved: %c (%ld)) %ld = .. ? (%ld %c (%ld %c ..))\n", prevPrec, X(saveOper), saveOper, *result,
-              val1, X(oper1), val2, X(oper2));
-#endif
-
-      /* saveOper = 0; */ /* FIXED don't erase history, continue if saveOper exists */
-    }
-
-#ifdef DEBUG
-    else
-      fprintf(stderr, "return, no saveOp or more subevals (prev %ld, saveOp = %c (%ld)) %ld = (%ld %c (%ld %c ..))\n", prevPrec, X(saveOper), saveOper, *result, val1, X(oper1), val2, X(oper2));
-#endif
-
+    expr = eval(prec1, oper2, expr);/* start subevaluation starting from val2 op2 */
+    emit(E_CALC, (long) oper1);
+    if (saveOper && PRECEDENCE(saveOper) >= prevPrec)/* otherwise (if saveOper, but precedence < prevPrec) yet more nested subevalutions to return from */
+      expr = eval(prevPrec, saveOper, expr);/* prec2 -> prevPrec */
+    /* saveOper = 0; */ /* FIXED don't erase history, continue if saveOper exists */
   }
 
   return expr;
@@ -400,16 +410,103 @@ set_reg(regChr, val)
 
 /*--------------------*/
 int
-eval_expr(expr, result)                /* wrapper for eval() */
+compile_expr(expr, code, slots)        /* into code; BAD_EXPR if it can't */
   char   *expr;
-  long   *result;
+  expr_code *code;
+  int     slots;                /* EXPR_SLOT marks a slot */
 {
-#ifdef DEBUG
-      fprintf(stderr, "* eval *\n");
-#endif
+  code->code = code->fixed;
+  code->len = code->depth = 0;
+  code->size = EXPR_FIXED;
+  out = code;
+  height = 0;
+  slotted = slots;
+  failed = FALSE;
+  emit(E_PUSH, 0L);
+  if (*eval(-1, IDENT, expr) != 0)
+    emit(E_BAD, 0L);                /* still chars left */
+  if (failed) {
+    free_expr(code);
+    return BAD_EXPR;
+  }
+  return OK_EXPR;
+}
+
+/*--------------------*/
+void
+free_expr(code)
+  expr_code *code;
+{
+  if (code->code != code->fixed)
+    FREE(code->code);
+  code->code = code->fixed;
+  code->len = 0;
+}
+
+/*--------------------*/
+int
+run_expr(code, slot, result)        /* slot: the values of the slots */
+  expr_code *code;
+  long   *slot, *result;
+{
+  long    fixed[EXPR_FIXED], *stack = fixed, *sp;
+  expr_inst *inst, *end = code->code + code->len;
+  int     bad = FALSE;
+
+  if (!code->len || (code->depth > EXPR_FIXED &&
+        (stack = (long *) MALLOC(code->depth * sizeof(long))) == NULL))
+    return (evalerr = BAD_EXPR);
   evalerr = OK_EXPR;
-  if (*eval(-1, 0L, IDENT, expr, result) != 0)
-    evalerr = BAD_EXPR;                /* still chars left */
+  *stack = 0;
+  sp = stack - 1;
+  for (inst = code->code; inst < end; ++inst)
+    switch (inst->op) {
+    case E_PUSH:
+      *++sp = inst->val;
+      break;
+    case E_REG:
+      *++sp = regAr[inst->val];
+      break;
+    case E_SET:
+      regAr[inst->val] = *sp;
+      break;
+    case E_SLOT:
+      *++sp = slot[inst->val];
+      break;
+    case E_NEG:
+      *sp = *sp * -1;
+      break;
+    case E_NOT:
+      *sp = (*sp ? 0 : 1);
+      break;
+    case E_CALC:
+      --sp;
+      *sp = calc(sp[0], sp[1], (int) inst->val);
+      break;
+    default:
+      bad = TRUE;
+      break;
+    }
+  if (bad)
+    evalerr = BAD_EXPR;                /* not e.g. DIV_ZERO on a missing operand */
+  *result = *stack;                /* all that is left */
+  if (stack != fixed)
+    FREE(stack);
+  return (evalerr);
+}
+
+/*--------------------*/
+int
+eval_expr(expr, result)                /* compile and run once */
+  char   *expr;
+  long   *result;
+{
+  expr_code code;
+
+  if (compile_expr(expr, &code, FALSE) < OK_EXPR)
+    return (evalerr = BAD_EXPR);
+  run_expr(&code, NULL, result);
+  free_expr(&code);
   return (evalerr);
 }
 
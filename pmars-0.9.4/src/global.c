@@ -65,6 +65,10 @@ int     SWITCH_D;
 int     SWITCH_P;
 #endif
 int	SWITCH_A;
+int     compileMode;                /* pmars --compile */
+int     batchMode;                /* pmars --batch */
+char   *SWITCH_t;                /* trace file */
+int     SWITCH_j = 1;                /* threads for melee rounds */
 
 #if defined(DOSTXTGRAPHX) || defined(DOSGRXGRAPHX) || defined(LINUXGRAPHX) \
     || defined(XWINGRAPHX)
@@ -99,7 +103,7 @@ int     inputRedirection = FALSE;
 #endif
 mem_struct INITIALINST;                /* initialize to DAT.F $0,$0 */
 
-warrior_struct warrior[MAXWARRIOR];
+SIM_LOCAL warrior_struct warrior[MAXWARRIOR];
 #ifdef DOS16
 ADDR_T far *pSpace[MAXWARRIOR];
 #else
@@ -98,6 +98,22 @@ typedef char *pointer_t;
 
 #endif                                /* NULL */
 
+/* storage of which each thread has its own copy (the assembler state, so
+   that assemble_buffer() can run in several threads at once) */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define THREAD_LOCAL _Thread_local
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL
+#endif
+
+/* the simulator's state; simmelee.c makes it THREAD_LOCAL for its copy of
+   the simulator */
+#ifndef SIM_LOCAL
+#define SIM_LOCAL
+#endif
+
 /* unsigned types (renamed to avoid conflict with possibly predefined types) */
 typedef unsigned char uChar;
 typedef unsigned short uShrt;
@@ -168,6 +184,23 @@ extern  PMARS_FATAL, PMARS_BADCOMLIN, PMARS_PARSEERR;
 #define BAD_EXPR -1
 #define DIV_ZERO -2
 
+/* an expression compiled by compile_expr() to stack code for run_expr();
+   code points into fixed until it outgrows it, so don't copy one */
+#define EXPR_FIXED 32
+#define EXPR_SLOT  '\001'              /* EXPR_SLOT, n+1 stands for slot[n] */
+
+typedef struct expr_inst {
+  int     op;
+  long    val;
+}       expr_inst;
+
+typedef struct expr_code {
+  expr_inst *code;
+  int     len, size;                /* instructions, room in code */
+  int     depth;                        /* stack needed */
+  expr_inst fixed[EXPR_FIXED];
+}       expr_code;
+
 /* used by cdb.c */
 #define NOBREAK 0
 #define BREAK   1
@@ -210,6 +243,7 @@ extern  PMARS_FATAL, PMARS_BADCOMLIN, PMARS_PARSEERR;
 #define MAXWARRIOR        36
 #endif
 #define MAXINSTR         1000
+#define MAXTHREADS        256        /* -j */
 
 #define MAXSEPARATION MAXCORESIZE/MAXWARRIOR
 
@@ -291,6 +325,8 @@ typedef struct warrior_struct {
   char   *fileName;                /* file name */
   char   *authorName;                /* author name */
   mem_struct *instBank;
+  unsigned int predefs;                /* predefined constants the source refers
+                                 * to (1 << PREDEF_x, see assemble.h) */
 
   struct warrior_struct *nextWarrior;
 
@@ -341,6 +377,11 @@ extern int SWITCH_D;
 extern int SWITCH_P;
 #endif
 extern int SWITCH_A;
+extern int compileMode;
+extern int batchMode;
+extern char *SWITCH_t;
+extern int SWITCH_j;
+extern int traceOn;
 
 extern int inCdb;
 extern int debugState;
@@ -355,7 +396,7 @@ extern char **xWinArgv;
 #endif
 extern mem_struct INITIALINST;        /* initialize to DAT.F $0,$0 */
 
-extern warrior_struct warrior[MAXWARRIOR];
+extern SIM_LOCAL warrior_struct warrior[MAXWARRIOR];
 #ifdef DOS16
 extern ADDR_T far *pSpace[MAXWARRIOR];
 #else
@@ -416,9 +457,29 @@ extern unsigned long loopDelayAr[SPEEDLEVELS];
 extern int
         parse_param(int argc, char *argv[]);
 extern int eval_expr(char *expr, long *result);
+extern int compile_expr(char *expr, expr_code * code, int slots);
+extern int run_expr(expr_code * code, long *slot, long *result);
+extern void free_expr(expr_code * code);
 extern int assemble(char *fName, int aWarrior);
+extern int rcb_load(char *fName, int aWarrior);
+extern int rcb_write(char *fName, int aWarrior);
+extern void batch(void);
+extern int trace_open(char *fName, int nRounds);
+extern int trace_close(void);
+extern void trace_round(void);
+extern void trace_addr(int kind, int addr);
+extern void trace_event(int kind);
+extern void trace_end(void);
 extern void disasm(mem_struct * cells, ADDR_T n, ADDR_T offset);
 extern void simulator1(void);
+extern void trace_simulator1(void);
+extern int pspace_used(mem_struct * code, int length);
+extern int melee_simulator1(void);
+extern int melee_round(void);
+extern ADDR_T *melee_places(int round);
+extern void melee_rounds(warrior_struct * from,
+                         short score[][MAXWARRIOR * 2 - 1],
+                         unsigned long *instructions);
 extern char *locview(ADDR_T loc, char *outp);
 extern int cdb(char *msg);
 extern int score(int warnum);
@@ -473,9 +534,19 @@ extern int
         parse_param();
 extern int
         eval_expr();
+extern int compile_expr(), run_expr();
+extern void free_expr();
 extern int assemble();
+extern int rcb_load(), rcb_write();
+extern void batch();
+extern int trace_open(), trace_close();
+extern void trace_round(), trace_addr(), trace_event(), trace_end();
 extern void disasm();
-extern void simulator1();
+extern void simulator1(), trace_simulator1();
+extern int pspace_used();
+extern int melee_simulator1(), melee_round();
+extern ADDR_T *melee_places();
+extern void melee_rounds();
 extern char *locview();
 extern char *cellview();
 extern int cdb();
@@ -0,0 +1,157 @@
+/*
+ * melee.c: the rounds of a melee on several threads (-j)
+ *
+ * With -DMELEE, simulator1() hands a battle of more than two warriors to
+ * melee_simulator1(), which runs its rounds on SWITCH_j threads (itself
+ * one of them).  The threads run thread_simulator1() (simmelee.c), each
+ * with its own core, task queue and copy of the warriors, on the rounds
+ * melee_round() gives them, one at a time, until there are none left.
+ * What the rounds depend on is worked out before: the positions of every
+ * round, drawn from the seed exactly as simulator1() would, and the
+ * starter, which goes round the warriors.  The scores of the threads are
+ * added up at the end, so the results are those of pmars without -j.
+ *
+ * Rounds of warriors that use P-space are not independent (a round sees
+ * what the one before stored), so such a battle runs on one thread, as do
+ * battles that may enter cdb.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "global.h"
+#include "sim.h"
+
+#ifdef MELEE
+
+#include <pthread.h>
+#include <signal.h>
+
+#ifdef NEW_STYLE
+extern int posit(void);
+extern void npos(void);
+extern S32_T rng(S32_T seed);
+extern S32_T checksum_warriors(void);
+#else
+extern int posit();
+extern void npos();
+extern S32_T rng();
+extern S32_T checksum_warriors();
+#endif
+
+static int nextRound;                /* the first round no thread has taken */
+static ADDR_T *place;                /* the positions of round r start at
+                                 * place[(r - 1) * warriors] */
+
+typedef struct melee_thread {
+  pthread_t id;
+  short   score[MAXWARRIOR][MAXWARRIOR * 2 - 1];        /* as warrior[] */
+  unsigned long instructions;
+}       melee_thread;
+
+/* ******************************************************************* */
+
+/* the next round for a thread, one past the last if there are none left */
+int
+melee_round()
+{
+  return __atomic_fetch_add(&nextRound, 1, __ATOMIC_RELAXED);
+}
+
+/* the positions of the warriors in round r */
+ADDR_T *
+melee_places(r)
+  int     r;
+{
+  return place + (r - 1) * warriors;
+}
+
+static void *
+runrounds(arg)
+  void   *arg;
+{
+  melee_thread *t = (melee_thread *) arg;
+
+  melee_rounds(warrior, t->score, &t->instructions);
+  return NULL;
+}
+
+/* ******************************************************************* */
+
+/* some warrior can load or store P-space */
+static int
+pspaceused()
+{
+  int     i;
+
+  for (i = 0; i < warriors; ++i)
+    if (pspace_used(warrior[i].instBank, warrior[i].instLen))
+      return TRUE;
+  return FALSE;
+}
+
+/*
+ * Runs the battle on SWITCH_j threads; FALSE (having done nothing) if it
+ * has to run on one.
+ */
+int
+melee_simulator1()
+{
+  melee_thread *t;
+  sigset_t all, old;
+  int     n, i, j, k, started;
+
+  if (debugState || SWITCH_e || rounds < 2 || pspaceused())
+    return FALSE;
+  n = SWITCH_j < rounds ? SWITCH_j : rounds;
+
+  place = (ADDR_T *) MALLOC((size_t) rounds * warriors * sizeof(ADDR_T));
+  t = (melee_thread *) MALLOC(n * sizeof(melee_thread));
+  if (place == NULL || t == NULL) {        /* one will do */
+    FREE(place);
+    FREE(t);
+    return FALSE;
+  }
+
+  /* the positions, as simulator1() would draw them round after round */
+  endWar = warrior + warriors;
+  seed = SWITCH_Fnum ?
+    (SWITCH_Fnum - separation) :
+    rng(SWITCH_f ? checksum_warriors() : time(0));
+  for (k = 0; k < rounds; ++k) {
+    if (posit())
+      npos();
+    for (i = 0; i < warriors; ++i)
+      place[k * warriors + i] = warrior[i].position;
+  }
+
+  /* signals are for this thread */
+  nextRound = 1;
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  for (started = 1; started < n; ++started)
+    if (pthread_create(&t[started].id, NULL, runrounds, t + started))
+      break;
+  pthread_sigmask(SIG_SETMASK, &old, NULL);
+  melee_rounds(warrior, t[0].score, &t[0].instructions);
+
+  for (k = 1; k < started; ++k)        /* they still read warrior[] */
+    pthread_join(t[k].id, NULL);
+  simInstructions = 0;
+  for (k = 0; k < started; ++k) {
+    for (i = 0; i < warriors; ++i)
+      for (j = 0; j < 2 * warriors - 1; ++j)
+        warrior[i].score[j] += t[k].score[i][j];
+    simInstructions += t[k].instructions;
+  }
+  round_num = rounds + 1;
+  for (i = 0; i < warriors; ++i)        /* where the last round had them */
+    warrior[i].position = place[(rounds - 1) * warriors + i];
+
+  FREE(t);
+  FREE(place);
+  return TRUE;
+}
+
+#endif                                /* MELEE */
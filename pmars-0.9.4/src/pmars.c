@@ -22,6 +22,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #if defined(unix) || defined(VMS)
 #include <signal.h>
 #else
@@ -30,6 +31,7 @@
 #endif
 #endif
 #include "global.h"
+#include "rcb.h"
 
 #if defined(LINUXGRAPHX)
 #include <vga.h>
@@ -97,6 +99,9 @@ extern void end_curses();
 
 /* external strings */
 extern char *stub386, *info01, *outOfMemory;
+#ifdef TRACE
+extern char *traceWriteErr;
+#endif
 #if defined(LINUXGRAPHX)
 extern char *cantInitSvga, *cantOpenConsole, *tcgetattrFails;
 #endif
@@ -179,13 +184,43 @@ init()
 #endif
 }
 
+/* a compiled warrior is loaded as it is, anything else assembled (and
+   with --compile saved compiled) */
+static int
+load(fName, aWarrior)
+  char   *fName;
+  int     aWarrior;
+{
+  int     code;
+
+  if ((code = rcb_load(fName, aWarrior)) == RCB_NOTRCB) {
+    code = assemble(fName, aWarrior);
+    if (code == SUCCESS && compileMode)
+      errorcode = code = rcb_write(fName, aWarrior);
+  }
+  return code;
+}
+
+#ifdef TRACE
+static void
+traceerr(fName)
+  char   *fName;
+{
+  char    outs[MAXALLCHAR];
+
+  sprintf(outs, traceWriteErr, fName);
+  errout(outs);
+  errorcode = FNOFOUND;
+}
+#endif
+
 void
 body()
 {
   int     i, j;
 
   for (i = 0; (i < warriors) && (errorcode == SUCCESS); i++)
-    if ((!assemble(warrior[i].fileName, i)) && (!SWITCH_b)) {
+    if ((!load(warrior[i].fileName, i)) && (!SWITCH_b) && (!compileMode)) {
       if (!SWITCH_A) {
 	fprintf(STDOUT, info01, warrior[i].name, warrior[i].instLen,
 		warrior[i].authorName);
@@ -203,8 +238,18 @@ body()
 #ifdef PSPACE                        /* set up pSpace */
   pspace_init();
 #endif
-  if (rounds && !SWITCH_A && (errorcode == SUCCESS)) {
+  if (rounds && !SWITCH_A && !compileMode && (errorcode == SUCCESS)) {
+#ifdef TRACE
+    if (SWITCH_t && trace_open(SWITCH_t, 0)) {
+      traceerr(SWITCH_t);
+      return;
+    }
+#endif
     simulator1();
+#ifdef TRACE
+    if (SWITCH_t && trace_close())
+      traceerr(SWITCH_t);
+#endif
     if (SWITCH_k) {
       set_reg('W', (long) warriors);        /* 'W' used in score calculation */
       if (warriors == 2)        /* standard 2-warrior game */
@@ -259,6 +304,9 @@ void
 Exit(errorcode)
   int     errorcode;
 {
+#ifdef TRACE
+  trace_close();                /* keep what was traced so far */
+#endif
 #if defined(CURSESGRAPHX)
   end_curses();                        /* Restore terminal to sane mode */
 #else
@@ -285,6 +333,8 @@ Exit(errorcode)
 #endif
 }
 
+/* pmars_worker (worker.c) brings its own main() */
+#ifndef PMARS_WORKER
 int
 main(argc, argv)
   int     argc;
@@ -330,17 +380,30 @@ main(argc, argv)
   xWinArgv = argv;
 #endif
 
+  if (argc > 1 && !strcmp(argv[1], "--compile")) {
+    compileMode = TRUE;
+    argv[1] = argv[0];
+    argc--, argv++;
+  } else if (argc > 1 && !strcmp(argv[1], "--batch")) {
+    batchMode = TRUE;
+    argv[1] = argv[0];
+    argc--, argv++;
+  }
   if ((errorcode = parse_param(argc, argv)) == 0) {
     init();
 #ifdef OS2PMGRAPHX                /* jk */
     pm_body();
 #else
-    body();
+    if (batchMode)
+      batch();
+    else
+      body();
 #endif
     Exit(errorcode);
   }
   return SWITCH_Q >= 0 ? returninfo() : errorcode;
 }
+#endif                                /* PMARS_WORKER */
 
 /* return exitcode based on SWITCH_Q setting, useful mainly in scripts */
 int
@@ -426,3 +489,24 @@ pspace_init()
   }
 }                                /* pspace_init() */
 #endif
+
+/*
+ * The code has LDP or STP: rounds of the warrior depend on the ones before,
+ * through its P-space.
+ */
+int
+pspace_used(code, length)
+  mem_struct *code;
+  int     length;
+{
+#ifdef PSPACE
+  int     i, op;
+
+  for (i = 0; i < length; ++i) {
+    op = code[i].opcode >> 3;
+    if (op == LDP || op == STP)
+      return TRUE;
+  }
+#endif
+  return FALSE;
+}
@@ -0,0 +1,372 @@
+/*
+ * rcb.c: compiled warriors (the format is in rcb.h)
+ *
+ * rcb_write() saves warrior[n] as assembled, for pmars --compile;
+ * rcb_load() loads one into warrior[n] instead of assembling it.  A
+ * compiled warrior is memory-mapped where the system has mmap().
+ */
+
+#include <stdio.h>
+#include <string.h>
+#if defined(unix) || defined(__unix__) || defined(__APPLE__)
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define RCB_MMAP
+#endif
+
+#include "global.h"
+#include "asm.h"
+#include "rcb.h"
+
+extern char *rcbBadErr, *rcbSettingsErr, *rcbWriteErr, *rcbStdinErr,
+       *rcbCompiled;
+
+static char *predefname[PREDEF_COUNT] = {
+  "CORESIZE", "MAXPROCESSES", "MAXCYCLES", "MAXLENGTH", "MINDISTANCE",
+  "VERSION", "WARRIORS", "ROUNDS", "READLIMIT", "WRITELIMIT", "PSPACESIZE"
+};
+
+/* ******************************************************************* */
+
+/* the opcode set of this pmars */
+static int
+rcbflags()
+{
+  int     flags = 0;
+
+#ifdef NEW_OPCODES
+  flags |= RCB_NEWOPCODES;
+#endif
+#ifdef NEW_MODES
+  flags |= RCB_NEWMODES;
+#endif
+#ifdef PSPACE
+  flags |= RCB_PSPACE;
+#endif
+#ifdef SHARED_PSPACE
+  flags |= RCB_SHAREDPSPACE;
+#endif
+  return flags;
+}
+
+/* ******************************************************************* */
+
+/* the predefined constants as the assembler would set them now */
+static void
+predefvals(v)
+  int    *v;
+{
+  memset(v, 0, PREDEF_COUNT * sizeof(int));
+  v[PREDEF_CORESIZE] = (int) coreSize;
+  v[PREDEF_MAXPROCESSES] = (int) taskNum;
+  v[PREDEF_MAXCYCLES] = (int) cycles;
+  v[PREDEF_MAXLENGTH] = (int) instrLim;
+  v[PREDEF_MINDISTANCE] = (int) separation;
+  v[PREDEF_VERSION] = PMARSVER;
+  v[PREDEF_WARRIORS] = warriors;
+  v[PREDEF_ROUNDS] = rounds;
+#ifdef RWLIMIT
+  v[PREDEF_READLIMIT] = (int) readLimit;
+  v[PREDEF_WRITELIMIT] = (int) writeLimit;
+#endif
+#ifdef PSPACE
+  v[PREDEF_PSPACESIZE] = (int) pSpaceSize;
+#endif
+}
+
+/* ******************************************************************* */
+
+/* name.red -> name.rcb (anything else gets .rcb added) */
+static char *
+rcbname(fName)
+  char   *fName;
+{
+  size_t  len = strlen(fName);
+  char   *rName;
+
+  if ((rName = (char *) MALLOC(len + 5)) == NULL)
+    return NULL;
+  strcpy(rName, fName);
+  if (len > 4 && rName[len - 4] == '.' &&
+      (rName[len - 3] | 0x20) == 'r' && (rName[len - 2] | 0x20) == 'e' &&
+      (rName[len - 1] | 0x20) == 'd')
+    len -= 4;
+  strcpy(rName + len, ".rcb");
+  return rName;
+}
+
+/* ******************************************************************* */
+
+/* FNV-1a (64 bit) of the file's bytes; FALSE if it can't be read */
+static int
+hashfile(fName, hash)
+  char   *fName;
+  unsigned int *hash;
+{
+  FILE   *fp;
+  unsigned long lo = 0x84222325UL, hi = 0xcbf29ce4UL;
+  int     c;
+
+  if ((fp = fopen(fName, "rb")) == NULL)
+    return FALSE;
+  while ((c = getc(fp)) != EOF) {
+    /* h = (h ^ c) * 0x100000001b3, in 32-bit halves */
+    unsigned long l = (lo ^ (unsigned long) c) & 0xffffffffUL;
+    unsigned long p0 = (l & 0xffffUL) * 0x1b3UL;
+    unsigned long p1 = (l >> 16) * 0x1b3UL;
+
+    hi = (hi * 0x1b3UL + (l << 8) + (p1 >> 16) +
+          (((p0 >> 16) + (p1 & 0xffffUL)) >> 16)) & 0xffffffffUL;
+    lo = (p0 + ((p1 & 0xffffUL) << 16)) & 0xffffffffUL;
+  }
+  c = ferror(fp);
+  fclose(fp);
+  hash[0] = (unsigned int) lo;
+  hash[1] = (unsigned int) hi;
+  return !c;
+}
+
+/* ******************************************************************* */
+
+int
+rcb_write(fName, aWarrior)
+  char   *fName;
+  int     aWarrior;
+{
+  warrior_struct *w = &warrior[aWarrior];
+  rcb_header h;
+  char   *rName, *texts[4], pad[4] = {0, 0, 0, 0};
+  FILE   *fp;
+  int     i, ok;
+
+  if (*fName == '\0') {
+    errout(rcbStdinErr);
+    return PARSEERR;
+  }
+  memset(&h, 0, sizeof(h));
+  h.magic = RCB_MAGIC;
+  h.version = RCB_VERSION;
+  h.byteOrder = BATTLE_BYTEORDER;
+  h.flags = rcbflags() | (SWITCH_8 ? RCB_88 : 0);
+#ifdef SHARED_PSPACE
+  if (w->pSpaceIndex == PIN_APPEARED) {
+    h.flags |= RCB_PIN;
+    h.pin = (int) w->pSpaceIDNumber;
+  }
+#endif
+  predefvals(h.predef);
+  h.predefsUsed = (int) w->predefs;
+  h.offset = w->offset;
+  h.length = w->instLen;
+  texts[0] = w->name;
+  texts[1] = w->authorName;
+  texts[2] = w->date;
+  texts[3] = w->version;
+  for (i = 0; i < 4; ++i)
+    h.strings += (int) strlen(texts[i]) + 1;
+  h.strings = (h.strings + 3) & ~3;
+
+  if ((rName = rcbname(fName)) == NULL)
+    Exit(MEMERR);
+  ok = hashfile(fName, h.source) && (fp = fopen(rName, "wb")) != NULL;
+  if (ok) {
+    int     len = 0;
+
+    ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (i = 0; i < 4 && ok; ++i) {
+      ok = fwrite(texts[i], strlen(texts[i]) + 1, 1, fp) == 1;
+      len += (int) strlen(texts[i]) + 1;
+    }
+    if (ok && len < h.strings)
+      ok = fwrite(pad, (size_t) (h.strings - len), 1, fp) == 1;
+    for (i = 0; i < w->instLen && ok; ++i) {
+      battle_inst b;
+      mem_struct *m = w->instBank + i;
+
+      b.a_value = m->A_value;
+      b.b_value = m->B_value;
+      b.opcode = m->opcode;
+      b.a_mode = m->A_mode;
+      b.b_mode = m->B_mode;
+      b.debuginfo = m->debuginfo;
+      ok = fwrite(&b, sizeof(b), 1, fp) == 1;
+    }
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok)
+      remove(rName);
+  }
+  if (ok) {
+    fprintf(STDOUT, rcbCompiled, fName, w->instLen, rName);
+  } else {
+    char    outs[MAXALLCHAR];
+
+    sprintf(outs, rcbWriteErr, rName);
+    errout(outs);
+  }
+  FREE(rName);
+  return ok ? SUCCESS : PARSEERR;
+}
+
+/* ******************************************************************* */
+
+/* the settings the code in h does not fit, or NULL */
+static char *
+misfit(h)
+  rcb_header *h;
+{
+  int     now[PREDEF_COUNT], i;
+
+  predefvals(now);
+  if (h->predef[PREDEF_CORESIZE] != now[PREDEF_CORESIZE])
+    return predefname[PREDEF_CORESIZE];
+  if (h->length > now[PREDEF_MAXLENGTH])
+    return predefname[PREDEF_MAXLENGTH];
+  for (i = 0; i < PREDEF_COUNT; ++i)
+    if ((h->predefsUsed & (1 << i)) && h->predef[i] != now[i])
+      return predefname[i];
+  if (SWITCH_8 && !(h->flags & RCB_88))
+    return "-8";
+  return NULL;
+}
+
+/* ******************************************************************* */
+
+/* fill w from the compiled warrior at p (size bytes); FALSE if it is
+   malformed, -1 (after saying why) if it doesn't fit the settings */
+static int
+rcbcopy(p, size, w, fName)
+  char   *p;
+  size_t  size;
+  warrior_struct *w;
+  char   *fName;
+{
+  rcb_header h;
+  char   *texts[4], *at, *end, *bad;
+  int     i;
+
+  memcpy(&h, p, sizeof(h));
+  if (h.version != RCB_VERSION || h.byteOrder != BATTLE_BYTEORDER ||
+      (h.flags & ~(RCB_88 | RCB_PIN)) != rcbflags() ||
+      h.length < 1 || h.length > MAXINSTR ||
+      h.offset < 0 || h.offset >= h.length ||
+      h.strings < 4 || (h.strings & 3) ||
+      size != sizeof(h) + (size_t) h.strings +
+      (size_t) h.length * sizeof(battle_inst))
+    return FALSE;
+
+  at = p + sizeof(h);
+  end = at + h.strings;
+  for (i = 0; i < 4; ++i) {
+    texts[i] = at;
+    while (at < end && *at)
+      at++;
+    if (at++ == end)
+      return FALSE;
+  }
+
+  if ((bad = misfit(&h)) != NULL) {
+    char    outs[MAXALLCHAR];
+
+    sprintf(outs, rcbSettingsErr, fName, bad);
+    errout(outs);
+    return -1;
+  }
+
+  if ((w->instBank = (mem_struct *)
+       MALLOC((h.length + 1) * sizeof(mem_struct))) == NULL)
+    Exit(MEMERR);
+  at = end;
+  for (i = 0; i < h.length; ++i) {
+    battle_inst b;
+    mem_struct *m = w->instBank + i;
+
+    memcpy(&b, at, sizeof(b));
+    at += sizeof(b);
+    m->A_value = (ADDR_T) (((b.a_value % coreSize) + coreSize) % coreSize);
+    m->B_value = (ADDR_T) (((b.b_value % coreSize) + coreSize) % coreSize);
+    m->opcode = b.opcode;
+    m->A_mode = b.a_mode;
+    m->B_mode = b.b_mode;
+    m->debuginfo = b.debuginfo;
+    if (b.debuginfo)
+      debugState = BREAK;
+  }
+  w->instLen = h.length;
+  w->offset = h.offset;
+  w->predefs = (unsigned int) h.predefsUsed;
+  w->name = pstrdup(texts[0]);
+  w->authorName = pstrdup(texts[1]);
+  w->date = pstrdup(texts[2]);
+  w->version = pstrdup(texts[3]);
+#ifdef PSPACE
+  w->pSpaceIndex = UNSHARED;
+#endif
+#ifdef SHARED_PSPACE
+  if (h.flags & RCB_PIN) {
+    w->pSpaceIndex = PIN_APPEARED;
+    w->pSpaceIDNumber = h.pin;
+  }
+#endif
+  return TRUE;
+}
+
+/* ******************************************************************* */
+
+int
+rcb_load(fName, aWarrior)
+  char   *fName;
+  int     aWarrior;
+{
+  FILE   *fp;
+  int     magic = 0, ok;
+  size_t  size = 0;
+  char   *p = NULL;
+
+  if (*fName == '\0' || (fp = fopen(fName, "rb")) == NULL)
+    return RCB_NOTRCB;                /* assemble() will complain */
+  if (fread(&magic, sizeof(magic), 1, fp) != 1 || magic != RCB_MAGIC) {
+    fclose(fp);
+    return RCB_NOTRCB;
+  }
+
+#ifdef RCB_MMAP
+  {
+    struct stat st;
+
+    if (!fstat(fileno(fp), &st) && st.st_size >= (off_t) sizeof(rcb_header) &&
+        (p = (char *) mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE,
+                           fileno(fp), 0)) != (char *) MAP_FAILED)
+      size = (size_t) st.st_size;
+    else
+      p = NULL;
+  }
+#else
+  if (!fseek(fp, 0L, SEEK_END) && ftell(fp) >= (long) sizeof(rcb_header) &&
+      (p = (char *) MALLOC(size = (size_t) ftell(fp))) != NULL) {
+    rewind(fp);
+    if (fread(p, size, 1, fp) != 1) {
+      FREE(p);
+      p = NULL;
+    }
+  }
+#endif
+  fclose(fp);
+
+  ok = p ? rcbcopy(p, size, &warrior[aWarrior], fName) : FALSE;
+  if (ok == FALSE) {
+    char    outs[MAXALLCHAR];
+
+    sprintf(outs, rcbBadErr, fName);
+    errout(outs);
+  }
+#ifdef RCB_MMAP
+  if (p)
+    munmap(p, size);
+#else
+  FREE(p);
+#endif
+
+  errorcode = ok == TRUE ? SUCCESS : PARSEERR;
+  return errorcode;
+}
@@ -0,0 +1,58 @@
+/*
+ * rcb.h: compiled warriors (.rcb), written by pmars --compile
+ *
+ * A compiled warrior is the assembler's output for one warrior, so that it
+ * can be loaded (memory-mapped) without assembling it again:
+ *
+ *   rcb_header
+ *   the ;name, ;author, ;date and ;version texts, each ending in a NUL,
+ *           header.strings bytes in all (padded to a multiple of 4)
+ *   header.length battle_inst
+ *
+ * All fields are 32-bit ints in the byte order of the machine that wrote it
+ * (byteOrder says which; a reader refuses the other one).
+ *
+ * The code depends on the settings it was assembled for.  Core size and the
+ * opcode set (flags) always matter and the length must fit MAXLENGTH; any
+ * other predefined constant (ROUNDS, WARRIORS ...) only if the source refers
+ * to it (predefsUsed), which is how a hill compiled once loads for any
+ * number of rounds.  source is a hash of the source text, so that tools can
+ * tell whether a .rcb is still the compiled form of a .red.
+ *
+ * The C++ side includes this too.
+ */
+
+#ifndef RCB_INCLUDED
+#define RCB_INCLUDED
+
+#include "assemble.h"
+
+#define RCB_MAGIC       0x31424352        /* "RCB1" */
+#define RCB_VERSION     1
+
+/* flags: the opcode set the code was assembled with */
+#define RCB_NEWOPCODES  0x01                /* SEQ SNE NOP */
+#define RCB_NEWMODES    0x02                /* * { } */
+#define RCB_PSPACE      0x04                /* LDP STP */
+#define RCB_SHAREDPSPACE 0x08                /* PIN */
+#define RCB_88          0x10                /* checked for ICWS'88 (-8) */
+#define RCB_PIN         0x20                /* pin is set */
+
+/* what rcb_load() returns for a file that is not a compiled warrior */
+#define RCB_NOTRCB      (-100)
+
+typedef struct rcb_header {
+  int     magic;                        /* RCB_MAGIC */
+  int     version;                        /* RCB_VERSION */
+  int     byteOrder;                /* BATTLE_BYTEORDER */
+  int     flags;
+  unsigned int source[2];        /* FNV-1a hash of the source, low word first */
+  int     predef[PREDEF_COUNT];        /* the predefined constants */
+  int     predefsUsed;                /* 1 << PREDEF_x the source refers to */
+  int     offset;                /* start offset (ORG/END) */
+  int     pin;                        /* PIN, with RCB_PIN */
+  int     strings;                /* bytes of text that follow */
+  int     length;                /* battle_inst after the text */
+}       rcb_header;
+
+#endif                                /* RCB_INCLUDED */
@@ -29,6 +29,19 @@
 #include "sim.h"
 #include <time.h>
 
+/*
+ * simtrace.c compiles this file a second time with TRACE_SIM: that copy of
+ * simulator1() is trace_simulator1(), the one that records a trace, so that
+ * the display hooks cost nothing here while no trace is recorded.
+ * simmelee.c compiles it again with MELEE_SIM for the threads of melee.c:
+ * thread_simulator1() runs the rounds melee_round() hands it, on state of
+ * its own.
+ */
+#ifdef TRACE_SIM
+#define simulator1 trace_simulator1
+#undef STEADY                        /* a trace has every cycle */
+#endif
+
 #ifdef unix
 #include <signal.h>
 #endif
@@ -93,6 +106,25 @@ extern void sighandler(int dummy);
 #endif
 
 #else                                /* !GRAPHX */
+#ifdef TRACE_SIM
+/* simtrace.c: no display, the hooks feed the trace being recorded */
+#include "trace.h"
+#define traced(call) do { if (traceOn) call; } while (0)
+#define display_init()
+#define display_clear() traced(trace_round())
+#define display_read(addr) traced(trace_addr(TR_READ, addr))
+#define display_write(addr) traced(trace_addr(TR_WRITE, addr))
+#define display_dec(addr) traced(trace_addr(TR_DEC, addr))
+#define display_inc(addr) traced(trace_addr(TR_INC, addr))
+#define display_exec(addr) traced(trace_addr(TR_EXEC, addr))
+#define display_spl(warrior,tasks) \
+	do { if ((tasks) > 1) traced(trace_event(TR_SPL)); } while (0)
+#define display_dat(address,warrior,tasks) traced(trace_event(TR_DAT))
+#define display_die(warnum) traced(trace_event(TR_MARK))
+#define display_close()
+#define display_cycle()
+#define display_push(val)
+#else
 #define display_init()
 #define display_clear()
 #define display_read(addr)
@@ -109,6 +141,7 @@ extern void sighandler(int dummy);
 #endif
 #endif
 #endif
+#endif
 
 #ifdef DOS16
 #define push(val) *W->taskTail++=(val)
@@ -154,32 +187,37 @@ extern char *fatalErrorInSimulator;
 extern char *warriorTerminatedEndOfRound;
 extern char *endOfRound;
 
-warrior_struct *W;                /* indicate which warrior is running */
-U32_T   totaltask;                /* size of the taskQueue */
-ADDR_T FAR *endQueue;
-ADDR_T FAR *taskQueue;
-ADDR_T  progCnt;                /* program counter */
+#ifndef TRACE_SIM
+SIM_LOCAL warrior_struct *W;        /* indicate which warrior is running */
+SIM_LOCAL U32_T totaltask;        /* size of the taskQueue */
+SIM_LOCAL ADDR_T FAR *endQueue;
+SIM_LOCAL ADDR_T FAR *taskQueue;
+SIM_LOCAL ADDR_T progCnt;        /* program counter */
 
-  mem_struct FAR *destPtr;        /* pointer used to copy program to core */
-  mem_struct FAR *tempPtr;        /* temporary pointer used in op decode phase */
+SIM_LOCAL mem_struct FAR *destPtr;        /* pointer used to copy program to core */
+SIM_LOCAL mem_struct FAR *tempPtr;        /* temporary pointer used in op decode phase */
 
-  mem_struct IR;                /* current instruction and A cell */
+SIM_LOCAL mem_struct IR;        /* current instruction and A cell */
 #ifdef NEW_MODES
 //  mem_struct IRA;                /* A/B_field hold A-field of A/B-pointer
 //                                 * necessary for '}' mode */
-ADDR_T AA_Value, AB_Value;
+SIM_LOCAL ADDR_T AA_Value, AB_Value;
 #endif
 
-mem_struct FAR *memory;
+SIM_LOCAL mem_struct FAR *memory;
 
-long    cycle;
-int     round_num;
+SIM_LOCAL long cycle;
+SIM_LOCAL int round_num;
+SIM_LOCAL unsigned long simInstructions;        /* executed by the last simulator1() */
 
-char    alloc_p = 0;                /* indicate whether memory has been allocated */
-int     warriorsLeft;                /* number of warriors still left in core */
+SIM_LOCAL char alloc_p = 0;        /* indicate whether memory has been allocated */
+SIM_LOCAL int warriorsLeft;        /* number of warriors still left in core */
 
-warrior_struct *endWar;                /* end of the warriors array */
+SIM_LOCAL warrior_struct *endWar;        /* end of the warriors array */
 
+#ifdef MELEE_SIM
+static SIM_LOCAL int firstRound;        /* melee_rounds() took it */
+#else
 /*--------------------*/
 #ifdef NEW_STYLE
 S32_T
@@ -215,6 +253,16 @@ checksum_warriors()
   } while (W < endWar);
   return checksum;
 }
+#endif                                /* MELEE_SIM */
+#else
+/* sim.c has them */
+extern S32_T checksum_warriors();
+extern SIM_LOCAL mem_struct FAR *destPtr, FAR *tempPtr;
+extern SIM_LOCAL mem_struct IR;
+#ifdef NEW_MODES
+extern SIM_LOCAL ADDR_T AA_Value, AB_Value;
+#endif
+#endif                                /* TRACE_SIM */
 
 #ifdef RWLIMIT
 static ADDR_T
@@ -236,6 +284,65 @@ foldw(ADDR_T a)
 }
 #endif
 
+#ifdef STEADY
+#define STEADYGAP 1024                /* cycles at least between two looks */
+#define IMP(m) ((m)->opcode == OP(MOV, mI) && \
+	(m)->A_mode == DIRECT && (m)->A_value == 0 && \
+	(m)->B_mode == DIRECT && (m)->B_value == 1)
+#define JMP0(m) (((m)->opcode >> 3) == JMP && \
+	(m)->A_mode == DIRECT && (m)->A_value == 0 && \
+	((m)->B_mode == DIRECT || (m)->B_mode == IMMEDIATE))
+
+/*
+ * TRUE if the round can only end with the warriors left all alive: every
+ * process of theirs is on an imp (MOV.I $0, $1) or a JMP $0 loop.  An imp
+ * copies itself to the next cell and moves there, a JMP $0 stays put;
+ * neither dies or splits, and all that is ever written is imps, so whatever
+ * the imps crawl over becomes an imp as well.  Otherwise *at is the cycle
+ * to look again at, the later the more processes this look took (0: not
+ * this round).
+ */
+static int
+steady(long *at)
+{
+  warrior_struct *w = W;
+  ADDR_T FAR *t;
+  mem_struct FAR *m;
+  long    n = 0;
+  int     i;
+
+#ifdef RWLIMIT
+  if (writeLimit < 2) {                /* an imp would write over itself */
+    *at = 0;
+    return FALSE;
+  }
+#endif
+  if (debugState) {                /* cdb may want any cycle */
+    *at = 0;
+    return FALSE;
+  }
+  do {
+    for (t = w->taskHead, i = w->tasks; i; --i) {
+      m = memory + *t;
+      ++n;
+      if (!IMP(m) && !JMP0(m)) {
+	*at = cycle - (n * 8 > STEADYGAP ? n * 8 : STEADYGAP);
+	if (*at < 0)
+	  *at = 0;
+	return FALSE;
+      }
+#ifndef DOS16
+      if (++t == endQueue)
+	t = taskQueue;
+#else
+      ++t;
+#endif
+    }
+  } while ((w = w->nextWarrior) != W);
+  return TRUE;
+}
+#endif                                /* STEADY */
+
 
 void
 simulator1()
@@ -245,11 +352,14 @@ simulator1()
 #endif
   /* range for random number generator */
   warrior_struct *oldW;                /* the previous living warrior to execute */
+#ifndef MELEE_SIM
   ADDR_T  positions = coreSize + 1 - (separation << 1);
+#endif
   ADDR_T  coreSize1 = coreSize - 1;
   warrior_struct *starter = warrior;        /* pointer to warrior that starts
 					 * round */
   U32_T   cycles2 = warriors * cycles;
+  U32_T   skipped;                /* turns of the dead not run this round */
 #ifndef SERVER
   char    outs[60];                /* for cdb() entering message */
 #endif
@@ -264,7 +374,21 @@ register  int     temp;                        /* general purpose temporary vari
 #ifdef RWLIMIT
   ADDR_T raddrB = 0;
 #endif
+#ifdef STEADY
+  long    steadyAt;                /* the cycle to call steady() at, 0:
+				 * not this round */
+#endif
 
+#if defined(TRACE) && !defined(TRACE_SIM) && !defined(MELEE_SIM)
+  if (traceOn) {
+    trace_simulator1();
+    return;
+  }
+#endif
+#if defined(MELEE) && !defined(TRACE_SIM) && !defined(MELEE_SIM)
+  if (SWITCH_j > 1 && warriors > 2 && melee_simulator1())
+    return;
+#endif
   endWar = warrior + warriors;
 
 #ifdef PERMUTATE
@@ -314,6 +438,7 @@ register  int     temp;                        /* general purpose temporary vari
     endQueue = taskQueue + totaltask;
   }
 #endif
+#ifndef MELEE_SIM                /* melee.c has drawn the positions */
   if (SWITCH_e)
     debugState = STEP;                /* automatically enter debugger */
   if (!debugState)
@@ -326,9 +451,15 @@ register  int     temp;                        /* general purpose temporary vari
   if (SWITCH_Fnum && SWITCH_P)
     seed *= warriors; /* get table index from position */
 #endif
+#endif                                /* MELEE_SIM */
 
   display_init();
+#ifdef MELEE_SIM
+  round_num = firstRound;
+#else
   round_num = 1;
+#endif
+  simInstructions = 0;
   do {                                /* each round */
 #if defined(DOS16) && !defined(SERVER) && !defined(DOSTXTGRAPHX) && !defined(DOSGRXGRAPHX) && !defined(DJGPP)
     fputc('\r', stdout);        /* enable interruption by Ctrl-C */
@@ -340,7 +471,14 @@ register  int     temp;                        /* general purpose temporary vari
 #endif
     warriorsLeft = warriors;
     cycle = cycles2;
+    skipped = 0;
     if (warriors > 1) {
+#ifdef MELEE_SIM
+      tempPtr2 = melee_places(round_num);
+      for (temp = 0; temp < warriors; ++temp)
+        warrior[temp].position = tempPtr2[temp];
+      starter = warrior + (round_num - 1) % warriors;
+#else
       if (warriors == 2) {
 #ifdef PERMUTATE
         if (SWITCH_P) {
@@ -361,6 +499,7 @@ register  int     temp;                        /* general purpose temporary vari
 	  npos();                /* use back-up positioning algo npos if posit
 				 * fails */
       }
+#endif                                /* MELEE_SIM */
     }
     /* create nextWarrior links each round */
     /* leave oldW pointing to last warrior */
@@ -396,8 +535,14 @@ register  int     temp;                        /* general purpose temporary vari
     } while (++temp < warriors);
 
     display_clear();
+#ifdef STEADY
+    steadyAt = cycle > STEADYGAP ? cycle - STEADYGAP : 0;
+#endif
     /* the inner loop of execution */
     do {                        /* each cycle */
+#ifdef STEADY
+  nextcycle:
+#endif
       display_cycle();
      // progCnt = *(W->taskHead++);
      // IR = memory[progCnt];        /* copy instruction into register */
@@ -427,7 +572,7 @@ if (IR.A_mode != (FIELD_T) IMMEDIATE)
 
 	if (IR.A_mode != (FIELD_T) DIRECT)
 	{
-		ADDR_T waddrA;		/* Stores core addr. of base ofs cell for */
+		ADDR_T waddrA = addrA;	/* Stores core addr. of base ofs cell for */
 					/*  predec/postinc modes. */
 
 		/* Computing the base offset cell's addr into tempPtr and the offset cell's
@@ -1277,6 +1422,7 @@ if (IR.B_mode != (FIELD_T) IMMEDIATE)
 	  goto nopush;
 	display_die(W - warrior);
 	W->score[warriorsLeft + warriors - 2]++;
+	skipped += (cycle - 1) / warriorsLeft;
 	cycle = cycle - 1 - (cycle - 1) / (warriorsLeft--);
 	if (warriorsLeft < 2)
 	  goto nextround;        /* can't use break because in switch */
@@ -1401,8 +1547,22 @@ if (IR.B_mode != (FIELD_T) IMMEDIATE)
       oldW = W;
       W = W->nextWarrior;
 //      --cycle;
+#ifdef STEADY
+    } while (--cycle > steadyAt);        /* next cycle, or a look */
+    if (cycle > 0) {
+      if (!steady(&steadyAt))
+	goto nextcycle;
+      skipped += cycle;                /* the rest are not executed */
+      cycle = 0;                /* as if it had run them all */
+    }
+#else
     } while (--cycle);                /* next cycle */
+#endif
 nextround:
+#ifdef TRACE_SIM
+    traced(trace_end());
+#endif
+    simInstructions += cycles2 - cycle - skipped;
     for (temp = 0; temp < warriors; temp++) {
       if (warrior[temp].tasks) {
 	warrior[temp].score[warriorsLeft - 1]++;
@@ -1427,7 +1587,11 @@ nextround:
       debugState = cdb(outs);
     }
 #endif
+#ifdef MELEE_SIM
+  } while ((round_num = melee_round()) <= rounds);
+#else
   } while (++round_num <= rounds);
+#endif
 
   display_close();
 #ifdef PERMUTATE
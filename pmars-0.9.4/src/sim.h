@@ -89,15 +89,16 @@ extern int displayMode;
 #define FAR
 #endif
 
-extern int round_num;
-extern long cycle;
-extern ADDR_T progCnt;                /* program counter */
-extern warrior_struct *W;        /* indicate which warrior is running */
-extern char alloc_p;
-extern int warriorsLeft;
+extern SIM_LOCAL int round_num;
+extern SIM_LOCAL long cycle;
+extern SIM_LOCAL unsigned long simInstructions;
+extern SIM_LOCAL ADDR_T progCnt;        /* program counter */
+extern SIM_LOCAL warrior_struct *W;        /* indicate which warrior is running */
+extern SIM_LOCAL char alloc_p;
+extern SIM_LOCAL int warriorsLeft;
 
-extern ADDR_T FAR *endQueue;
-extern mem_struct FAR *memory;
-extern ADDR_T FAR *taskQueue;
-extern warrior_struct *endWar;
-extern U32_T totaltask;
+extern SIM_LOCAL ADDR_T FAR *endQueue;
+extern SIM_LOCAL mem_struct FAR *memory;
+extern SIM_LOCAL ADDR_T FAR *taskQueue;
+extern SIM_LOCAL warrior_struct *endWar;
+extern SIM_LOCAL U32_T totaltask;
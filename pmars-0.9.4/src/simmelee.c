@@ -0,0 +1,70 @@
+/*
+ * simmelee.c: the simulator of the threads of melee.c
+ *
+ * sim.c compiled again as thread_simulator1(), with the state sim.h and
+ * warrior[] hold renamed and THREAD_LOCAL, so that every thread has its own
+ * core, task queue and warriors while simulator1() keeps plain globals.
+ * It is a SERVER simulator: a melee thread has no display and no cdb.
+ */
+
+#include <string.h>
+#include "config.h"
+
+#ifdef MELEE
+
+#define MELEE_SIM
+#define SERVER
+#undef PERMUTATE                        /* -P is for two warriors */
+#define SIM_LOCAL THREAD_LOCAL
+
+#define simulator1      thread_simulator1
+#define warrior         thread_warrior
+#define W               thread_W
+#define totaltask       thread_totaltask
+#define endQueue        thread_endQueue
+#define taskQueue       thread_taskQueue
+#define progCnt         thread_progCnt
+#define destPtr         thread_destPtr
+#define tempPtr         thread_tempPtr
+#define IR              thread_IR
+#define AA_Value        thread_AA_Value
+#define AB_Value        thread_AB_Value
+#define memory          thread_memory
+#define cycle           thread_cycle
+#define round_num       thread_round_num
+#define simInstructions thread_simInstructions
+#define alloc_p         thread_alloc_p
+#define warriorsLeft    thread_warriorsLeft
+#define endWar          thread_endWar
+
+#include "sim.c"
+
+SIM_LOCAL warrior_struct warrior[MAXWARRIOR];
+
+/*
+ * Runs rounds on the calling thread, as long as melee_round() has any, with
+ * the warriors in from[]; what they scored goes to score[], the
+ * instructions executed to *instructions.
+ */
+void
+melee_rounds(from, score, instructions)
+  warrior_struct *from;
+  short   score[][MAXWARRIOR * 2 - 1];
+  unsigned long *instructions;
+{
+  int     i, j;
+
+  memcpy(warrior, from, warriors * sizeof(warrior_struct));
+  for (i = 0; i < warriors; ++i)
+    for (j = 0; j < 2 * warriors - 1; ++j)
+      warrior[i].score[j] = 0;
+  simInstructions = 0;
+  if ((firstRound = melee_round()) <= rounds)
+    simulator1();
+  for (i = 0; i < warriors; ++i)
+    for (j = 0; j < 2 * warriors - 1; ++j)
+      score[i][j] = warrior[i].score[j];
+  *instructions = simInstructions;
+}
+
+#endif                                /* MELEE */
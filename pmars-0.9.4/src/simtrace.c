@@ -0,0 +1,9 @@
+/*
+ * simtrace.c: the simulator that records a trace (trace.h)
+ *
+ * sim.c compiled again with its display hooks calling trace.c, as
+ * trace_simulator1().  simulator1() runs it while a trace is open.
+ */
+
+#define TRACE_SIM
+#include "sim.c"
@@ -362,7 +362,7 @@ char   *usage_screen =
 "Usage:\n   pmarsv [options] file1 [files ..]\n   The special file - stands for standard input\n\n";
 #else
 char   *usage_screen =
-"Usage:\n   pmars [options] file1 [files ..]\n   The special file - stands for standard input\n\n";
+"Usage:\n   pmars [options] file1 [files ..]\n   pmars --compile [options] file1 [files ..]\n   pmars --batch [options] < battles\n   The special file - stands for standard input\n   --compile writes each warrior assembled to file.rcb, which is then\n   loaded without assembling it again\n   --batch fights a battle per line of its input (files [-r #] [-F #])\n   and writes a line of -k results for each\n\n";
 #endif
 #endif
 
@@ -422,6 +422,13 @@ char   *optReadLimit = "Read limit size";
 char   *optWriteLimit = "Write limit size";
 #endif
 char   *optAssemble = "Assemble warriors only";
+#ifdef TRACE
+char   *optTrace = "Record a trace to file $";
+char   *traceWriteErr = "Cannot write trace file '%s'\n";
+#endif
+#ifdef MELEE
+char   *optThreads = "Threads for multiwarrior rounds [1]";
+#endif
 #if defined(XWINGRAPHX)
 char   *optXOpt[] = {
   "Display to connect to",
@@ -430,6 +437,21 @@ char   *optXOpt[] = {
 };
 #endif
 char   *noWarriorFile = "\nNo warrior file specified\n";
+char   *rcbBadErr = "File '%s' is not a compiled warrior this pmars can load\n";
+char   *rcbSettingsErr = "'%s' was compiled for other settings (%s), compile it again\n";
+char   *rcbWriteErr = "Cannot write compiled warrior '%s'\n";
+char   *rcbStdinErr = "Standard input cannot be compiled\n";
+char   *rcbCompiled = "%s: %d instructions compiled to %s\n";
+char   *batchFilesErr = "pmars --batch reads its warriors from standard input\n";
+char   *batchStdinErr = "warriors cannot come from standard input";
+char   *batchOptionErr = "only -r and -F can be given per battle";
+char   *batchRoundsErr = "bad -r";
+char   *batchFErr = "bad -F, or less than -d";
+char   *batchWarriorsErr = "wrong number of warriors";
+char   *batchCoreErr = "core too small for the warriors";
+char   *batchPErr = "-P needs two warriors";
+char   *batchLoadErr = "%s does not assemble";
+char   *batchLineErr = "line too long";
 char   *fFExclusive = "\nOnly one of -f and -F can be given\n";
 char   *coreSizeTooSmall = "\nCore size is too small\n";
 char   *dLessThanl = "\nWarrior distance cannot be smaller than warrior length\n";
@@ -0,0 +1,358 @@
+/*
+ * trace.c: battle traces (the format is in trace.h)
+ *
+ * With -DTRACE, simulator1() runs trace_simulator1() (simtrace.c) while
+ * traceOn is set, whose display hooks call in here.  trace_open() sets it,
+ * trace_close() (or the end of the last round it was asked for) clears it.  Events are coded into a ring buffer that
+ * a writer thread empties into the file, so the simulator doesn't wait for
+ * the disk: the simulator only moves head, the writer only tail, and each
+ * publishes its own with a release store the other reads with an acquire
+ * load, no locks.  Without threads the simulator writes out the ring itself
+ * when it is full.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "global.h"
+#include "sim.h"
+#include "trace.h"
+
+#ifdef TRACE
+
+#if defined(unix) && defined(__GNUC__)
+#include <pthread.h>
+#include <time.h>
+#define TRACE_THREAD
+#define LOAD(v)    __atomic_load_n(&(v), __ATOMIC_ACQUIRE)
+#define STORE(v,x) __atomic_store_n(&(v), (x), __ATOMIC_RELEASE)
+#else
+#define LOAD(v)    (v)
+#define STORE(v,x) ((v) = (x))
+#endif
+
+#define RINGSIZE (1UL << 20)
+#define RINGMASK (RINGSIZE - 1)
+#define EVENTMAX 16                        /* room an address event needs */
+
+int     traceOn;                        /* the hooks record */
+
+static FILE *traceFile;
+static unsigned char *ring;
+static unsigned long head;                /* published by the simulator */
+static unsigned long tail;                /* published by the writer */
+static unsigned long put;                /* next byte the simulator codes */
+static unsigned long limit;                /* put may go up to here */
+static int writeFailed;
+static int maxRounds, roundsDone;
+
+static int current;                        /* warrior executing */
+static long fetched;                        /* the cycle whose EXEC is out */
+static int alive[MAXWARRIOR];
+static ADDR_T lastExec[MAXWARRIOR];
+
+#ifdef TRACE_THREAD
+static pthread_t writer;
+static int stopping;
+#endif
+
+/* ******************************************************************* */
+
+/* writes ring[from, to) to the file */
+static void
+drain(from, to)
+  unsigned long from, to;
+{
+  size_t  n;
+
+  while (from != to) {
+    n = (size_t) (to - from);
+    if (n > RINGSIZE - (from & RINGMASK))
+      n = (size_t) (RINGSIZE - (from & RINGMASK));
+    if (!writeFailed && fwrite(ring + (from & RINGMASK), n, 1, traceFile) != 1)
+      writeFailed = 1;
+    from += n;
+  }
+}
+
+#ifdef TRACE_THREAD
+static void
+nap(usec)
+  long    usec;
+{
+  struct timespec t;
+
+  t.tv_sec = 0;
+  t.tv_nsec = usec * 1000L;
+  nanosleep(&t, NULL);
+}
+
+/* the writer thread: whatever the simulator published goes to the file */
+static void *
+writeout(arg)
+  void   *arg;
+{
+  unsigned long h, t = tail;
+  int     stop;
+
+  (void) arg;
+  for (;;) {
+    stop = LOAD(stopping);
+    if ((h = LOAD(head)) != t) {
+      drain(t, h);
+      STORE(tail, t = h);
+    } else if (stop)
+      break;
+    else
+      nap(1000L);
+  }
+  return NULL;
+}
+#endif
+
+/* makes room for n more bytes at put */
+static void
+room(n)
+  unsigned long n;
+{
+  if (put + n <= limit)
+    return;
+#ifdef TRACE_THREAD
+  while (put + n > (limit = LOAD(tail) + RINGSIZE))
+    nap(100L);
+#else
+  drain(tail, put);
+  tail = put;
+  limit = tail + RINGSIZE;
+#endif
+}
+
+#define putbyte(b) (ring[put++ & RINGMASK] = (unsigned char) (b))
+#define publish()  STORE(head, put)
+
+static void
+putvar(v)
+  unsigned long v;
+{
+  while (v >= 0x80) {
+    putbyte((v & 0x7f) | 0x80);
+    v >>= 7;
+  }
+  putbyte(v);
+}
+
+/* an address event: the distance of addr from base, zigzag coded */
+static void
+putaddr(kind, addr, base)
+  int     kind;
+  long    addr, base;
+{
+  long    d = addr - base;
+  unsigned long z;
+
+  if (2 * d > (long) coreSize)
+    d -= coreSize;
+  else if (2 * d <= -(long) coreSize)
+    d += coreSize;
+  z = d >= 0 ? (unsigned long) d << 1 : ((unsigned long) -d << 1) - 1;
+  if (z < TR_BIG)
+    putbyte(TR_TAG(kind, z));
+  else {
+    putbyte(TR_TAG(kind, TR_BIG));
+    putvar(z);
+  }
+}
+
+/* ******************************************************************* */
+
+/*
+ * Starts a trace of the battle about to be run in fName, of its first
+ * nRounds rounds (0: all of them).  The warriors must be loaded.  Returns
+ * 0, or -1 if the file can't be written.
+ */
+int
+trace_open(fName, nRounds)
+  char   *fName;
+  int     nRounds;
+{
+  trace_header h;
+  int     i, j, ok;
+
+  trace_close();
+  if (ring == NULL &&
+      (ring = (unsigned char *) MALLOC(RINGSIZE)) == NULL)
+    return -1;
+  if ((traceFile = fopen(fName, "wb")) == NULL)
+    return -1;
+
+  h.magic = TRACE_MAGIC;
+  h.version = TRACE_VERSION;
+  h.byteOrder = BATTLE_BYTEORDER;
+  h.coreSize = (int) coreSize;
+  h.cycles = (int) cycles;
+  h.processes = taskNum;
+  h.warriors = warriors;
+  h.rounds = rounds;
+  ok = fwrite(&h, sizeof(h), 1, traceFile) == 1;
+  for (i = 0; i < warriors && ok; ++i) {
+    trace_warrior t;
+    char   *name = warrior[i].name ? warrior[i].name : "";
+
+    t.length = warrior[i].instLen;
+    t.offset = warrior[i].offset;
+    t.nameLen = (int) strlen(name);
+    ok = fwrite(&t, sizeof(t), 1, traceFile) == 1 &&
+      fwrite(name, (size_t) t.nameLen, 1, traceFile) == (t.nameLen > 0);
+    for (j = 0; j < t.length && ok; ++j) {
+      battle_inst b;
+      mem_struct *m = warrior[i].instBank + j;
+
+      b.a_value = m->A_value;
+      b.b_value = m->B_value;
+      b.opcode = m->opcode;
+      b.a_mode = m->A_mode;
+      b.b_mode = m->B_mode;
+      b.debuginfo = 0;
+      ok = fwrite(&b, sizeof(b), 1, traceFile) == 1;
+    }
+  }
+  if (!ok) {
+    fclose(traceFile);
+    traceFile = NULL;
+    remove(fName);
+    return -1;
+  }
+
+  head = tail = put = 0;
+  limit = RINGSIZE;
+  writeFailed = 0;
+  maxRounds = nRounds;
+  roundsDone = 0;
+#ifdef TRACE_THREAD
+  stopping = 0;
+  if (pthread_create(&writer, NULL, writeout, NULL) != 0) {
+    fclose(traceFile);
+    traceFile = NULL;
+    remove(fName);
+    return -1;
+  }
+#endif
+  traceOn = 1;
+  return 0;
+}
+
+/* ends the trace; 0, or -1 if it couldn't all be written */
+int
+trace_close()
+{
+  int     failed;
+
+  if (traceFile == NULL)
+    return 0;
+  traceOn = 0;
+  room(1);
+  putbyte(TR_TAG(TR_MARK, TRM_STOP));
+  publish();
+#ifdef TRACE_THREAD
+  STORE(stopping, 1);
+  pthread_join(writer, NULL);
+#else
+  drain(tail, put);
+#endif
+  failed = fclose(traceFile) != 0 || writeFailed;
+  traceFile = NULL;
+  return failed ? -1 : 0;
+}
+
+/* ******************************************************************* */
+
+/* display_clear(): the warriors are in the core, W starts */
+void
+trace_round()
+{
+  int     i;
+
+  room((unsigned long) (warriors + 2) * 5 + 1);
+  putbyte(TR_TAG(TR_MARK, TRM_ROUND));
+  putvar((unsigned long) round_num);
+  putvar((unsigned long) (W - warrior));
+  for (i = 0; i < warriors; ++i) {
+    putvar((unsigned long) warrior[i].position);
+    lastExec[i] = (ADDR_T) ((warrior[i].position + warrior[i].offset) % coreSize);
+    alive[i] = 1;
+  }
+  publish();
+  /* as if the one before the starter had just had its turn */
+  current = (int) (W - warrior) + warriors - 1;
+  current %= warriors;
+  fetched = -1;
+}
+
+/*
+ * The EXEC of this cycle, and whose turn it is if not the next one's.  It
+ * goes out with the first event of the cycle: a cycle is new when sim.c's
+ * cycle count (which only goes down during a round) has changed.
+ */
+static void
+fetch()
+{
+  int     w = (int) (W - warrior), next = current;
+
+  room(2 * EVENTMAX);
+  do {
+    if (++next == warriors)
+      next = 0;
+  } while (!alive[next] && next != current);
+  if (w != next) {
+    putbyte(TR_TAG(TR_MARK, TRM_WARRIOR));
+    putvar((unsigned long) w);
+  }
+  putaddr(TR_EXEC, (long) progCnt, (long) lastExec[w]);
+  lastExec[w] = progCnt;
+  current = w;
+  fetched = cycle;
+}
+
+/* display_exec(), display_read() ... */
+void
+trace_addr(kind, addr)
+  int     kind, addr;
+{
+  if (fetched != cycle)
+    fetch();
+  if (kind != TR_EXEC) {
+    room(EVENTMAX);
+    putaddr(kind, (long) addr, (long) progCnt);
+  }
+  publish();
+}
+
+/* display_spl(), display_dat(), display_die() (TR_MARK) */
+void
+trace_event(kind)
+  int     kind;
+{
+  if (fetched != cycle)
+    fetch();
+  room(1);
+  if (kind == TR_MARK) {
+    putbyte(TR_TAG(TR_MARK, TRM_DIE));
+    alive[current] = 0;
+  } else
+    putbyte(TR_TAG(kind, 0));
+  publish();
+}
+
+/* the round is over */
+void
+trace_end()
+{
+  room(6);
+  putbyte(TR_TAG(TR_MARK, TRM_END));
+  putvar((unsigned long) warriorsLeft);
+  publish();
+  if (++roundsDone == maxRounds)
+    traceOn = 0;
+}
+
+#endif                                /* TRACE */
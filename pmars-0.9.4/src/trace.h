@@ -0,0 +1,94 @@
+/*
+ * trace.h: battle traces, written by pmars -t and sampled by pmars_worker
+ *
+ * A trace records what the display hooks of sim.c see (which cell each
+ * warrior executes, reads, writes, increments and decrements, its splits and
+ * the processes that die), so that a battle can be replayed and picked apart
+ * afterwards without a display.  pmars has to be built with -DTRACE.
+ *
+ *   trace_header
+ *   header.warriors times: trace_warrior, the name (nameLen bytes, no NUL),
+ *           trace_warrior.length battle_inst
+ *   the events
+ *
+ * The header fields are 32-bit ints in the byte order of the machine that
+ * wrote it (byteOrder).  The events are a byte stream.  Each event starts
+ * with a tag byte: the kind in its low 3 bits (TR_x), a small argument in
+ * the high 5 bits (TR_ARG).  Numbers that follow are varints: 7 bits per
+ * byte, low bits first, the high bit set on all but the last byte.
+ *
+ * An address event (EXEC READ WRITE DEC INC) holds the distance of its cell
+ * from a base, folded into -coreSize/2 .. coreSize/2 and zigzag coded
+ * (0 -1 1 -2 2 ... are 0 1 2 3 4 ...).  If that is below TR_BIG it is the
+ * argument, otherwise the argument is TR_BIG and a varint holds it.  The base
+ * of an EXEC is the cell the same warrior executed last (its start cell at
+ * the beginning of a round), so that straight-line code costs one byte per
+ * cycle; the base of the others is the cell being executed in that cycle.
+ *
+ * Every cycle starts with the EXEC of the instruction fetched, the cells it
+ * reads and writes follow.  Whose turn a cycle is is not recorded: the
+ * warriors take turns in order, skipping the dead, starting with the one
+ * TRM_ROUND names.  A TRM_WARRIOR mark says otherwise for the next cycle
+ * (pmars never needs one, the reader has to handle it anyway).
+ *
+ * TR_SPL: the warrior executing got a process (it has one more now)
+ * TR_DAT: the process executing died (DAT, or a division by zero)
+ * TR_MARK with the argument saying which:
+ *   TRM_DIE     the warrior executing has no processes left
+ *   TRM_WARRIOR varint warrior: that one executes next
+ *   TRM_ROUND   varints round, starter, then the position of each warrior
+ *   TRM_END     varint warriors left: the round is over
+ *   TRM_STOP    end of the trace
+ *
+ * The C++ side includes this too.
+ */
+
+#ifndef TRACE_INCLUDED
+#define TRACE_INCLUDED
+
+#include "battle.h"
+
+#define TRACE_MAGIC     0x31435254        /* "TRC1" */
+#define TRACE_VERSION   1
+
+/* event kinds, the low bits of the tag */
+#define TR_EXEC         0
+#define TR_READ         1
+#define TR_WRITE        2
+#define TR_DEC          3
+#define TR_INC          4
+#define TR_SPL          5
+#define TR_DAT          6
+#define TR_MARK         7
+
+#define TR_KIND(tag)    ((tag) & 7)
+#define TR_ARG(tag)     ((tag) >> 3)
+#define TR_TAG(kind,arg) ((unsigned char) ((kind) | (arg) << 3))
+#define TR_BIG          31                /* the distance is in a varint */
+
+/* TR_MARK arguments */
+#define TRM_DIE         0
+#define TRM_WARRIOR     1
+#define TRM_ROUND       2
+#define TRM_END         3
+#define TRM_STOP        4
+
+typedef struct trace_header {
+  int     magic;                        /* TRACE_MAGIC */
+  int     version;                        /* TRACE_VERSION */
+  int     byteOrder;                /* BATTLE_BYTEORDER */
+  int     coreSize;
+  int     cycles;                        /* per warrior, as pmars -c */
+  int     processes;
+  int     warriors;
+  int     rounds;                        /* of the battle; the trace may hold
+                                 * fewer, it ends with TRM_STOP */
+}       trace_header;
+
+typedef struct trace_warrior {
+  int     length;                        /* battle_inst */
+  int     offset;                        /* start offset (ORG/END) */
+  int     nameLen;
+}       trace_warrior;
+
+#endif                                /* TRACE_INCLUDED */
@@ -0,0 +1,467 @@
+/*
+ * worker.c: pmars_worker, a pmars that stays up and takes requests
+ *
+ * pmars_worker reads requests (battle.h) from standard input and writes the
+ * replies to standard output, until it gets BATTLE_QUIT or end of file.  It
+ * is started by the GA, one per core, so that warriors are assembled and
+ * battles are run without starting a pmars for each match, while a crash in
+ * the simulator still only takes down the worker (the GA starts a new one).
+ *
+ * Standard input and output may be the same Unix domain socket.  Anything
+ * else that would be printed on standard output is thrown away (the replies
+ * carry the status); assembler messages still go to standard error.
+ *
+ * Built with -DTRACE, it traces battles (trace.h) when PMARS_TRACE names a
+ * directory: one battle in PMARS_TRACE_SAMPLE (1: all of them), the first
+ * PMARS_TRACE_ROUNDS rounds of it (1 unless set, 0: all), into
+ * PMARS_TRACE/<pid>-<battle>.trc.
+ *
+ * Built with -DMELEE, it runs the rounds of a battle of more than two
+ * warriors on PMARS_THREADS threads (1 unless set; pmars -j).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "global.h"
+#include "battle.h"
+#include "assemble.h"
+
+extern void init(void);
+extern void pspace_init(void);
+extern SIM_LOCAL unsigned long simInstructions;
+
+static int replyfd;                /* standard output, before we muted it */
+
+#if defined(TRACE) || defined(MELEE)
+static long
+envnum(const char *name, long def, long min)
+{
+  char   *s = getenv(name), *end;
+  long    v;
+
+  if (s == NULL || *s == 0)
+    return def;
+  v = strtol(s, &end, 10);
+  return *end || v < min ? def : v;
+}
+#endif
+
+#ifdef TRACE
+static char *traceDir;                /* PMARS_TRACE */
+static long traceSample = 1, traceRounds = 1;
+static long battlesRun;
+
+static void
+trace_setup(void)
+{
+  traceDir = getenv("PMARS_TRACE");
+  if (traceDir != NULL && *traceDir == 0)
+    traceDir = NULL;
+  traceSample = envnum("PMARS_TRACE_SAMPLE", 1, 1);
+  traceRounds = envnum("PMARS_TRACE_ROUNDS", 1, 0);
+}
+
+/* starts tracing the battle about to run if it is one of the sample */
+static void
+trace_start(void)
+{
+  char    name[1024];
+
+  if (traceDir == NULL || battlesRun++ % traceSample)
+    return;
+  sprintf(name, "%.900s/%ld-%ld.trc", traceDir, (long) getpid(), battlesRun);
+  if (trace_open(name, (int) traceRounds))
+    fprintf(stderr, "pmars_worker: cannot write trace %s\n", name);
+}
+#endif
+
+/* read or write exactly n bytes; 0 on success */
+static int
+readall(int fd, void *buf, size_t n)
+{
+  char   *p = (char *) buf;
+  ssize_t got;
+
+  while (n > 0) {
+    got = read(fd, p, n);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got <= 0)
+      return -1;
+    p += got;
+    n -= (size_t) got;
+  }
+  return 0;
+}
+
+static int
+writeall(int fd, const void *buf, size_t n)
+{
+  const char *p = (const char *) buf;
+  ssize_t put;
+
+  while (n > 0) {
+    put = write(fd, p, n);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      return -1;
+    p += put;
+    n -= (size_t) put;
+  }
+  return 0;
+}
+
+/* header and payload of a reply go out in one write */
+static int
+reply(int type, int id, const void *payload, int size)
+{
+  battle_header *h;
+  int     status;
+
+  if ((h = (battle_header *) MALLOC(sizeof(battle_header) + size)) == NULL)
+    return -1;
+  h->magic = BATTLE_MAGIC;
+  h->type = type;
+  h->id = id;
+  h->size = size;
+  if (size > 0)
+    memcpy(h + 1, payload, (size_t) size);
+  status = writeall(replyfd, h, sizeof(battle_header) + size);
+  FREE(h);
+  return status;
+}
+
+/* check the parameters and set the pmars globals the way clparse.c would */
+static int
+set_params(const battle_params * p, int nwarriors)
+{
+  int     i;
+
+  if (p->coreSize < 1 || p->coreSize > MAXCORESIZE ||
+      p->maxLength < 1 || p->maxLength > MAXINSTR ||
+      p->minDistance < p->maxLength || p->minDistance > MAXSEPARATION ||
+      nwarriors < 1 || nwarriors > MAXWARRIOR ||
+      p->coreSize < nwarriors * p->minDistance ||
+      p->cycles < 1 || p->processes < 1 || p->rounds < 1 ||
+      p->seed < 1 || p->seed > (1 << 30))
+    return -1;
+
+  coreSize = (ADDR_T) p->coreSize;
+  cycles = p->cycles;
+  taskNum = p->processes;
+  instrLim = (ADDR_T) p->maxLength;
+  separation = (ADDR_T) p->minDistance;
+  rounds = p->rounds;
+  warriors = nwarriors;
+  SWITCH_Fnum = (ADDR_T) (p->seed + p->minDistance);        /* seed = F - d */
+#ifdef RWLIMIT
+  readLimit = writeLimit = coreSize;
+#endif
+#ifdef PSPACE
+  {
+    ADDR_T  size = 0;
+
+    for (i = 16; i > 0; --i)
+      if (!(coreSize % i)) {
+        size = coreSize / i;
+        break;
+      }
+    if (size != pSpaceSize) {                /* pspace_init() sizes them */
+      for (i = 0; i < MAXWARRIOR; ++i) {
+        FREE(pSpace[i]);
+        pSpace[i] = NULL;
+      }
+      pSpaceSize = size;
+    }
+  }
+#endif
+  errorcode = SUCCESS;
+  return 0;
+}
+
+/* assembled in memory; the messages still go to standard error */
+static void
+do_assemble(int id, char *payload, int size)
+{
+  battle_params p;
+  battle_code code;
+  battle_inst *inst;
+  assembled_warrior w;
+  diagnostics diag;
+
+  code.status = BATTLE_BADREQ;
+  code.offset = code.length = 0;
+  if (size < (int) sizeof(p)) {
+    reply(BATTLE_ASSEMBLE, id, &code, sizeof(code));
+    return;
+  }
+  memcpy(&p, payload, sizeof(p));
+  if (p.warriors <= 0)
+    p.warriors = 2;
+  if (set_params(&p, p.warriors)) {
+    reply(BATTLE_ASSEMBLE, id, &code, sizeof(code));
+    return;
+  }
+
+  code.status = assemble_buffer(payload + sizeof(p), (size_t) size - sizeof(p),
+                                &p, &w, &diag);
+  fputs(diag.text, stderr);
+  code.offset = w.offset;
+  code.length = w.length;
+
+  if ((inst = (battle_inst *) MALLOC(sizeof(code) +
+                                     w.length * sizeof(battle_inst))) == NULL)
+    Exit(MEMERR);
+  memcpy(inst, &code, sizeof(code));
+  if (w.length)
+    memcpy((char *) inst + sizeof(code), w.inst, w.length * sizeof(battle_inst));
+  reply(BATTLE_ASSEMBLE, id, inst, (int) (sizeof(code) + w.length * sizeof(battle_inst)));
+
+  FREE(inst);
+  free_assembled(&w);
+}
+
+#define fold(v) ((ADDR_T) ((((v) % coreSize) + coreSize) % coreSize))
+
+#ifdef PSPACE
+/*
+ * BATTLE_SESSION: puts the P-spaces that follow the warriors (at) into
+ * those pspace_init() made; where they end, or NULL if they don't fit the
+ * battle.
+ */
+static char *
+pspace_in(char *at, char *end)
+{
+  battle_pspace ps;
+  int     i, k, v;
+
+  for (i = 0; i < warriors; ++i) {
+    if (end - at < (long) sizeof(ps))
+      return NULL;
+    memcpy(&ps, at, sizeof(ps));
+    at += sizeof(ps);
+    if (ps.size == 0)
+      continue;                        /* the session starts */
+    if (ps.size != (int) pSpaceSize ||
+        end - at < (long) (ps.size * sizeof(int)))
+      return NULL;
+    warrior[i].lastResult = fold(ps.lastResult);
+    for (k = 0; k < ps.size; ++k) {
+      memcpy(&v, at, sizeof(v));
+      at += sizeof(v);
+      pSpace[i][k] = fold(v);
+    }
+  }
+  return at;
+}
+
+/* writes the P-spaces as the battle left them to at */
+static void
+pspace_out(char *at)
+{
+  battle_pspace ps;
+  int     i, k, v;
+
+  for (i = 0; i < warriors; ++i) {
+    ps.lastResult = warrior[i].lastResult;
+    ps.size = (int) pSpaceSize;
+    memcpy(at, &ps, sizeof(ps));
+    at += sizeof(ps);
+    for (k = 0; k < ps.size; ++k) {
+      v = pSpace[i][k];
+      memcpy(at, &v, sizeof(v));
+      at += sizeof(v);
+    }
+  }
+}
+#endif
+
+/*
+ * Copy the warriors in, run simulator1() and send back the score table;
+ * for BATTLE_SESSION the P-spaces go in and come back too.  Field values
+ * are folded into the core so that a bad client can't make the simulator
+ * read outside of it.
+ */
+static void
+do_run(int type, int id, char *payload, int size)
+{
+  battle_params p;
+  battle_result res;
+  battle_code code;
+  char   *at = payload + sizeof(p), *end = payload + size;
+  int     score[MAXWARRIOR * MAXWARRIOR];
+  int     i, j, n = 0, ok, nps = 0;
+
+  res.status = BATTLE_BADREQ;
+  res.warriors = res.rounds = 0;
+  res.instructions[0] = res.instructions[1] = 0;
+#ifndef PSPACE
+  if (type == BATTLE_SESSION)
+    size = 0;                        /* no P-space to carry */
+#endif
+  if (size < (int) sizeof(p)) {
+    reply(type, id, &res, sizeof(res));
+    return;
+  }
+  memcpy(&p, payload, sizeof(p));
+  if (set_params(&p, p.warriors)) {
+    reply(type, id, &res, sizeof(res));
+    return;
+  }
+
+  for (n = 0; n < warriors; ++n) {
+    if (end - at < (long) sizeof(code))
+      break;
+    memcpy(&code, at, sizeof(code));
+    at += sizeof(code);
+    if (code.length < 1 || code.length > instrLim ||
+        end - at < (long) (code.length * sizeof(battle_inst)))
+      break;
+    if ((warrior[n].instBank = (mem_struct *)
+         MALLOC(code.length * sizeof(mem_struct))) == NULL)
+      Exit(MEMERR);
+    for (i = 0; i < code.length; ++i) {
+      battle_inst b;
+      mem_struct *m = warrior[n].instBank + i;
+
+      memcpy(&b, at, sizeof(b));
+      at += sizeof(b);
+      m->A_value = fold(b.a_value);
+      m->B_value = fold(b.b_value);
+      m->opcode = b.opcode;
+      m->A_mode = b.a_mode;
+      m->B_mode = b.b_mode;
+      m->debuginfo = 0;
+    }
+    warrior[n].instLen = code.length;
+    warrior[n].offset = ((code.offset % code.length) + code.length) % code.length;
+    warrior[n].position = 0;
+    warrior[n].name = warrior[n].authorName = "";
+    warrior[n].pSpaceIndex = n;
+    for (j = 0; j < MAXWARRIOR * 2 - 1; ++j)
+      warrior[n].score[j] = 0;
+  }
+
+  ok = n == warriors;
+#ifdef PSPACE
+  if (ok) {
+    /* every battle starts with empty P-spaces, a session where it was */
+    pspace_init();
+    for (i = 0; i < warriors; ++i)
+      memset(pSpace[i], 0, pSpaceSize * sizeof(ADDR_T));
+    if (type == BATTLE_SESSION && (ok = pspace_in(at, end) != NULL))
+      nps = warriors * (int) (sizeof(battle_pspace) + pSpaceSize * sizeof(int));
+  }
+#endif
+  if (ok) {
+#ifdef TRACE
+    trace_start();
+#endif
+    simulator1();
+#ifdef TRACE
+    trace_close();
+#endif
+    res.status = BATTLE_OK;
+    res.warriors = warriors;
+    res.rounds = rounds;
+    res.instructions[0] = (unsigned int) (simInstructions & 0xffffffffUL);
+    res.instructions[1] = (unsigned int) (simInstructions >> 16 >> 16);
+    for (i = 0; i < warriors; ++i)
+      for (j = 0; j < warriors; ++j)
+        score[i * warriors + j] = warrior[i].score[j];
+  }
+
+  {
+    int     nscore = res.status == BATTLE_OK ? warriors * warriors : 0;
+    char   *buf;
+
+    if ((buf = (char *) MALLOC(sizeof(res) + sizeof(score) + nps)) == NULL)
+      Exit(MEMERR);
+    memcpy(buf, &res, sizeof(res));
+    memcpy(buf + sizeof(res), score, nscore * sizeof(int));
+#ifdef PSPACE
+    if (nps)
+      pspace_out(buf + sizeof(res) + nscore * sizeof(int));
+#endif
+    reply(type, id, buf, (int) (sizeof(res) + nscore * sizeof(int) + nps));
+    FREE(buf);
+  }
+
+  for (i = 0; i < n; ++i) {
+    FREE(warrior[i].instBank);
+    warrior[i].instBank = NULL;
+    warrior[i].instLen = 0;
+    warrior[i].name = warrior[i].authorName = NULL;
+  }
+}
+
+int
+main(int argc, char **argv)
+{
+  battle_header h;
+  char   *payload = NULL;
+  int     npayload = 0, devnull;
+
+  (void) argc;
+  (void) argv;
+
+  /* the GA handles ^C, we go away when our input is closed */
+  signal(SIGINT, SIG_IGN);
+
+  /* keep the reply stream, then mute everything else printed to stdout */
+  if ((replyfd = dup(1)) < 0)
+    return 1;
+  fflush(stdout);
+  if ((devnull = open("/dev/null", O_WRONLY)) >= 0) {
+    dup2(devnull, 1);
+    close(devnull);
+  }
+
+  init();
+#ifdef TRACE
+  trace_setup();
+#endif
+#ifdef MELEE
+  SWITCH_j = (int) envnum("PMARS_THREADS", 1, 1);
+  if (SWITCH_j > MAXTHREADS)
+    SWITCH_j = MAXTHREADS;
+#endif
+
+  while (readall(0, &h, sizeof(h)) == 0) {
+    if (h.magic != BATTLE_MAGIC || h.size < 0 || h.size > BATTLE_MAXPAYLOAD)
+      return 2;                        /* out of step with the client */
+    if (h.type == BATTLE_QUIT)
+      break;
+    if (h.size >= npayload) {
+      FREE(payload);
+      npayload = h.size + 1;
+      if ((payload = (char *) MALLOC(npayload)) == NULL)
+        Exit(MEMERR);
+    }
+    if (readall(0, payload, (size_t) h.size))
+      break;
+    switch (h.type) {
+    case BATTLE_ASSEMBLE:
+      do_assemble(h.id, payload, h.size);
+      break;
+    case BATTLE_RUN:
+    case BATTLE_SESSION:
+      do_run(h.type, h.id, payload, h.size);
+      break;
+    default:
+      {
+        int     status = BATTLE_BADREQ;
+
+        reply(h.type, h.id, &status, sizeof(status));
+      }
+    }
+  }
+  FREE(payload);
+  return 0;
+}
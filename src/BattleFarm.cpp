@@ -0,0 +1,338 @@
+#include "BattleFarm.h"
+#include "BattleNode.h"
+#include "BattleWire.h"
+#include "Config.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+constexpr std::chrono::seconds BattleFarm::GIVE_UP_AFTER;
+constexpr std::chrono::seconds BattleFarm::REPLY_TIMEOUT;
+
+BattleFarm::BattleFarm(const std::string& list, const std::string& program,
+                       unsigned workers)
+    : lastUp(std::chrono::steady_clock::now())
+{
+    std::vector<std::string> addresses;
+    if (list == "loopback") {
+        localPool = std::make_unique<WorkerPool>(program, workers);
+        localNode = std::make_unique<BattleNode>(*localPool, 0, "127.0.0.1");
+        localNode->start();
+        addresses.push_back("127.0.0.1:" + std::to_string(localNode->port()));
+    } else {
+        size_t at = 0;
+        while (at <= list.size()) {
+            size_t end = std::min(list.find(',', at), list.size());
+            if (end > at) addresses.push_back(list.substr(at, end - at));
+            at = end + 1;
+        }
+    }
+
+    for (const std::string& a : addresses) {
+        Node n;
+        size_t colon = a.rfind(':');
+        n.host = a.substr(0, colon);
+        n.port = colon == std::string::npos ? std::to_string(FARM_PORT)
+                                            : a.substr(colon + 1);
+        nodes.push_back(std::move(n));
+    }
+    if (nodes.empty())
+        std::cerr << "BattleFarm: no nodes in '" << list << "'\n";
+
+    std::lock_guard<std::mutex> guard(lock);
+    for (size_t i = 0; i < nodes.size(); ++i)
+        threads.emplace_back(&BattleFarm::connection, this, i);
+}
+
+BattleFarm::~BattleFarm()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        for (Node& n : nodes) {
+            for (int fd : n.fds) shutdown(fd, SHUT_RDWR);
+            for (Job* job : n.queue) {
+                job->done = true;
+                job->ok = false;
+            }
+            n.queue.clear();
+        }
+    }
+    work.notify_all();
+    doneCv.notify_all();
+
+    // connection threads may have started more of their kind; join them all
+    for (;;) {
+        std::thread t;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (threads.empty()) break;
+            t = std::move(threads.back());
+            threads.pop_back();
+        }
+        t.join();
+    }
+    localNode.reset();
+    localPool.reset();
+}
+
+unsigned BattleFarm::concurrency() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    unsigned n = 0;
+    for (const Node& node : nodes) n += static_cast<unsigned>(node.fds.size());
+    return std::max(1u, n);
+}
+
+// --------------------- Queues -------------------------------------------
+// A job goes to the shortest queue of a node that is up (any node if none
+// is), then we wait for a connection to carry it out.
+bool BattleFarm::submit(Job& job)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (stopping || nodes.empty()) return false;
+
+    Node* best = nullptr;
+    for (Node& n : nodes) {
+        if (n.refused) continue;
+        bool up = !n.fds.empty(), bestUp = best && !best->fds.empty();
+        if (!best || (up && !bestUp) ||
+            (up == bestUp && n.queue.size() < best->queue.size()))
+            best = &n;
+    }
+    if (!best) return false;
+    best->queue.push_back(&job);
+    work.notify_all();
+
+    doneCv.wait(guard, [&job] { return job.done; });
+    return job.ok;
+}
+
+void BattleFarm::finish(Job& job, bool ok)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        job.ok = ok;
+        job.done = true;
+    }
+    doneCv.notify_all();
+}
+
+// The next job for a connection to `node`: its own queue first, else the
+// tail of the longest other queue. nullptr once we are stopping.
+BattleFarm::Job* BattleFarm::take(size_t node)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        if (stopping) return nullptr;
+        Node& own = nodes[node];
+        if (!own.queue.empty()) {
+            Job* job = own.queue.front();
+            own.queue.pop_front();
+            return job;
+        }
+        Node* victim = nullptr;
+        for (Node& n : nodes)
+            if (!n.queue.empty() && (!victim || n.queue.size() > victim->queue.size()))
+                victim = &n;
+        if (victim) {
+            Job* job = victim->queue.back();
+            victim->queue.pop_back();
+            nSteals++;
+            return job;
+        }
+        work.wait(guard);
+    }
+}
+
+// --------------------- Connections --------------------------------------
+int BattleFarm::connectTo(size_t node)
+{
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(nodes[node].host.c_str(), nodes[node].port.c_str(), &hints, &res) != 0)
+        return -1;
+
+    // On Linux the send timeout also bounds connect(), so an address that
+    // doesn't answer at all doesn't hold the thread for minutes.
+    timeval connectTimeout{5, 0};
+    int fd = -1;
+    for (addrinfo* a = res; a && fd < 0; a = a->ai_next) {
+        fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+        if (fd < 0) continue;
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &connectTimeout, sizeof(connectTimeout));
+        if (connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    // A node that stops answering (machine gone, no FIN) shows up as a
+    // timeout, and its job is retried elsewhere.
+    int one = 1;
+    timeval tv{static_cast<time_t>(REPLY_TIMEOUT.count()), 0};
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+bool BattleFarm::exchange(int fd, int type, const std::vector<char>& payload,
+                          std::vector<char>& reply)
+{
+    int id = nextId++;
+    battle_header h;
+    return sendMessage(fd, type, id, payload) &&
+           recvMessage(fd, h, reply) && h.id == id && h.type == type;
+}
+
+// One connection to a node: connect, say hello, then carry out jobs until
+// the connection breaks (then connect again) or we stop.
+void BattleFarm::connection(size_t node)
+{
+    auto backoff = std::chrono::milliseconds(100);
+    for (;;) {
+        int fd = connectTo(node);
+        battle_hello hello{BATTLE_BADREQ, 0, 0};
+        std::vector<char> reply;
+        if (fd >= 0 && exchange(fd, BATTLE_HELLO, {}, reply) && reply.size() == sizeof(hello))
+            std::memcpy(&hello, reply.data(), sizeof(hello));
+
+        std::unique_lock<std::mutex> guard(lock);
+        Node& n = nodes[node];
+        if (hello.status == BATTLE_OK && hello.byteOrder != BATTLE_BYTEORDER) {
+            std::cerr << "BattleFarm: " << n.host << ":" << n.port
+                      << " has another byte order, not using it\n";
+            n.refused = true;
+        }
+        if (stopping || n.refused || hello.status != BATTLE_OK) {
+            if (fd >= 0) close(fd);
+            if (stopping || n.refused) return;
+
+            // Nobody reachable for too long: fail what is waiting, so the
+            // GA doesn't hang on a farm that is gone.
+            bool anyUp = false;
+            for (const Node& m : nodes) anyUp = anyUp || !m.fds.empty();
+            if (!anyUp && std::chrono::steady_clock::now() - lastUp > GIVE_UP_AFTER) {
+                for (Node& m : nodes) {
+                    for (Job* job : m.queue) job->done = true;
+                    m.queue.clear();
+                }
+                doneCv.notify_all();
+            }
+            work.wait_for(guard, backoff);
+            backoff = std::min(backoff*2, std::chrono::milliseconds(5000));
+            continue;
+        }
+
+        backoff = std::chrono::milliseconds(100);
+        if (n.fds.empty()) n.known.clear();   // it may have been restarted
+        n.fds.push_back(fd);
+        n.workers = std::max(1, hello.workers);
+        lastUp = std::chrono::steady_clock::now();
+        if (!n.spawned) {
+            n.spawned = true;
+            for (int i = 1; i < n.workers; ++i)
+                threads.emplace_back(&BattleFarm::connection, this, node);
+        }
+        guard.unlock();
+
+        while (Job* job = take(node)) {
+            if (perform(fd, node, *job)) {
+                finish(*job, true);
+                continue;
+            }
+            // The connection is broken: the job goes back to the front of
+            // this node's queue (another connection may steal it).
+            nRetries++;
+            guard.lock();
+            if (++job->attempts >= MAX_ATTEMPTS || stopping) {
+                job->done = true;
+                doneCv.notify_all();
+            } else {
+                nodes[node].queue.push_front(job);
+                work.notify_all();
+            }
+            guard.unlock();
+            break;
+        }
+
+        guard.lock();
+        Node& m = nodes[node];
+        m.fds.erase(std::find(m.fds.begin(), m.fds.end(), fd));
+        lastUp = std::chrono::steady_clock::now();
+        guard.unlock();
+        close(fd);
+    }
+}
+
+// Carries out a job on a connection. false means the connection is broken;
+// a job the node refused still counts as done (job.reply says why).
+bool BattleFarm::perform(int fd, size_t node, Job& job)
+{
+    if (job.type != BATTLE_RUN && job.type != BATTLE_SESSION)
+        return exchange(fd, job.type, job.payload, job.reply);
+
+    std::vector<char> payload = encodeRun(job.params, job.warriors, true, job.pspace);
+    for (int tries = 0; tries < 2; ++tries) {
+        for (size_t i = 0; i < job.warriors.size(); ++i) {
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (nodes[node].known.count(job.hashes[i])) continue;
+            }
+            std::vector<char> reply;
+            if (!exchange(fd, BATTLE_STORE, encodeStore(*job.warriors[i]), reply))
+                return false;
+            if (replyStatus(reply) == BATTLE_OK) {
+                std::lock_guard<std::mutex> guard(lock);
+                nodes[node].known.insert(job.hashes[i]);
+            }
+        }
+
+        if (!exchange(fd, job.type, payload, job.reply)) return false;
+        if (replyStatus(job.reply) != BATTLE_UNKNOWN) return true;
+
+        // The node dropped some of the code from its store: send it again.
+        std::lock_guard<std::mutex> guard(lock);
+        for (std::uint64_t h : job.hashes) nodes[node].known.erase(h);
+    }
+    return true;
+}
+
+// --------------------- Requests -----------------------------------------
+bool BattleFarm::assemble(const std::string& source, const battle_params& params,
+                          WarriorCode& code, int* status)
+{
+    Job job;
+    job.type = BATTLE_ASSEMBLE;
+    job.payload = encodeAssemble(source, params);
+    if (status) *status = BATTLE_BADREQ;
+    if (!submit(job)) return false;
+    return decodeCode(job.reply, code, status);
+}
+
+bool BattleFarm::run(const battle_params& params,
+                     const std::vector<const WarriorCode*>& warriors,
+                     BattleScores& scores, PspaceState* pspace)
+{
+    Job job;
+    job.type = pspace ? BATTLE_SESSION : BATTLE_RUN;
+    job.params = params;
+    job.warriors = warriors;
+    job.pspace = pspace;
+    for (const WarriorCode* w : warriors) job.hashes.push_back(codeHash(*w));
+    if (!submit(job)) return false;
+    return decodeScores(job.reply, static_cast<int>(warriors.size()), scores, pspace);
+}
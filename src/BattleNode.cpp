@@ -0,0 +1,188 @@
+#include "BattleNode.h"
+#include "BattleWire.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <utility>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+BattleNode::BattleNode(BattleBackend& backend, int port, const char* host)
+    : backend(backend)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (host && inet_pton(AF_INET, host, &addr.sin_addr) != 1) {
+        std::cerr << "BattleNode: bad address " << host << "\n";
+        return;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    socklen_t len = sizeof(addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(fd, 64) != 0 ||
+        getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+        std::cerr << "BattleNode: cannot listen on port " << port << ": "
+                  << std::strerror(errno) << "\n";
+        close(fd);
+        return;
+    }
+    listenFd = fd;
+    boundPort = ntohs(addr.sin_port);
+}
+
+BattleNode::~BattleNode()
+{
+    stop();
+}
+
+void BattleNode::serve()
+{
+    while (listenFd >= 0) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            std::lock_guard<std::mutex> guard(lock);
+            if (stopping) break;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) {
+            close(fd);
+            break;
+        }
+        sessionFds.push_back(fd);
+        std::thread(&BattleNode::session, this, fd).detach();
+    }
+}
+
+void BattleNode::start()
+{
+    if (good() && !acceptor.joinable())
+        acceptor = std::thread(&BattleNode::serve, this);
+}
+
+// Wake up accept() and every session, then wait for the sessions to leave.
+void BattleNode::stop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    if (listenFd < 0 || stopping) return;
+    stopping = true;
+    shutdown(listenFd, SHUT_RDWR);
+    for (int fd : sessionFds) shutdown(fd, SHUT_RDWR);
+    finished.wait(guard, [this] { return sessionFds.empty(); });
+    guard.unlock();
+
+    if (acceptor.joinable()) acceptor.join();
+    close(listenFd);
+    listenFd = -1;
+}
+
+// --------------------- Code store ---------------------------------------
+bool BattleNode::store(std::uint64_t hash, WarriorCode code)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    if (codes.count(hash)) return true;
+    if (codes.size() >= STORE_SIZE) {
+        codes.erase(codeOrder.front());
+        codeOrder.pop_front();
+    }
+    codes.emplace(hash, std::move(code));
+    codeOrder.push_back(hash);
+    return true;
+}
+
+bool BattleNode::find(std::uint64_t hash, WarriorCode& code)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = codes.find(hash);
+    if (it == codes.end()) return false;
+    code = it->second;
+    return true;
+}
+
+// --------------------- Requests -----------------------------------------
+void BattleNode::session(int fd)
+{
+    battle_header h;
+    std::vector<char> payload, reply;
+
+    while (recvMessage(fd, h, payload)) {
+        if (h.type == BATTLE_QUIT) break;
+
+        int status = BATTLE_BADREQ;
+        switch (h.type) {
+        case BATTLE_HELLO: {
+            battle_hello hello{BATTLE_OK, BATTLE_BYTEORDER,
+                               static_cast<int>(backend.concurrency())};
+            reply.clear();
+            append(reply, &hello);
+            break;
+        }
+        case BATTLE_ASSEMBLE: {
+            WarriorCode code;
+            battle_params params;
+            if (payload.size() >= sizeof(params)) {
+                std::memcpy(&params, payload.data(), sizeof(params));
+                std::string source(payload.begin() + sizeof(params), payload.end());
+                if (backend.assemble(source, params, code, &status)) status = BATTLE_OK;
+            }
+            reply = encodeCode(status, code);
+            break;
+        }
+        case BATTLE_STORE: {
+            std::uint64_t hash;
+            WarriorCode code;
+            if (decodeStore(payload, hash, code) && store(hash, std::move(code)))
+                status = BATTLE_OK;
+            reply.clear();
+            append(reply, &status);
+            break;
+        }
+        case BATTLE_RUN:
+        case BATTLE_SESSION: {
+            battle_params params;
+            std::vector<WarriorCode> warriors;
+            BattleScores scores;
+            PspaceState state, *pspace = h.type == BATTLE_SESSION ? &state : nullptr;
+            status = decodeRun(payload, params, warriors,
+                               [this](std::uint64_t hash, WarriorCode& code) {
+                                   return find(hash, code);
+                               }, pspace);
+            if (status == BATTLE_OK) {
+                std::vector<const WarriorCode*> ptrs;
+                for (const WarriorCode& w : warriors) ptrs.push_back(&w);
+                if (!backend.run(params, ptrs, scores, pspace)) status = BATTLE_BADREQ;
+            }
+            reply = encodeScores(status, scores, pspace);
+            break;
+        }
+        default:
+            reply.clear();
+            append(reply, &status);
+        }
+        if (!sendMessage(fd, h.type, h.id, reply)) break;
+    }
+
+    // Off the list before the fd is closed, so stop() can't shut down a
+    // number that has been reused.
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        sessionFds.erase(std::find(sessionFds.begin(), sessionFds.end(), fd));
+        finished.notify_all();
+    }
+    close(fd);
+}
@@ -0,0 +1,104 @@
+#include "BattleScheduler.h"
+
+#include <algorithm>
+#include <utility>
+
+BattleScheduler::BattleScheduler(unsigned n)
+    : started(std::chrono::steady_clock::now())
+{
+    grow(std::max(1u, n));
+}
+
+// A new runner starts with an empty queue, so it steals until the next
+// submit deals it jobs of its own.
+void BattleScheduler::grow(unsigned n)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    while (runners.size() < n) {
+        runners.emplace_back();
+        threads.emplace_back(&BattleScheduler::run, this, runners.size() - 1);
+    }
+}
+
+// Jobs still queued are dropped; the ones running are finished.
+BattleScheduler::~BattleScheduler()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work.notify_all();
+    for (std::thread& t : threads) t.join();
+}
+
+// --------------------- Queues -------------------------------------------
+void BattleScheduler::submit(std::vector<Job> jobs)
+{
+    std::stable_sort(jobs.begin(), jobs.end(),
+                     [](const Job& a, const Job& b) { return a.cost > b.cost; });
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (Job& job : jobs) {
+            Runner* least = &runners[0];
+            for (Runner& r : runners)
+                if (r.queued < least->queued) least = &r;
+            least->queued += job.cost;
+            // a queue stays longest first when jobs of several submits mix
+            auto at = std::find_if(least->queue.begin(), least->queue.end(),
+                                   [&](const Job& q) { return q.cost < job.cost; });
+            least->queue.insert(at, std::move(job));
+        }
+    }
+    work.notify_all();
+}
+
+bool BattleScheduler::take(size_t runner, Job& job)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    for (;;) {
+        if (stopping) return false;
+        Runner* from = &runners[runner];
+        if (from->queue.empty()) {
+            from = nullptr;
+            for (Runner& r : runners)
+                if (!r.queue.empty() && (!from || r.queued > from->queued)) from = &r;
+        }
+        if (from) {
+            job = std::move(from->queue.front());
+            from->queue.pop_front();
+            from->queued = from->queue.empty() ? 0 : std::max(0.0, from->queued - job.cost);
+            if (from != &runners[runner]) runners[runner].stats.stolen++;
+            return true;
+        }
+        work.wait(guard);
+    }
+}
+
+void BattleScheduler::run(size_t runner)
+{
+    Job job;
+    while (take(runner, job)) {
+        auto start = std::chrono::steady_clock::now();
+        job.run();
+        double busy = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        job = Job();
+
+        std::lock_guard<std::mutex> guard(lock);
+        runners[runner].stats.busy += busy;
+        runners[runner].stats.jobs++;
+    }
+}
+
+// --------------------- Statistics ---------------------------------------
+std::vector<BattleScheduler::RunnerStats> BattleScheduler::stats() const
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<RunnerStats> s;
+    for (const Runner& r : runners) s.push_back(r.stats);
+    return s;
+}
+
+double BattleScheduler::seconds() const
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
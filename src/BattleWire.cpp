@@ -0,0 +1,322 @@
+#include "BattleWire.h"
+#include "Config.h"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <sys/socket.h>
+
+battle_params defaultBattleParams()
+{
+    battle_params p;
+    p.coreSize = CORESIZE;
+    p.cycles = 80000;
+    p.processes = 8000;
+    p.maxLength = 100;
+    p.minDistance = MIN_SEPARATION;
+    p.rounds = 1;
+    p.seed = 1;
+    p.warriors = 2;
+    return p;
+}
+
+// A copy of the P-spaces goes out, so a run that fails doesn't touch them.
+bool BattleSession::run(const battle_params& params, BattleScores& scores)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    PspaceState next = pspace;
+    if (!backend.run(params, warriors, scores, &next)) return false;
+    pspace = std::move(next);
+    return true;
+}
+
+// --------------------- Socket I/O ---------------------------------------
+bool sendAll(int fd, const void* buf, size_t n)
+{
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t put = send(fd, p, n, MSG_NOSIGNAL);   // no SIGPIPE if it died
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+        p += put;
+        n -= static_cast<size_t>(put);
+    }
+    return true;
+}
+
+bool recvAll(int fd, void* buf, size_t n)
+{
+    char* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t got = recv(fd, p, n, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+        p += got;
+        n -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+// Header and payload go out in one send.
+bool sendMessage(int fd, int type, int id, const std::vector<char>& payload)
+{
+    battle_header h{BATTLE_MAGIC, type, id, static_cast<int>(payload.size())};
+    std::vector<char> msg;
+    msg.reserve(sizeof(h) + payload.size());
+    append(msg, &h);
+    msg.insert(msg.end(), payload.begin(), payload.end());
+    return sendAll(fd, msg.data(), msg.size());
+}
+
+bool recvMessage(int fd, battle_header& h, std::vector<char>& payload)
+{
+    if (!recvAll(fd, &h, sizeof(h))) return false;
+    if (h.magic != BATTLE_MAGIC || h.size < 0 || h.size > BATTLE_MAXPAYLOAD)
+        return false;
+    payload.resize(h.size);
+    return h.size == 0 || recvAll(fd, payload.data(), payload.size());
+}
+
+// --------------------- Payloads -----------------------------------------
+std::uint64_t codeHash(const WarriorCode& code)
+{
+    std::uint64_t h = 14695981039346656037ULL;
+    auto mix = [&h](const void* data, size_t n) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            h ^= p[i];
+            h *= 1099511628211ULL;
+        }
+    };
+    mix(&code.offset, sizeof(code.offset));
+    for (const battle_inst& in : code.inst) {
+        mix(&in.a_value, sizeof(in.a_value));
+        mix(&in.b_value, sizeof(in.b_value));
+        mix(&in.opcode, 1);
+        mix(&in.a_mode, 1);
+        mix(&in.b_mode, 1);
+    }
+    return h;
+}
+
+static battle_ref toRef(std::uint64_t hash)
+{
+    battle_ref r;
+    r.hash[0] = static_cast<unsigned int>(hash & 0xffffffffULL);
+    r.hash[1] = static_cast<unsigned int>(hash >> 32);
+    return r;
+}
+
+static std::uint64_t fromRef(const battle_ref& r)
+{
+    return static_cast<std::uint64_t>(r.hash[0]) |
+           (static_cast<std::uint64_t>(r.hash[1]) << 32);
+}
+
+std::vector<char> encodeAssemble(const std::string& source, const battle_params& params)
+{
+    std::vector<char> payload(sizeof(params) + source.size());
+    size_t at = 0;
+    place(payload, at, &params);
+    place(payload, at, source.data(), source.size());
+    return payload;
+}
+
+std::vector<char> encodeCode(int status, const WarriorCode& code)
+{
+    battle_code c{status, code.offset, static_cast<int>(code.inst.size())};
+    std::vector<char> payload(sizeof(c) + code.inst.size()*sizeof(battle_inst));
+    size_t at = 0;
+    place(payload, at, &c);
+    place(payload, at, code.inst.data(), code.inst.size());
+    return payload;
+}
+
+// Reads a battle_code and its instructions at `at`, moves `at` past them.
+static bool takeCode(const std::vector<char>& payload, size_t& at,
+                     battle_code& c, WarriorCode& code)
+{
+    if (payload.size() - at < sizeof(c)) return false;
+    std::memcpy(&c, payload.data() + at, sizeof(c));
+    at += sizeof(c);
+    if (c.length == BATTLE_BYREF) return true;
+    if (c.length < 0 || (payload.size() - at) / sizeof(battle_inst) < size_t(c.length))
+        return false;
+    code.offset = c.offset;
+    code.inst.resize(c.length);
+    if (c.length > 0)
+        std::memcpy(code.inst.data(), payload.data() + at, c.length*sizeof(battle_inst));
+    at += c.length*sizeof(battle_inst);
+    return true;
+}
+
+bool decodeCode(const std::vector<char>& payload, WarriorCode& code, int* status)
+{
+    battle_code c;
+    size_t at = 0;
+    if (status) *status = BATTLE_BADREQ;
+    if (!takeCode(payload, at, c, code) || c.length == BATTLE_BYREF) return false;
+    if (status) *status = c.status;
+    return c.status == BATTLE_OK && at == payload.size();
+}
+
+// A battle_pspace and the cells for each warrior; size 0 for all of them
+// when the session starts.
+static void appendPspace(std::vector<char>& payload, const PspaceState& pspace,
+                         int warriors)
+{
+    for (int i = 0; i < warriors; ++i) {
+        battle_pspace b{0, 0};
+        if (pspace.size > 0) b = battle_pspace{pspace.lastResult[i], pspace.size};
+        append(payload, &b);
+        if (b.size > 0) append(payload, pspace.cells.data() + size_t(i)*b.size, b.size);
+    }
+}
+
+static bool takePspace(const std::vector<char>& payload, size_t& at, int warriors,
+                       PspaceState& pspace)
+{
+    pspace = PspaceState();
+    for (int i = 0; i < warriors; ++i) {
+        battle_pspace b;
+        if (payload.size() - at < sizeof(b)) return false;
+        std::memcpy(&b, payload.data() + at, sizeof(b));
+        at += sizeof(b);
+        if (b.size < 0 || (i > 0 && b.size != pspace.size) ||
+            (payload.size() - at) / sizeof(int) < size_t(b.size))
+            return false;
+        pspace.size = b.size;
+        pspace.lastResult.push_back(b.lastResult);
+        pspace.cells.resize(pspace.cells.size() + b.size);
+        if (b.size > 0)
+            std::memcpy(pspace.cells.data() + size_t(i)*b.size, payload.data() + at,
+                        b.size*sizeof(int));
+        at += b.size*sizeof(int);
+    }
+    if (pspace.size == 0) pspace = PspaceState();
+    return true;
+}
+
+std::vector<char> encodeRun(const battle_params& params,
+                            const std::vector<const WarriorCode*>& warriors,
+                            bool byRef, const PspaceState* pspace)
+{
+    battle_params p = params;
+    p.warriors = static_cast<int>(warriors.size());
+
+    std::vector<char> payload;
+    append(payload, &p);
+    for (const WarriorCode* code : warriors) {
+        if (byRef) {
+            battle_code c{BATTLE_OK, code->offset, BATTLE_BYREF};
+            battle_ref r = toRef(codeHash(*code));
+            append(payload, &c);
+            append(payload, &r);
+        } else {
+            std::vector<char> c = encodeCode(BATTLE_OK, *code);
+            payload.insert(payload.end(), c.begin(), c.end());
+        }
+    }
+    if (pspace) appendPspace(payload, *pspace, p.warriors);
+    return payload;
+}
+
+int decodeRun(const std::vector<char>& payload, battle_params& params,
+              std::vector<WarriorCode>& warriors,
+              const std::function<bool(std::uint64_t, WarriorCode&)>& find,
+              PspaceState* pspace)
+{
+    if (payload.size() < sizeof(params)) return BATTLE_BADREQ;
+    std::memcpy(&params, payload.data(), sizeof(params));
+    if (params.warriors < 1 || params.warriors > BATTLE_MAXWARRIORS) return BATTLE_BADREQ;
+
+    size_t at = sizeof(params);
+    warriors.assign(params.warriors, WarriorCode());
+    for (WarriorCode& code : warriors) {
+        battle_code c;
+        if (!takeCode(payload, at, c, code)) return BATTLE_BADREQ;
+        if (c.length != BATTLE_BYREF) continue;
+
+        battle_ref r;
+        if (payload.size() - at < sizeof(r)) return BATTLE_BADREQ;
+        std::memcpy(&r, payload.data() + at, sizeof(r));
+        at += sizeof(r);
+        if (!find(fromRef(r), code)) return BATTLE_UNKNOWN;
+    }
+    if (pspace && !takePspace(payload, at, params.warriors, *pspace)) return BATTLE_BADREQ;
+    return at == payload.size() ? BATTLE_OK : BATTLE_BADREQ;
+}
+
+std::vector<char> encodeScores(int status, const BattleScores& scores,
+                               const PspaceState* pspace)
+{
+    battle_result r{status, 0, 0, {0, 0}};
+    if (status == BATTLE_OK) {
+        r.warriors = scores.warriors;
+        r.rounds = scores.rounds;
+        r.instructions[0] = static_cast<unsigned>(scores.instructions);
+        r.instructions[1] = static_cast<unsigned>(scores.instructions >> 32);
+    }
+    const size_t n = status == BATTLE_OK ? scores.score.size() : 0;
+    std::vector<char> payload(sizeof(r) + n*sizeof(int));
+    size_t at = 0;
+    place(payload, at, &r);
+    place(payload, at, scores.score.data(), n);
+    if (status == BATTLE_OK && pspace) appendPspace(payload, *pspace, scores.warriors);
+    return payload;
+}
+
+bool decodeScores(const std::vector<char>& payload, int warriors, BattleScores& scores,
+                  PspaceState* pspace)
+{
+    battle_result r;
+    if (payload.size() < sizeof(r)) return false;
+    std::memcpy(&r, payload.data(), sizeof(r));
+    size_t at = sizeof(r) + size_t(warriors*warriors)*sizeof(int);
+    if (r.status != BATTLE_OK || r.warriors != warriors || payload.size() < at)
+        return false;
+    PspaceState after;
+    if (pspace && !takePspace(payload, at, warriors, after)) return false;
+    if (at != payload.size()) return false;
+    if (pspace) *pspace = std::move(after);
+
+    scores.warriors = r.warriors;
+    scores.rounds = r.rounds;
+    scores.instructions = r.instructions[0] | std::uint64_t(r.instructions[1]) << 32;
+    scores.score.resize(r.warriors*r.warriors);
+    std::memcpy(scores.score.data(), payload.data() + sizeof(r),
+                scores.score.size()*sizeof(int));
+    return true;
+}
+
+std::vector<char> encodeStore(const WarriorCode& code)
+{
+    battle_ref r = toRef(codeHash(code));
+    std::vector<char> c = encodeCode(BATTLE_OK, code);
+    std::vector<char> payload(sizeof(r) + c.size());
+    size_t at = 0;
+    place(payload, at, &r);
+    place(payload, at, c.data(), c.size());
+    return payload;
+}
+
+bool decodeStore(const std::vector<char>& payload, std::uint64_t& hash, WarriorCode& code)
+{
+    battle_ref r;
+    if (payload.size() < sizeof(r)) return false;
+    std::memcpy(&r, payload.data(), sizeof(r));
+    hash = fromRef(r);
+
+    battle_code c;
+    size_t at = sizeof(r);
+    return takeCode(payload, at, c, code) && c.length != BATTLE_BYREF &&
+           at == payload.size() && codeHash(code) == hash;
+}
+
+int replyStatus(const std::vector<char>& payload)
+{
+    int status = BATTLE_BADREQ;
+    if (payload.size() >= sizeof(status))
+        std::memcpy(&status, payload.data(), sizeof(status));
+    return status;
+}
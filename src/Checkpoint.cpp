@@ -0,0 +1,64 @@
+#include "Checkpoint.h"
+#include "Surrogate.h"
+#include <iostream>
+#include <utility>
+
+Checkpointer::Checkpointer(std::string filename)
+    : filename(std::move(filename))
+{
+}
+
+Checkpointer::~Checkpointer()
+{
+    wait();
+}
+
+bool Checkpointer::save(const GAGeneticAlgorithm& ga, std::int64_t evaluations,
+                        const Surrogate* surrogate)
+{
+    // The previous write must finish first, otherwise two writers would race
+    // for the same temp file.
+    bool ok = wait();
+
+    auto snapshot = std::make_shared<GASnapshot>();
+    if (ga.save(*snapshot) != 0) {
+        std::cerr << "Checkpoint: could not save the GA state\n";
+        return false;
+    }
+    snapshot->put(&evaluations, sizeof(evaluations));
+    snapshot->put(surrogate ? 1 : 0);
+    if (surrogate && surrogate->save(*snapshot) != 0) {
+        std::cerr << "Checkpoint: could not save the surrogate state\n";
+        return false;
+    }
+
+    writing = std::async(std::launch::async, [snapshot, file = filename]() {
+        return snapshot->write(file.c_str());
+    });
+    return ok;
+}
+
+bool Checkpointer::wait()
+{
+    if (!writing.valid()) return true;
+    return writing.get() == 0;
+}
+
+bool resumeCheckpoint(GAGeneticAlgorithm& ga, const std::string& filename,
+                      std::int64_t& evaluations, Surrogate* surrogate)
+{
+    GASnapshot snapshot;
+    if (snapshot.read(filename.c_str()) != 0 || ga.load(snapshot) != 0) return false;
+    evaluations = 0;
+    if (!snapshot.done()) {
+        snapshot.get(&evaluations, sizeof(evaluations));
+        if (!snapshot.good()) evaluations = 0;
+    }
+    // A run without a surrogate predicted nothing: the surrogate starts empty
+    if (!snapshot.done() && snapshot.getInt() != 0 && surrogate &&
+        surrogate->load(snapshot, ga.population().individual(0)) != 0) {
+        std::cerr << "Checkpoint: the surrogate state in " << filename << " is damaged\n";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,156 @@
+#include "CompiledWarrior.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include "rcb.h"
+
+// pmars_worker is built with -DEXT94: ICWS'94 plus the extensions
+static const int workerFlags = RCB_NEWOPCODES | RCB_NEWMODES | RCB_PSPACE | RCB_SHAREDPSPACE;
+
+static const char* const predefName[PREDEF_COUNT] = {
+    "CORESIZE", "MAXPROCESSES", "MAXCYCLES", "MAXLENGTH", "MINDISTANCE",
+    "VERSION", "WARRIORS", "ROUNDS", "READLIMIT", "WRITELIMIT", "PSPACESIZE"
+};
+
+std::uint64_t sourceHash(const std::string& source)
+{
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : source) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+std::string compiledName(const std::string& file)
+{
+    if (file.size() <= 4 || file.compare(file.size() - 4, 4, ".red") != 0) return "";
+    return file.substr(0, file.size() - 4) + ".rcb";
+}
+
+bool isCompiled(const std::string& file)
+{
+    return file.size() > 4 && file.compare(file.size() - 4, 4, ".rcb") == 0;
+}
+
+// The predefined constants as assemble_buffer sets them for params
+static void predefValues(const battle_params& params, int* v)
+{
+    v[PREDEF_CORESIZE] = params.coreSize;
+    v[PREDEF_MAXPROCESSES] = params.processes;
+    v[PREDEF_MAXCYCLES] = params.cycles;
+    v[PREDEF_MAXLENGTH] = params.maxLength;
+    v[PREDEF_MINDISTANCE] = params.minDistance;
+    v[PREDEF_VERSION] = 94;
+    v[PREDEF_WARRIORS] = params.warriors ? params.warriors : 2;
+    v[PREDEF_ROUNDS] = params.rounds;
+    v[PREDEF_READLIMIT] = params.coreSize;
+    v[PREDEF_WRITELIMIT] = params.coreSize;
+    v[PREDEF_PSPACESIZE] = 0;
+    for (int i = 16; i > 0 && !v[PREDEF_PSPACESIZE]; --i)
+        if (params.coreSize % i == 0) v[PREDEF_PSPACESIZE] = params.coreSize / i;
+}
+
+// The setting h doesn't fit, or nullptr
+static const char* misfit(const rcb_header& h, const battle_params& params)
+{
+    int now[PREDEF_COUNT];
+    predefValues(params, now);
+    if (h.predef[PREDEF_CORESIZE] != now[PREDEF_CORESIZE]) return predefName[PREDEF_CORESIZE];
+    if (h.length > now[PREDEF_MAXLENGTH]) return predefName[PREDEF_MAXLENGTH];
+    for (int i = 0; i < PREDEF_COUNT; ++i)
+        if ((h.predefsUsed & (1 << i)) && h.predef[i] != now[i]) return predefName[i];
+    return nullptr;
+}
+
+// Checks the mapped file and copies the code out of it; the reason in why
+static bool decode(const char* p, size_t size, const battle_params& params,
+                   WarriorCode& code, std::uint64_t& source, std::string& why)
+{
+    rcb_header h;
+    if (size < sizeof(h)) {
+        why = "not a compiled warrior";
+        return false;
+    }
+    std::memcpy(&h, p, sizeof(h));
+    if (h.magic != RCB_MAGIC) {
+        why = "not a compiled warrior";
+        return false;
+    }
+    if (h.version != RCB_VERSION || h.byteOrder != BATTLE_BYTEORDER ||
+        (h.flags & ~(RCB_88 | RCB_PIN)) != workerFlags ||
+        h.length < 1 || h.offset < 0 || h.offset >= h.length ||
+        h.strings < 4 || (h.strings & 3) ||
+        size != sizeof(h) + static_cast<size_t>(h.strings) +
+                static_cast<size_t>(h.length) * sizeof(battle_inst)) {
+        why = "not a compiled warrior pmars_worker can run";
+        return false;
+    }
+    if (const char* bad = misfit(h, params)) {
+        why = std::string("compiled for other settings (") + bad + ")";
+        return false;
+    }
+
+    const char* cells = p + sizeof(h) + h.strings;
+    code.offset = h.offset;
+    code.inst.resize(h.length);
+    std::memcpy(code.inst.data(), cells, h.length * sizeof(battle_inst));
+    source = static_cast<std::uint64_t>(h.source[1]) << 32 | h.source[0];
+    return true;
+}
+
+static bool load(const std::string& file, const battle_params& params,
+                 WarriorCode& code, std::uint64_t& source, std::string& why)
+{
+    int fd = open(file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        why = std::strerror(errno);
+        return false;
+    }
+    struct stat st;
+    void* p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        why = "cannot map it";
+        return false;
+    }
+    bool ok = decode(static_cast<const char*>(p), st.st_size, params, code, source, why);
+    munmap(p, st.st_size);
+    return ok;
+}
+
+bool loadCompiled(const std::string& file, const battle_params& params,
+                  WarriorCode& code, std::uint64_t* source)
+{
+    std::uint64_t hash;
+    std::string why;
+    if (!load(file, params, code, hash, why)) {
+        std::cerr << "Cannot load " << file << ": " << why << "\n";
+        return false;
+    }
+    if (source) *source = hash;
+    return true;
+}
+
+bool findCompiled(const std::string& file, const std::string& source,
+                  const battle_params& params, WarriorCode& code)
+{
+    std::string rcb = compiledName(file);
+    WarriorCode compiled;
+    std::uint64_t hash;
+    std::string why;
+    if (rcb.empty() || access(rcb.c_str(), R_OK) != 0 ||
+        !load(rcb, params, compiled, hash, why) || hash != sourceHash(source))
+        return false;
+    code = std::move(compiled);
+    return true;
+}
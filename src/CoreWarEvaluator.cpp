@@ -1,116 +1,606 @@
 #include "CoreWarEvaluator.h"
 #include "WarriorEncoder.h"
 #include "Config.h"
+#include "WorkerPool.h"
+#include "BattleFarm.h"
+#include "BattleScheduler.h"
+#include "BattleWire.h"
+#include "HallOfFame.h"
+#include "WarriorAnalysis.h"
+#include "RunConfig.h"
+#include "CompiledWarrior.h"
 
 #include <fstream>
+#include <sstream>
+#include <map>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <thread>
+#include <functional>
 #include <future>
 #include <string>
 #include <atomic>
+#include <random>
+#include <algorithm>
+#include <chrono>
 
-const std::string pmars = "../pmars-0.9.4/src/build/pmars";
 static std::atomic<std::int64_t> evalCounter{0};
+static std::atomic<std::int64_t> battleCounter{0}, roundCounter{0}, instructionCounter{0};
+static std::atomic<std::int64_t> failedCounter{0};
+static HallOfFame* hallOfFame = nullptr;
+static std::unique_ptr<const RunConfig> runConfig;
+
+void initEvaluator(const RunConfig& config)
+{
+    runConfig = std::make_unique<const RunConfig>(config);
+}
+
+// The run's configuration (the defaults if initEvaluator wasn't called)
+static const RunConfig& config()
+{
+    if (!runConfig) runConfig = std::make_unique<const RunConfig>();
+    return *runConfig;
+}
+
+// Where battles run: the local pmars_worker pool, or the farm when nodes
+// are configured. Started on first use.
+static BattleBackend& backend()
+{
+    static std::unique_ptr<BattleBackend> b = [] () -> std::unique_ptr<BattleBackend> {
+        const RunConfig& c = config();
+        if (!c.farmNodes.empty()) {
+            std::cout << "Evaluating on farm: " << c.farmNodes << "\n";
+            return std::make_unique<BattleFarm>(c.farmNodes, c.pmarsWorker, c.workers);
+        }
+        return std::make_unique<WorkerPool>(c.pmarsWorker, c.workers);
+    }();
+    return *b;
+}
+
+static std::atomic<BattleScheduler*> runnersStarted{nullptr};
+
+// The runners the battles of an evaluation go out on, one per battle the
+// backend can run at once. Started on first use; more are started when
+// the backend can run more.
+static BattleScheduler& scheduler()
+{
+    static BattleScheduler s(backend().concurrency());
+    s.grow(backend().concurrency());    // farm nodes may have come up since
+    runnersStarted = &s;
+    return s;
+}
+
+// --------------------- Cost of a battle ---------------------------------
+// Seconds per round against each opponent (by code hash), a moving average
+// over its battles so far. The time is measured: the simulator's
+// instruction count leaves out the cycles it skips, so it says little about
+// how long a battle takes. Against an opponent not seen yet a round is
+// taken to cost as much as against the slowest one seen.
+static constexpr double COST_WEIGHT = 0.2;    // of the latest battle
+
+static std::mutex costLock;
+static std::map<std::uint64_t, double> roundCost;
+
+static double expectedRoundCost(std::uint64_t opponent)
+{
+    std::lock_guard<std::mutex> guard(costLock);
+    auto it = roundCost.find(opponent);
+    if (it != roundCost.end()) return it->second;
+    double slowest = 0;
+    for (const auto& c : roundCost) slowest = std::max(slowest, c.second);
+    return slowest > 0 ? slowest : 1.0;
+}
+
+static void recordCost(std::uint64_t opponent, int rounds, double seconds)
+{
+    if (rounds <= 0) return;
+    double perRound = seconds / rounds;
+    std::lock_guard<std::mutex> guard(costLock);
+    auto it = roundCost.find(opponent);
+    if (it == roundCost.end()) roundCost.emplace(opponent, perRound);
+    else it->second += COST_WEIGHT * (perRound - it->second);
+}
+
+// --------------------- Assemble -----------------------------------------
+static bool assembleSource(const std::string& source, WarriorCode& code)
+{
+    int status;
+    return backend().assemble(source, config().battleParams(), code, &status);
+}
+
+// Opponents are assembled once, then reused for every match. A compiled
+// opponent (.rcb, or the .rcb next to a .red compiled from it) is loaded
+// instead of assembled.
+static const WarriorCode* opponentCode(const std::string& file)
+{
+    static std::mutex lock;
+    static std::map<std::string, std::unique_ptr<WarriorCode>> cache;
+
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = cache.find(file);
+    if (it != cache.end()) return it->second.get();
+
+    auto code = std::make_unique<WarriorCode>();
+    if (isCompiled(file)) {
+        if (!loadCompiled(file, config().battleParams(), *code)) code.reset();
+        return (cache[file] = std::move(code)).get();
+    }
+    std::ifstream in(file, std::ios::binary);
+    std::ostringstream source;
+    source << in.rdbuf();
+    if (!in || !(findCompiled(file, source.str(), config().battleParams(), *code) ||
+                 assembleSource(source.str(), *code))) {
+        std::cerr << "Cannot assemble opponent " << file << "\n";
+        code.reset();
+    }
+    return (cache[file] = std::move(code)).get();
+}
+
+static std::vector<const WarriorCode*> fixedOpponents()
+{
+    std::vector<const WarriorCode*> opponents;
+    for (const std::string& file : config().opponents)
+        if (const WarriorCode* code = opponentCode(file)) opponents.push_back(code);
+    return opponents;
+}
 
 // --------------------- Run a single match --------------------------------
-MatchResult runMatchUnique(const std::string& warriorFile,
-                           const std::string& opponent,
-                           int idx)
+// Plays `rounds` rounds on a pmars worker (local or on the farm). `seed` picks the start positions
+// (pmars -F seed+separation), so each batch against the same opponent gets
+// its own sequence of positions. In a session (a session of these two) the
+// rounds go on from the P-space the session's last match left. A match that
+// can't be played comes back failed, with no rounds: it is up to the caller
+// what that means (it is not a loss of the warrior).
+MatchResult runMatch(const WarriorCode& warrior, const WarriorCode& opponent,
+                     int rounds, int seed, BattleSession* session)
 {
     MatchResult r{0,0,0,0,0};
-    std::string gaFile  = "../tmp/ga_" + std::to_string(idx) + ".red";
-    std::string resultFile = "../tmp/result_" + std::to_string(idx) + ".txt";
-
-    // Copy genome file
-    {
-        std::ifstream src(warriorFile, std::ios::binary);
-        std::ofstream dst(gaFile, std::ios::binary);
-        dst << src.rdbuf();
-    }
-
-    std::string cmd = pmars + " -r " + std::to_string(ROUNDS) +
-                      " -s " + std::to_string(CORESIZE) +
-                      " -b " + gaFile + " " + opponent +
-                      " > " + resultFile + " 2>&1";
-                      //" 2>&1 | tee " + resultFile;  // <-- pipe to tee
-
-    //std::cout << cmd << "\n";
-
-
-    int ret = system(cmd.c_str());
-    if(ret!=0) { r.losses=1; return r; }
-
-    std::ifstream file(resultFile);
-    if(!file) { r.losses=1; return r; }
-
-    std::string line;
-    bool found=false;
-    while(std::getline(file,line)) {
-        if(line.find("Results:")!=std::string::npos) {
-            int first, second, third;
-            sscanf(line.c_str(), "Results: %d %d %d", &first,&second,&third);
-            r.wins = first;
-            r.losses = second;
-            r.ties = third;
-            found=true;
-            break;
-        }
+    battle_params params = config().battleParams();
+    params.rounds = rounds;
+    params.seed = seed;
+
+    BattleScores scores;
+    auto start = std::chrono::steady_clock::now();
+    if (!(session ? session->run(params, scores)
+                  : backend().run(params, {&warrior, &opponent}, scores))) {
+        failedCounter++;
+        r.failed = true;
+        return r;
     }
-    if(!found) r.losses=1;
+    battleCounter++;
+    roundCounter += scores.rounds;
+    instructionCounter += static_cast<std::int64_t>(scores.instructions);
+    recordCost(codeHash(opponent), scores.rounds,
+               std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    r.wins = scores.score[0];
+    r.ties = scores.score[1];
+    r.losses = scores.rounds - r.wins - r.ties;
     return r;
 }
 
+EvaluatorStats evaluatorStats()
+{
+    EvaluatorStats s;
+    s.evaluations = evalCounter;
+    s.battles = battleCounter;
+    s.rounds = roundCounter;
+    s.instructions = instructionCounter;
+    s.failedBattles = failedCounter;
+    if (BattleScheduler* runners = runnersStarted) {
+        for (const BattleScheduler::RunnerStats& r : runners->stats()) {
+            s.runnerBusy.push_back(r.busy);
+            s.runnerJobs.push_back(r.jobs);
+            s.runnerSteals.push_back(r.stolen);
+        }
+        s.runnerSeconds = runners->seconds();
+    }
+    return s;
+}
+
+void resumeEvaluations(std::int64_t evaluations)
+{
+    evalCounter = evaluations;
+}
+
+// --------------------- Adaptive round allocation ------------------------
+// Per-opponent tally. One round scores WIN_SCORE, TIE_SCORE or LOSS_SCORE.
+struct OpponentTally {
+    int wins = 0, ties = 0, losses = 0;
+
+    int rounds() const { return wins + ties + losses; }
+
+    bool failed = false;    // some of its battles couldn't be played
+
+    void add(const MatchResult& r) {
+        wins += r.wins; ties += r.ties; losses += r.losses;
+        failed = failed || r.failed;
+    }
+
+    float mean() const {
+        int n = rounds();
+        if (n == 0) return 0.0f;
+        return (WIN_SCORE*wins + TIE_SCORE*ties + LOSS_SCORE*losses) / n;
+    }
+
+    // Per-round variance. The outcome frequencies get half a pseudo-count
+    // each, so an opponent that tied every round so far still has a little
+    // variance (a few rounds can't prove it never loses) which shrinks as
+    // rounds are added.
+    float roundVariance() const {
+        float n = rounds() + 1.5f;
+        float pw = (wins + 0.5f) / n, pt = (ties + 0.5f) / n, pl = (losses + 0.5f) / n;
+        float m = WIN_SCORE*pw + TIE_SCORE*pt + LOSS_SCORE*pl;
+        return pw*(WIN_SCORE-m)*(WIN_SCORE-m)
+             + pt*(TIE_SCORE-m)*(TIE_SCORE-m)
+             + pl*(LOSS_SCORE-m)*(LOSS_SCORE-m);
+    }
+};
+
+// Fitness = mean - lambda*variance over the per-opponent means.
+static float penalizedFitness(const std::vector<float>& mu)
+{
+    float mean = 0.0f;
+    for (float m : mu) mean += m;
+    mean /= mu.size();
+    float variance = 0.0f;
+    for (float m : mu) variance += (m-mean)*(m-mean);
+    variance /= mu.size();
+    return mean - config().varianceLambda*variance;
+}
+
+// The mean is at least LOSS_SCORE and the variance of values between
+// LOSS_SCORE and WIN_SCORE at most a quarter of the range squared.
+float lowestFitness()
+{
+    const float range = WIN_SCORE - LOSS_SCORE;
+    return LOSS_SCORE - std::max(0.0f, config().varianceLambda) * range*range / 4;
+}
+
+// d fitness / d mu_i. The mean term contributes 1/k; the variance term
+// contributes -lambda * 2(mu_i - mean)/k (the mean's own shift sums to zero).
+static std::vector<float> fitnessGradient(const std::vector<float>& mu)
+{
+    float mean = 0.0f;
+    for (float m : mu) mean += m;
+    mean /= mu.size();
+    std::vector<float> g(mu.size());
+    for (size_t i = 0; i < mu.size(); ++i)
+        g[i] = (1.0f - 2.0f*config().varianceLambda*(mu[i]-mean)) / mu.size();
+    return g;
+}
+
+// Round up to whole batches without going over the cap.
+static int batchRounds(int wanted, int played)
+{
+    const int batch = config().roundBatch;
+    int n = ((wanted + batch - 1) / batch) * batch;
+    return std::max(0, std::min(n, config().maxRounds - played));
+}
+
+// A session for each opponent where either side uses P-space (nullptr for
+// the others): their rounds have to be played in order.
+static std::vector<std::unique_ptr<BattleSession>>
+pspaceSessions(const WarriorCode& warrior, const std::vector<const WarriorCode*>& opponents)
+{
+    std::vector<std::unique_ptr<BattleSession>> sessions(opponents.size());
+    const bool mine = usesPspace(warrior);
+    for (size_t i = 0; i < opponents.size(); ++i)
+        if (mine || usesPspace(*opponents[i]))
+            sessions[i] = std::make_unique<BattleSession>(
+                backend(), std::vector<const WarriorCode*>{&warrior, opponents[i]});
+    return sessions;
+}
+
+// The battles of one step of an evaluation: the jobs for the scheduler,
+// and their results as they come back, with the opponent they were against.
+struct Batches {
+    std::vector<BattleScheduler::Job> jobs;
+    std::vector<std::pair<size_t, std::future<MatchResult>>> results;
+
+    void add(size_t i, double cost, std::function<MatchResult()> battle) {
+        auto task = std::make_shared<std::packaged_task<MatchResult()>>(std::move(battle));
+        results.emplace_back(i, task->get_future());
+        jobs.push_back({cost, [task] { (*task)(); }});
+    }
+
+    // Plays them all (the longest expected first) and adds up the results.
+    void play(std::vector<OpponentTally>& tally) {
+        scheduler().submit(std::move(jobs));
+        jobs.clear();
+        for (auto& r : results)
+            tally[r.first].add(r.second.get());
+        results.clear();
+    }
+};
+
+// Queues `rounds` rounds against opponent i. They go out in batches of
+// round_batch, each with its own seed, so all workers have something to do;
+// in a session the batches of the opponent are played one after the other.
+static void queueRounds(Batches& batches, size_t i, const WarriorCode& warrior,
+                        const WarriorCode& opponent, int rounds,
+                        BattleSession* session, std::mt19937& rng)
+{
+    std::uniform_int_distribution<int> seed(1, 1 << 30);
+    const int batch = config().roundBatch;
+    const double perRound = expectedRoundCost(codeHash(opponent));
+
+    std::vector<std::pair<int, int>> plays;    // rounds, seed
+    for (int left = rounds; left > 0; left -= batch)
+        plays.emplace_back(std::min(left, batch), seed(rng));
+    if (!session) {
+        for (const auto& p : plays)
+            batches.add(i, perRound * p.first, [&warrior, &opponent, p] {
+                return runMatch(warrior, opponent, p.first, p.second);
+            });
+        return;
+    }
+    batches.add(i, perRound * rounds, [&warrior, &opponent, session, plays] {
+        MatchResult total{0,0,0,0,0};
+        for (const auto& p : plays) {
+            MatchResult r = runMatch(warrior, opponent, p.first, p.second, session);
+            total.wins += r.wins;
+            total.ties += r.ties;
+            total.losses += r.losses;
+            total.failed = r.failed;
+            if (r.failed) break;    // the P-space it would go on from is lost
+        }
+        return total;
+    });
+}
+
+// An evaluation with battles that couldn't be played has no fitness to
+// give. It says so and scores as a warrior that can't be judged (LOSS_SCORE,
+// like one that doesn't assemble); nothing of it is kept in the matrix.
+static bool battlesFailed(const std::vector<OpponentTally>& tally)
+{
+    int failed = 0;
+    for (const OpponentTally& t : tally) failed += t.failed;
+    if (!failed) return false;
+    std::cout << "Battles against " << failed << " opponent(s) could not be played"
+              << " => rawFitness=" << LOSS_SCORE << "\n";
+    return true;
+}
+
+// Plays the requested number of rounds against each opponent and adds the
+// results to the tallies.
+static void playRounds(const WarriorCode& warrior,
+                       const std::vector<const WarriorCode*>& opponents,
+                       const std::vector<int>& rounds,
+                       std::vector<OpponentTally>& tally,
+                       const std::vector<std::unique_ptr<BattleSession>>& sessions,
+                       std::mt19937& rng)
+{
+    Batches batches;
+    for (size_t i = 0; i < opponents.size(); ++i)
+        queueRounds(batches, i, warrior, *opponents[i], rounds[i], sessions[i].get(), rng);
+    batches.play(tally);
+}
+
+// --------------------- Hall of fame -------------------------------------
+void useHallOfFame(HallOfFame* hof)
+{
+    hallOfFame = hof;
+}
+
+// writeWarrior picks the addressing modes at random, so a genome gives
+// another warrior every time it is written. In co-evolution a genome keeps
+// the code it was first scored with (the last code_cache genomes), so
+// scoring it again after the hall of fame changed meets the same warrior
+// and reuses its results. When the last genome with a code leaves the
+// cache, that warrior can't be met again: its results leave the matrix
+// (unless it is a member).
+static bool genomeCode(const GA1DArrayGenome<int>& genome, WarriorCode& code)
+{
+    static std::map<std::uint64_t, WarriorCode> known;
+    static std::deque<std::uint64_t> order;
+    static std::map<std::uint64_t, int> genomesWith;    // code hash -> genomes
+
+    std::uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < genome.length(); ++i) {
+        h ^= static_cast<std::uint32_t>(genome.gene(i));
+        h *= 1099511628211ULL;
+    }
+    auto it = known.find(h);
+    if (it != known.end()) {
+        code = it->second;
+        return true;
+    }
+
+    std::ostringstream source;
+    writeWarrior(genome, source);
+    if (!assembleSource(source.str(), code)) return false;
+    if (known.size() >= static_cast<size_t>(std::max(1, config().codeCache))) {
+        auto old = known.find(order.front());
+        std::uint64_t oldCode = codeHash(old->second);
+        if (--genomesWith[oldCode] == 0) {
+            genomesWith.erase(oldCode);
+            if (hallOfFame && !hallOfFame->isMember(oldCode))
+                hallOfFame->results().forget(oldCode);
+        }
+        known.erase(old);
+        order.pop_front();
+    }
+    known.emplace(h, code);
+    order.push_back(h);
+    genomesWith[codeHash(code)]++;
+    return true;
+}
+
+bool addToHallOfFame(const GA1DArrayGenome<int>& genome)
+{
+    WarriorCode code;
+    if (!hallOfFame || !genomeCode(genome, code)) return false;
+
+    std::vector<int> genes(genome.length());
+    for (int i = 0; i < genome.length(); ++i) genes[i] = genome.gene(i);
+    return hallOfFame->add(std::move(genes), std::move(code));
+}
+
+// Co-evolution: hof_rounds rounds against each fixed opponent and each
+// member of the hall of fame. Pairs with a member that have met before (this
+// warrior, or one with the same code) take their result from the matrix;
+// only the others are played. The fixed opponents are played every time, so
+// the matrix only holds results that some later evaluation can use. A pair always gets the same start positions (seeded with both
+// code hashes), so a stored result is the one playing again would give.
+static float coevolutionFitness(const WarriorCode& warrior,
+                                std::vector<const WarriorCode*> opponents)
+{
+    const size_t fixed = opponents.size();
+    for (const HallOfFame::Member& m : hallOfFame->members())
+        opponents.push_back(&m.code);
+
+    ResultMatrix& matrix = hallOfFame->results();
+    const std::uint64_t me = codeHash(warrior);
+    const size_t k = opponents.size();
+    std::vector<OpponentTally> tally(k);
+    std::vector<std::uint64_t> hash(k);
+    const int rounds = config().hofRounds;
+    std::vector<std::unique_ptr<BattleSession>> sessions = pspaceSessions(warrior, opponents);
+
+    Batches batches;
+    int reused = 0;
+    for (size_t i = 0; i < k; ++i) {
+        hash[i] = codeHash(*opponents[i]);
+        PairResult r;
+        if (i >= fixed && matrix.find(me, hash[i], r) && r.rounds() == rounds) {
+            tally[i].add(MatchResult{0, 0, r.wins, r.ties, r.losses});
+            reused++;
+            continue;
+        }
+        std::mt19937 rng(static_cast<std::uint32_t>(me ^ (hash[i] >> 32) ^ hash[i]));
+        queueRounds(batches, i, warrior, *opponents[i], rounds, sessions[i].get(), rng);
+    }
+    batches.play(tally);
+    for (size_t i = fixed; i < k; ++i)
+        if (!tally[i].failed)
+            matrix.put(me, hash[i], PairResult{tally[i].wins, tally[i].ties, tally[i].losses});
+
+    if (battlesFailed(tally)) return LOSS_SCORE;
+
+    std::vector<float> mu(k);
+    for (size_t i = 0; i < k; ++i) mu[i] = tally[i].mean();
+    float rawFitness = penalizedFitness(mu);
+
+    std::cout << "Match scores (" << reused << " of " << k << " from the matrix): ";
+    for (float m : mu) std::cout << m << " ";
+    std::cout << "=> rawFitness=" << rawFitness << "\n";
+    return rawFitness;
+}
+
 // --------------------- Evaluate fitness ---------------------------------
+// A harmless warrior (isHarmless) never wins. Against an opponent that is
+// harmless too every round is a tie. Any other opponent may kill it, so it
+// gets the worst it could do there, LOSS_SCORE, rather than a score a
+// battle might not give it.
+static float harmlessFitness(std::vector<const WarriorCode*> opponents)
+{
+    if (hallOfFame)
+        for (const HallOfFame::Member& m : hallOfFame->members())
+            opponents.push_back(&m.code);
+
+    std::vector<float> mu;
+    for (const WarriorCode* o : opponents)
+        mu.push_back(isHarmless(classifyWarrior(*o, config().coreSize)) ? TIE_SCORE : LOSS_SCORE);
+    return penalizedFitness(mu);
+}
+
+// Every opponent gets min_rounds. Then, while the standard error of the
+// fitness is above target_se, more rounds are handed out in the spirit of
+// Neyman allocation: the fitness is a weighted sum of the per-opponent means
+// (to first order, weights g_i from fitnessGradient), so its variance is
+// sum g_i^2 s_i^2 / n_i and the cheapest way to reach the target is
+// n_i proportional to |g_i| s_i with N = (sum |g_i| s_i)^2 / target_se^2.
+// Opponents that always tie get few rounds; swingy ones get many.
+// Without racing (or with target_se 0) every opponent gets max_rounds.
 float evaluateFitness(const GA1DArrayGenome<int>& genome) {
     std::int64_t id = evalCounter++;
     std::cout << "\n\n------------\nEval " << id << "\n";
 
-    std::string warriorFile="../tmp/ga_temp.red";
-    writeWarrior(genome, warriorFile);
-
-    std::vector<std::string> opponents = {
-        "../warriors/dwarf.red",
-        "../warriors/Imp.red",
-        //"../warriors/stonescanner.red",
-        "../warriors/paper.red"
-    };
-
-    std::vector<std::future<MatchResult>> futures;
-    for(size_t i=0;i<opponents.size();++i)
-        futures.push_back(std::async(std::launch::async,
-                                     runMatchUnique,
-                                     warriorFile,
-                                     opponents[i],
-                                     (int)i));
-
-    float sum=0;
-    std::vector<float> scores;
-    for(auto& fut : futures) {
-        MatchResult r = fut.get();
-        //float f = 2.0*static_cast<float>(r.wins)/ROUNDS
-        //        + 0.5f*static_cast<float>(r.ties)/ROUNDS
-        //        - static_cast<float>(r.losses)/ROUNDS;
-        float f = 5.0f*static_cast<float>(r.wins)/ROUNDS
-                + 0.4f*static_cast<float>(r.ties)/ROUNDS
-                - 1.0f*static_cast<float>(r.losses)/ROUNDS;
-
-        scores.push_back(f);
-        sum += f;
-    }
-
-    float mean = sum / scores.size();
-    float variance = 0.0f;
-    for(float f : scores) variance += (f-mean)*(f-mean);
-    variance /= scores.size();
+    std::vector<const WarriorCode*> opponents = fixedOpponents();
+    if (opponents.empty()) return LOSS_SCORE;
+
+    WarriorCode warrior;
+    bool assembled;
+    if (hallOfFame) {
+        assembled = genomeCode(genome, warrior);
+    } else {
+        std::ostringstream source;
+        writeWarrior(genome, source);
+        assembled = assembleSource(source.str(), warrior);
+    }
+    if (!assembled) {
+        std::cout << "Warrior does not assemble => rawFitness=" << LOSS_SCORE << "\n";
+        return LOSS_SCORE;
+    }
+
+    // Warriors that provably can't win get their score without a battle
+    WarriorClass kind = classifyWarrior(warrior, config().coreSize);
+    if (kind != WarriorClass::Viable) {
+        float rawFitness = kind == WarriorClass::DiesImmediately ? LOSS_SCORE
+                                                                 : harmlessFitness(opponents);
+        std::cout << "Static analysis: " << warriorClassName(kind)
+                  << " => rawFitness=" << rawFitness << "\n";
+        return rawFitness;
+    }
+    if (hallOfFame) return coevolutionFitness(warrior, opponents);
+
+    // Start positions for the batches come from a generator seeded with the
+    // run's seed and the evaluation number (which a checkpoint keeps), so a
+    // seeded run can be repeated, resumed or not.
+    std::seed_seq seeds{config().seed, static_cast<std::uint32_t>(id),
+                        static_cast<std::uint32_t>(id >> 32)};
+    std::mt19937 rng(seeds);
+    const RunConfig& c = config();
+    const bool racing = c.racing && c.targetSE > 0.0f;
+    const size_t k = opponents.size();
+    std::vector<OpponentTally> tally(k);
+    std::vector<std::unique_ptr<BattleSession>> sessions = pspaceSessions(warrior, opponents);
 
-    float rawFitness = mean - VARIANCE_LAMBDA*variance;
+    const int first = racing ? std::min(c.minRounds, c.maxRounds) : c.maxRounds;
+    playRounds(warrior, opponents, std::vector<int>(k, first), tally, sessions, rng);
+
+    std::vector<float> mu(k);
+    float se = 0.0f;
+    for (;;) {
+        if (battlesFailed(tally)) return LOSS_SCORE;
+        for (size_t i = 0; i < k; ++i) mu[i] = tally[i].mean();
+        std::vector<float> g = fitnessGradient(mu);
+
+        float var = 0.0f, weight = 0.0f;
+        std::vector<float> w(k);
+        for (size_t i = 0; i < k; ++i) {
+            float s2 = tally[i].roundVariance();
+            var += g[i]*g[i]*s2 / tally[i].rounds();
+            w[i] = std::fabs(g[i]) * std::sqrt(s2);
+            weight += w[i];
+        }
+        se = std::sqrt(var);
+        if (!racing || se <= c.targetSE || weight <= 0.0f) break;
+
+        // Neyman targets for the total number of rounds needed
+        float total = weight*weight / (c.targetSE*c.targetSE);
+        std::vector<int> more(k, 0);
+        bool any = false;
+        for (size_t i = 0; i < k; ++i) {
+            int target = static_cast<int>(std::ceil(total * w[i] / weight));
+            more[i] = batchRounds(target - tally[i].rounds(), tally[i].rounds());
+            any = any || more[i] > 0;
+        }
+        if (!any) break;    // every opponent that needs rounds is at the cap
+        playRounds(warrior, opponents, more, tally, sessions, rng);
+    }
+
+    float rawFitness = penalizedFitness(mu);
 
     std::cout << "Match scores: ";
-    for(float f : scores) std::cout << f << " ";
-    std::cout << "=> rawFitness=" << rawFitness << "\n";
+    for (size_t i = 0; i < k; ++i)
+        std::cout << mu[i] << " (" << tally[i].rounds() << " rounds) ";
+    std::cout << "=> rawFitness=" << rawFitness << " se=" << se << "\n";
 
     return rawFitness;
 }
@@ -0,0 +1,270 @@
+#include "HallOfFame.h"
+#include "BattleWire.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <utility>
+
+// --------------------- Result matrix ------------------------------------
+bool ResultMatrix::find(std::uint64_t a, std::uint64_t b, PairResult& r) const
+{
+    auto ia = index.find(a), ib = index.find(b);
+    if (ia == index.end() || ib == index.end()) return false;
+    bool swapped = ia->second > ib->second;
+    auto it = swapped ? cells.find(key(ib->second, ia->second))
+                      : cells.find(key(ia->second, ib->second));
+    if (it == cells.end()) return false;
+    r.wins = swapped ? it->second.losses : it->second.wins;
+    r.ties = it->second.ties;
+    r.losses = swapped ? it->second.wins : it->second.losses;
+    return true;
+}
+
+std::uint32_t ResultMatrix::indexOf(std::uint64_t hash)
+{
+    auto it = index.find(hash);
+    if (it != index.end()) return it->second;
+    if (!unused.empty()) {
+        std::uint32_t i = unused.back();
+        unused.pop_back();
+        hashes[i] = hash;
+        return index[hash] = i;
+    }
+    hashes.push_back(hash);
+    return index[hash] = static_cast<std::uint32_t>(hashes.size() - 1);
+}
+
+void ResultMatrix::put(std::uint64_t a, std::uint64_t b, const PairResult& r)
+{
+    const int most = std::numeric_limits<std::uint16_t>::max();
+    std::uint32_t ia = indexOf(a), ib = indexOf(b);
+    Cell c{static_cast<std::uint16_t>(std::min(r.wins, most)),
+           static_cast<std::uint16_t>(std::min(r.ties, most)),
+           static_cast<std::uint16_t>(std::min(r.losses, most))};
+    if (ia > ib) {
+        std::swap(ia, ib);
+        std::swap(c.wins, c.losses);
+    }
+    cells[key(ia, ib)] = c;
+}
+
+// The index goes back to be used by the next new warrior, so the indices
+// stay as few as the warriors that are kept.
+void ResultMatrix::forget(std::uint64_t h)
+{
+    auto it = index.find(h);
+    if (it == index.end()) return;
+    std::uint32_t i = it->second;
+    for (auto c = cells.begin(); c != cells.end(); ) {
+        if (c->first >> 32 == i || (c->first & 0xffffffffu) == i) c = cells.erase(c);
+        else ++c;
+    }
+    index.erase(it);
+    unused.push_back(i);
+}
+
+void ResultMatrix::retain(const std::vector<std::uint64_t>& live)
+{
+    std::vector<std::uint64_t> gone;
+    for (const auto& w : index)
+        if (std::find(live.begin(), live.end(), w.first) == live.end()) gone.push_back(w.first);
+    for (std::uint64_t h : gone) forget(h);
+}
+
+template <class T>
+static void writeRaw(std::ostream& out, const T& x)
+{
+    out.write(reinterpret_cast<const char*>(&x), sizeof(x));
+}
+
+template <class T>
+static bool readRaw(std::istream& in, T& x)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char*>(&x), sizeof(x)));
+}
+
+// Warriors are numbered again (only those with results), so the file stays
+// small however many warriors came and went.
+bool ResultMatrix::write(std::ostream& out, const std::vector<std::uint64_t>& only) const
+{
+    std::vector<bool> wanted(hashes.size(), false);
+    for (std::uint64_t h : only) {
+        auto it = index.find(h);
+        if (it != index.end()) wanted[it->second] = true;
+    }
+    std::vector<std::pair<std::uint64_t, Cell>> kept;
+    for (const auto& c : cells)
+        if (wanted[c.first >> 32] && wanted[c.first & 0xffffffffu]) kept.push_back(c);
+
+    std::vector<std::uint32_t> renumber(hashes.size(), 0);
+    std::vector<std::uint64_t> used;
+    for (const auto& c : kept)
+        for (std::uint32_t i : {static_cast<std::uint32_t>(c.first >> 32),
+                                static_cast<std::uint32_t>(c.first & 0xffffffffu)})
+            if (!renumber[i]) {
+                used.push_back(hashes[i]);
+                renumber[i] = static_cast<std::uint32_t>(used.size());
+            }
+
+    writeRaw(out, static_cast<std::uint32_t>(used.size()));
+    for (std::uint64_t h : used) writeRaw(out, h);
+    writeRaw(out, static_cast<std::uint32_t>(kept.size()));
+    for (const auto& c : kept) {
+        // renumber holds index+1, 0 being "not used"
+        writeRaw(out, renumber[c.first >> 32] - 1);
+        writeRaw(out, renumber[c.first & 0xffffffffu] - 1);
+        writeRaw(out, c.second.wins);
+        writeRaw(out, c.second.ties);
+        writeRaw(out, c.second.losses);
+    }
+    return static_cast<bool>(out);
+}
+
+bool ResultMatrix::read(std::istream& in)
+{
+    hashes.clear();
+    unused.clear();
+    index.clear();
+    cells.clear();
+
+    std::uint32_t n, m;
+    if (!readRaw(in, n)) return false;
+    for (std::uint32_t i = 0; i < n; ++i) {
+        std::uint64_t h;
+        if (!readRaw(in, h)) return false;
+        indexOf(h);
+    }
+    if (!readRaw(in, m)) return false;
+    for (std::uint32_t k = 0; k < m; ++k) {
+        std::uint32_t a, b;
+        Cell c;
+        if (!readRaw(in, a) || !readRaw(in, b) || !readRaw(in, c.wins) ||
+            !readRaw(in, c.ties) || !readRaw(in, c.losses) ||
+            a >= hashes.size() || b >= hashes.size())
+            return false;
+        // write() numbered the warriors again, so the lower index may now
+        // be the second one
+        cells[key(std::min(a, b), std::max(a, b))] = a < b ? c : Cell{c.losses, c.ties, c.wins};
+    }
+    return true;
+}
+
+// --------------------- Hall of fame -------------------------------------
+bool HallOfFame::isMember(std::uint64_t hash) const
+{
+    for (const Member& m : hall)
+        if (m.hash == hash) return true;
+    return false;
+}
+
+bool HallOfFame::add(std::vector<int> genome, WarriorCode code)
+{
+    std::uint64_t hash = codeHash(code);
+    if (isMember(hash)) return false;
+
+    hall.push_back(Member{std::move(genome), std::move(code), hash});
+    while (hall.size() > capacity) {
+        matrix.forget(hall.front().hash);
+        hall.pop_front();
+    }
+    return true;
+}
+
+static const std::uint32_t HOF_MAGIC = 0x46484357;   // "WCHF"
+static const std::uint32_t HOF_VERSION = 2;
+
+// The battle parameters the results were played under, in the file's order
+static std::vector<std::int32_t> paramsOf(const battle_params& p)
+{
+    return {p.coreSize, p.cycles, p.processes, p.maxLength, p.minDistance, p.rounds};
+}
+
+bool HallOfFame::save(const std::string& file) const
+{
+    std::string tmp = file + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        writeRaw(out, HOF_MAGIC);
+        writeRaw(out, HOF_VERSION);
+        for (std::int32_t x : paramsOf(params)) writeRaw(out, x);
+        writeRaw(out, static_cast<std::uint32_t>(hall.size()));
+        for (const Member& m : hall) {
+            writeRaw(out, static_cast<std::uint32_t>(m.genome.size()));
+            out.write(reinterpret_cast<const char*>(m.genome.data()),
+                      m.genome.size()*sizeof(int));
+            writeRaw(out, m.code.offset);
+            writeRaw(out, static_cast<std::uint32_t>(m.code.inst.size()));
+            out.write(reinterpret_cast<const char*>(m.code.inst.data()),
+                      m.code.inst.size()*sizeof(battle_inst));
+        }
+        std::vector<std::uint64_t> members;
+        for (const Member& m : hall) members.push_back(m.hash);
+        matrix.write(out, members);
+        out.flush();
+        if (!out) {
+            std::cerr << "HallOfFame: cannot write " << tmp << "\n";
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+    return std::rename(tmp.c_str(), file.c_str()) == 0;
+}
+
+// A missing file is an empty hall of fame (false, nothing said); a broken
+// one, or one whose code was assembled for another core, is reported and
+// left alone.
+bool HallOfFame::load(const std::string& file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in) return false;
+
+    std::uint32_t magic, version, n;
+    std::vector<std::int32_t> saved = paramsOf(params), current = saved;
+    std::deque<Member> loaded;
+    bool ok = readRaw(in, magic) && magic == HOF_MAGIC &&
+              readRaw(in, version) && version == HOF_VERSION;
+    for (std::int32_t& x : saved) ok = ok && readRaw(in, x);
+    ok = ok && readRaw(in, n);
+    if (ok && (saved[0] != current[0] || saved[3] != current[3])) {
+        std::cerr << "HallOfFame: " << file << " is for core size " << saved[0]
+                  << ", length " << saved[3] << "; not using it\n";
+        return false;
+    }
+    for (std::uint32_t i = 0; ok && i < n; ++i) {
+        Member m;
+        std::uint32_t len, insts;
+        ok = readRaw(in, len) && len <= BATTLE_MAXPAYLOAD;
+        if (!ok) break;
+        m.genome.resize(len);
+        ok = in.read(reinterpret_cast<char*>(m.genome.data()), len*sizeof(int)) &&
+             readRaw(in, m.code.offset) && readRaw(in, insts) && insts <= BATTLE_MAXPAYLOAD;
+        if (!ok) break;
+        m.code.inst.resize(insts);
+        ok = static_cast<bool>(in.read(reinterpret_cast<char*>(m.code.inst.data()),
+                                       insts*sizeof(battle_inst)));
+        m.hash = codeHash(m.code);
+        loaded.push_back(std::move(m));
+    }
+    ResultMatrix results;
+    if (!ok || !results.read(in)) {
+        std::cerr << "HallOfFame: " << file << " is damaged, not using it\n";
+        return false;
+    }
+
+    hall = std::move(loaded);
+    matrix = std::move(results);
+    if (saved != current) {
+        std::cerr << "HallOfFame: " << file << " was played under other battle"
+                  << " parameters; playing its members again\n";
+        matrix = ResultMatrix();
+    }
+    while (hall.size() > capacity) hall.pop_front();
+    // with a smaller capacity the oldest members left, and their results go
+    std::vector<std::uint64_t> members;
+    for (const Member& m : hall) members.push_back(m.hash);
+    matrix.retain(members);
+    return true;
+}
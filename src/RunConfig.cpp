@@ -0,0 +1,248 @@
+#include "RunConfig.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+battle_params RunConfig::battleParams() const
+{
+    battle_params p = defaultBattleParams();
+    p.coreSize = coreSize;
+    p.cycles = cycles;
+    p.processes = processes;
+    p.maxLength = maxLength;
+    p.minDistance = minDistance;
+    return p;
+}
+
+// --------------------- Keys ---------------------------------------------
+static bool parse(const std::string& s, int& x)
+{
+    char* end;
+    long v = std::strtol(s.c_str(), &end, 10);
+    if (s.empty() || *end) return false;
+    x = static_cast<int>(v);
+    return true;
+}
+
+static bool parse(const std::string& s, unsigned& x)
+{
+    int v;
+    if (!parse(s, v) || v < 0) return false;
+    x = static_cast<unsigned>(v);
+    return true;
+}
+
+static bool parse(const std::string& s, double& x)
+{
+    char* end;
+    x = std::strtod(s.c_str(), &end);
+    return !s.empty() && !*end;
+}
+
+static bool parse(const std::string& s, float& x)
+{
+    double v;
+    if (!parse(s, v)) return false;
+    x = static_cast<float>(v);
+    return true;
+}
+
+static bool parse(const std::string& s, bool& x)
+{
+    if (s == "1" || s == "true" || s == "yes" || s == "on") x = true;
+    else if (s == "0" || s == "false" || s == "no" || s == "off") x = false;
+    else return false;
+    return true;
+}
+
+static bool parse(const std::string& s, std::string& x)
+{
+    x = s;
+    return true;
+}
+
+// comma separated
+static bool parse(const std::string& s, std::vector<std::string>& x)
+{
+    x.clear();
+    std::istringstream in(s);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t a = item.find_first_not_of(" \t"), b = item.find_last_not_of(" \t");
+        if (a != std::string::npos) x.push_back(item.substr(a, b - a + 1));
+    }
+    return true;
+}
+
+template <class T>
+static std::string show(const T& x)
+{
+    std::ostringstream out;
+    out << x;
+    return out.str();
+}
+
+static std::string show(const bool& x) { return x ? "true" : "false"; }
+
+static std::string show(const std::vector<std::string>& x)
+{
+    std::string s;
+    for (const std::string& item : x) s += (s.empty() ? "" : ", ") + item;
+    return s;
+}
+
+struct Key {
+    const char* name;
+    std::function<bool(RunConfig&, const std::string&)> set;
+    std::function<std::string(const RunConfig&)> get;
+};
+
+template <class T>
+static Key key(const char* name, T RunConfig::* field)
+{
+    return Key{name,
+               [field](RunConfig& c, const std::string& v) { return parse(v, c.*field); },
+               [field](const RunConfig& c) { return show(c.*field); }};
+}
+
+static const std::vector<Key>& keys()
+{
+    static const std::vector<Key> all = {
+        key("population", &RunConfig::population),
+        key("generations", &RunConfig::generations),
+        key("mutation", &RunConfig::mutation),
+        key("crossover", &RunConfig::crossover),
+        key("sharing", &RunConfig::sharing),
+        key("seed", &RunConfig::seed),
+        key("resume", &RunConfig::resume),
+        key("instructions", &RunConfig::instructions),
+        key("core_size", &RunConfig::coreSize),
+        key("cycles", &RunConfig::cycles),
+        key("processes", &RunConfig::processes),
+        key("max_length", &RunConfig::maxLength),
+        key("min_distance", &RunConfig::minDistance),
+        key("opponents", &RunConfig::opponents),
+        key("racing", &RunConfig::racing),
+        key("min_rounds", &RunConfig::minRounds),
+        key("max_rounds", &RunConfig::maxRounds),
+        key("round_batch", &RunConfig::roundBatch),
+        key("target_se", &RunConfig::targetSE),
+        key("variance_lambda", &RunConfig::varianceLambda),
+        key("pmars_worker", &RunConfig::pmarsWorker),
+        key("workers", &RunConfig::workers),
+        key("farm_nodes", &RunConfig::farmNodes),
+        key("code_cache", &RunConfig::codeCache),
+        key("hall_of_fame", &RunConfig::hallOfFame),
+        key("hof_rounds", &RunConfig::hofRounds),
+        key("hof_file", &RunConfig::hofFile),
+        key("surrogate_fraction", &RunConfig::surrogateFraction),
+        key("surrogate_explore", &RunConfig::surrogateExplore),
+        key("checkpoint_file", &RunConfig::checkpointFile),
+        key("checkpoint_interval", &RunConfig::checkpointInterval),
+    };
+    return all;
+}
+
+bool setRunConfig(RunConfig& config, const std::string& name, const std::string& value)
+{
+    for (const Key& k : keys())
+        if (name == k.name) {
+            if (k.set(config, value)) return true;
+            std::cerr << "Bad value for " << name << ": '" << value << "'\n";
+            return false;
+        }
+    std::cerr << "Unknown setting: " << name << "\n";
+    return false;
+}
+
+void printRunConfig(std::ostream& out, const RunConfig& config)
+{
+    for (const Key& k : keys())
+        out << k.name << " = " << k.get(config) << "\n";
+}
+
+// --------------------- Sources ------------------------------------------
+static std::string trim(const std::string& s)
+{
+    size_t a = s.find_first_not_of(" \t\r"), b = s.find_last_not_of(" \t\r");
+    return a == std::string::npos ? "" : s.substr(a, b - a + 1);
+}
+
+static bool readConfigFile(const std::string& file, RunConfig& config)
+{
+    std::ifstream in(file);
+    if (!in) {
+        std::cerr << "Cannot read config file " << file << "\n";
+        return false;
+    }
+    std::string line;
+    for (int n = 1; std::getline(in, line); ++n) {
+        line = trim(line.substr(0, line.find('#')));
+        if (line.empty()) continue;
+        size_t eq = line.find('=');
+        if (eq == std::string::npos ||
+            !setRunConfig(config, trim(line.substr(0, eq)), trim(line.substr(eq + 1)))) {
+            std::cerr << file << ":" << n << ": cannot use '" << line << "'\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool checkRunConfig(const RunConfig& c)
+{
+    const char* problem = nullptr;
+    if (c.population < 1) problem = "population must be at least 1";
+    else if (c.instructions < 1 || c.instructions > c.maxLength)
+        problem = "instructions must be between 1 and max_length";
+    else if (c.coreSize < 2*c.minDistance || c.minDistance < c.maxLength)
+        problem = "core_size, min_distance and max_length don't fit together";
+    else if (c.cycles < 1 || c.processes < 1) problem = "cycles and processes must be positive";
+    else if (c.opponents.empty()) problem = "no opponents";
+    else if (c.roundBatch < 1 || c.minRounds < 1 || c.maxRounds < 1)
+        problem = "min_rounds, max_rounds and round_batch must be at least 1";
+    else if (c.hofRounds < 1) problem = "hof_rounds must be at least 1";
+    else if (c.checkpointInterval < 1) problem = "checkpoint_interval must be at least 1";
+    if (problem) std::cerr << "Bad configuration: " << problem << "\n";
+    return !problem;
+}
+
+bool loadRunConfig(int argc, char* argv[], RunConfig& config)
+{
+    std::vector<std::string> positional;
+    std::vector<std::string> settings;
+    for (int a = 1; a < argc; ++a) {
+        if (std::strcmp(argv[a], "--config") == 0 && a + 1 < argc) {
+            if (!readConfigFile(argv[++a], config)) return false;
+        } else if (std::strchr(argv[a], '=')) {
+            settings.push_back(argv[a]);
+        } else {
+            positional.push_back(argv[a]);
+        }
+    }
+
+    if (const char* env = std::getenv("COREWAR_NODES")) config.farmNodes = env;
+    if (const char* env = std::getenv("COREWAR_HOF"))
+        if (!setRunConfig(config, "hall_of_fame", env)) return false;
+    if (const char* env = std::getenv("COREWAR_SURROGATE"))
+        if (!setRunConfig(config, "surrogate_fraction", env)) return false;
+
+    static const char* order[] = {
+        "population", "generations", "mutation", "crossover", "sharing", "resume"
+    };
+    if (positional.size() > sizeof(order)/sizeof(order[0])) {
+        std::cerr << "Too many arguments\n";
+        return false;
+    }
+    for (size_t i = 0; i < positional.size(); ++i)
+        if (!setRunConfig(config, order[i], positional[i])) return false;
+    for (const std::string& s : settings) {
+        size_t eq = s.find('=');
+        if (!setRunConfig(config, s.substr(0, eq), s.substr(eq + 1))) return false;
+    }
+    return checkRunConfig(config);
+}
@@ -0,0 +1,241 @@
+#include "Surrogate.h"
+#include "Config.h"
+#include "WarriorEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+Surrogate::Surrogate(float fraction, float explore, int k, size_t samples,
+                     size_t minSamples)
+    : fraction(std::min(1.0f, std::max(0.0f, fraction))),
+      explore(std::min(1.0f, std::max(0.0f, explore))),
+      k(std::max(1, k)), samples(std::max<size_t>(1, samples)),
+      minSamples(minSamples)
+{
+}
+
+void Surrogate::install(GAPopulation& pop)
+{
+    pop.userData(this);
+    pop.evaluator(evaluatePopulation);
+}
+
+void Surrogate::evaluatePopulation(GAPopulation& pop)
+{
+    static_cast<Surrogate*>(pop.userData())->screen(pop);
+}
+
+// Inverse-distance weights; the distance moves in steps of one instruction,
+// which keeps an identical warrior from taking all the weight.
+float Surrogate::predict(const GAGenome& g) const
+{
+    if (known.empty()) return 0.0f;
+
+    std::vector<std::pair<float, float>> near;     // (distance, score)
+    near.reserve(known.size());
+    for (const Sample& s : known)
+        near.emplace_back(warriorDistance(g, s.genome), s.score);
+    size_t n = std::min(near.size(), static_cast<size_t>(k));
+    std::partial_sort(near.begin(), near.begin() + n, near.end(),
+                      [](const std::pair<float, float>& a, const std::pair<float, float>& b)
+                      { return a.first < b.first; });
+
+    const int length = static_cast<const GA1DArrayGenome<int>&>(g).length();
+    const float step = static_cast<float>(INSTR_FIELDS) / std::max(INSTR_FIELDS, length);
+    float sum = 0.0f, weights = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float w = 1.0f / (near[i].first + step);
+        sum += w*near[i].second;
+        weights += w;
+    }
+    return sum / weights;
+}
+
+void Surrogate::learn(const GAGenome& g, float score)
+{
+    known.push_back(Sample{static_cast<const GA1DArrayGenome<int>&>(g), score});
+    if (known.size() > samples) known.pop_front();
+}
+
+// Predictions go by the genes: a child that is a plain copy of its parent
+// gets the parent's score, predicted or not.
+static std::uint64_t genesHash(const GAGenome& g)
+{
+    const auto& genome = static_cast<const GA1DArrayGenome<int>&>(g);
+    std::uint64_t h = 14695981039346656037ULL;
+    for (int i = 0; i < genome.length(); ++i) {
+        h ^= static_cast<std::uint32_t>(genome.gene(i));
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool Surrogate::isPredicted(const GAGenome& g) const
+{
+    return g.evaluated() && guessed.count(genesHash(g)) > 0;
+}
+
+// Simulates the best of the population while its score is a prediction;
+// returns how many were simulated.
+int Surrogate::simulateBest(GAPopulation& pop)
+{
+    const bool high = pop.order() == GAPopulation::HIGH_IS_BEST;
+    int simulatedNow = 0;
+    for (;;) {
+        int best = 0;
+        for (int i = 1; i < pop.size(); ++i) {
+            float s = pop.individual(i).score(), b = pop.individual(best).score();
+            if (high ? s > b : s < b) best = i;
+        }
+        GAGenome& g = pop.individual(best);
+        if (!isPredicted(g)) return simulatedNow;
+        guessed.erase(genesHash(g));
+        learn(g, g.evaluate(gaTrue));
+        nSimulated++;
+        nPredicted--;
+        simulatedNow++;
+    }
+}
+
+void Surrogate::screen(GAPopulation& pop)
+{
+    // Only the predictions that are still in the population (bred from
+    // the one screened last time) are kept
+    std::vector<int> fresh;
+    std::unordered_set<std::uint64_t> stillGuessed;
+    for (int i = 0; i < pop.size(); ++i) {
+        const GAGenome& g = pop.individual(i);
+        if (!g.evaluated()) fresh.push_back(i);
+        else if (isPredicted(g)) stillGuessed.insert(genesHash(g));
+    }
+    guessed.swap(stillGuessed);
+
+    // Too little to go on yet: simulate everything (and learn from it)
+    if (known.size() < minSamples) {
+        for (int i : fresh) {
+            GAGenome& g = pop.individual(i);
+            learn(g, g.evaluate());
+            nSimulated++;
+        }
+        simulateBest(pop);
+        return;
+    }
+    if (fresh.empty()) return;
+
+    std::vector<std::pair<float, int>> ranked;     // (prediction, individual)
+    for (int i : fresh) ranked.emplace_back(predict(pop.individual(i)), i);
+    bool high = pop.order() == GAPopulation::HIGH_IS_BEST;
+    std::stable_sort(ranked.begin(), ranked.end(),
+                     [high](const std::pair<float, int>& a, const std::pair<float, int>& b)
+                     { return high ? a.first > b.first : a.first < b.first; });
+
+    // The top share, then a random sample of the rest (at least one, so
+    // there is always something to measure the error on)
+    const size_t n = ranked.size();
+    const size_t top = std::min(n, static_cast<size_t>(std::ceil(fraction*n)));
+    const size_t rest = n - top;
+    const size_t explored = rest ? std::max<size_t>(1, std::lround(explore*rest)) : 0;
+    for (size_t e = 0; e < explored; ++e)
+        std::swap(ranked[top + e], ranked[GARandomInt(top + e, n - 1)]);
+
+    float error = 0.0f;
+    for (size_t r = 0; r < n; ++r) {
+        GAGenome& g = pop.individual(ranked[r].second);
+        if (r < top + explored) {
+            float score = g.evaluate();
+            learn(g, score);
+            nSimulated++;
+            if (r >= top) {
+                error += std::fabs(score - ranked[r].first);
+                errExplored += std::fabs(score - ranked[r].first);
+                nExplored++;
+            }
+        } else {
+            g.score(ranked[r].first);
+            guessed.insert(genesHash(g));
+            nPredicted++;
+        }
+    }
+    // The best may be a prediction from an earlier generation, so the
+    // confirmations aren't taken off this generation's predictions
+    const int confirmed = simulateBest(pop);
+
+    std::cout << "\nSurrogate: simulated " << top << " + " << explored << " of " << n
+              << " offspring, " << n - top - explored << " predicted";
+    if (confirmed)
+        std::cout << " (" << confirmed << " predicted simulated to be the best)";
+    if (explored)
+        std::cout << ", error on the exploration slice " << error / explored;
+    std::cout << " (" << nPredicted << " simulations saved so far)\n";
+}
+
+// --------------------- Checkpoint ---------------------------------------
+int Surrogate::save(GASnapshot& s) const
+{
+    s.put(static_cast<unsigned int>(known.size()));
+    for (const Sample& k : known) {
+        s.put(k.genome.length());
+        for (int i = 0; i < k.genome.length(); ++i) s.put(k.genome.gene(i));
+        s.put(k.score);
+    }
+    // (a copy: GALib's template operator!= is a better match for the set's
+    // iterators than the standard one)
+    const std::vector<std::uint64_t> hashes(guessed.begin(), guessed.end());
+    s.put(static_cast<unsigned int>(hashes.size()));
+    for (std::uint64_t h : hashes) s.put(&h, sizeof(h));
+    s.put(static_cast<double>(nSimulated));
+    s.put(static_cast<double>(nPredicted));
+    s.put(static_cast<double>(nExplored));
+    s.put(errExplored);
+    return 0;
+}
+
+int Surrogate::load(GASnapshot& s, const GAGenome& like)
+{
+    std::deque<Sample> samplesLoaded;
+    unsigned int n = s.getUInt();
+    for (unsigned int j = 0; j < n && s.good(); ++j) {
+        Sample k{static_cast<const GA1DArrayGenome<int>&>(like), 0.0f};
+        int length = s.getInt();
+        if (length != k.genome.length()) return 1;
+        for (int i = 0; i < length; ++i) k.genome.gene(i, s.getInt());
+        k.score = s.getFloat();
+        samplesLoaded.push_back(std::move(k));
+    }
+    std::unordered_set<std::uint64_t> guessedLoaded;
+    n = s.getUInt();
+    for (unsigned int j = 0; j < n && s.good(); ++j) {
+        std::uint64_t h = 0;
+        s.get(&h, sizeof(h));
+        guessedLoaded.insert(h);
+    }
+    long simulatedLoaded = static_cast<long>(s.getDouble());
+    long predictedLoaded = static_cast<long>(s.getDouble());
+    long exploredLoaded = static_cast<long>(s.getDouble());
+    double errorLoaded = s.getDouble();
+    if (!s.good()) return 1;
+
+    known.swap(samplesLoaded);
+    while (known.size() > samples) known.pop_front();
+    guessed.swap(guessedLoaded);
+    nSimulated = simulatedLoaded;
+    nPredicted = predictedLoaded;
+    nExplored = exploredLoaded;
+    errExplored = errorLoaded;
+    return 0;
+}
+
+void Surrogate::report() const
+{
+    long total = nSimulated + nPredicted;
+    std::cout << "Surrogate: " << nSimulated << " of " << total << " warriors simulated, "
+              << nPredicted << " predicted";
+    if (total) std::cout << " (" << 100.0*nPredicted/total << "% saved)";
+    if (nExplored)
+        std::cout << ", mean error on " << nExplored << " exploration samples "
+                  << exploreError();
+    std::cout << "\n";
+}
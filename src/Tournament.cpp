@@ -0,0 +1,145 @@
+#include "Tournament.h"
+#include "Config.h"
+#include "CompiledWarrior.h"
+
+#include <algorithm>
+#include <atomic>
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+Tournament::Tournament(BattleBackend& backend, const battle_params& params)
+    : backend(backend), params(params)
+{
+}
+
+int Tournament::add(const std::string& name, const std::string& source)
+{
+    WarriorCode code;
+    int status;
+    if (!backend.assemble(source, params, code, &status)) {
+        std::cerr << "Tournament: cannot assemble " << name << "\n";
+        return -1;
+    }
+    return addCode(name, std::move(code));
+}
+
+int Tournament::addCode(const std::string& name, WarriorCode&& code)
+{
+    names.push_back(name);
+    codes.push_back(std::move(code));
+    return size() - 1;
+}
+
+int Tournament::addFile(const std::string& file)
+{
+    WarriorCode code;
+    if (isCompiled(file))
+        return loadCompiled(file, params, code) ? addCode(file, std::move(code)) : -1;
+
+    std::ifstream in(file, std::ios::binary);
+    std::ostringstream source;
+    source << in.rdbuf();
+    if (!in) {
+        std::cerr << "Tournament: cannot read " << file << "\n";
+        return -1;
+    }
+    if (findCompiled(file, source.str(), params, code)) return addCode(file, std::move(code));
+    return add(file, source.str());
+}
+
+int Tournament::addDirectory(const std::string& dir)
+{
+    DIR* d = opendir(dir.c_str());
+    if (!d) {
+        std::cerr << "Tournament: cannot open " << dir << "\n";
+        return 0;
+    }
+    std::vector<std::string> files, compiled;
+    while (dirent* e = readdir(d)) {
+        std::string f = e->d_name;
+        if (f.size() > 4 && f.compare(f.size() - 4, 4, ".red") == 0)
+            files.push_back(dir + "/" + f);
+        else if (isCompiled(f))
+            compiled.push_back(dir + "/" + f);
+    }
+    closedir(d);
+    // a .rcb without its .red goes in as it is; one with it is used by
+    // addFile if it is still the compiled form of that source
+    std::sort(files.begin(), files.end());
+    for (const std::string& f : compiled)
+        if (!std::binary_search(files.begin(), files.end(), f.substr(0, f.size() - 4) + ".red"))
+            files.push_back(f);
+    std::sort(files.begin(), files.end());
+
+    int added = 0;
+    for (const std::string& f : files)
+        if (addFile(f) >= 0) added++;
+    return added;
+}
+
+// splitmix64: start positions of pair k, 1..2^30 like the evaluator's seeds
+static int pairSeed(std::uint32_t seed, std::uint64_t k)
+{
+    std::uint64_t z = (static_cast<std::uint64_t>(seed) << 32 | k) + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    return 1 + static_cast<int>(z % (1u << 30));
+}
+
+int Tournament::run(int rounds, std::uint32_t seed)
+{
+    const int n = size();
+    matrix.assign(static_cast<size_t>(n)*n, PairResult());
+
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < n; ++i)
+        for (int j = i + 1; j < n; ++j)
+            pairs.emplace_back(i, j);
+
+    // One thread per battle the backend can run at once; each takes the next
+    // pair until none are left.
+    std::atomic<size_t> next{0};
+    std::atomic<int> failed{0};
+    auto play = [&]() {
+        battle_params p = params;
+        p.rounds = rounds;
+        for (size_t k; (k = next++) < pairs.size(); ) {
+            int i = pairs[k].first, j = pairs[k].second;
+            p.seed = pairSeed(seed, k);
+            BattleScores scores;
+            if (!backend.run(p, {&codes[i], &codes[j]}, scores)) {
+                failed++;
+                continue;
+            }
+            PairResult& r = matrix[i*n + j];
+            r.wins = scores.score[0];
+            r.ties = scores.score[1];
+            r.losses = scores.rounds - r.wins - r.ties;
+            matrix[j*n + i] = PairResult{r.losses, r.ties, r.wins};
+        }
+    };
+
+    unsigned threads = std::min<size_t>(backend.concurrency(), pairs.size());
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(play);
+    play();
+    for (std::thread& t : pool) t.join();
+    return failed;
+}
+
+float Tournament::score(int i) const
+{
+    int rounds = 0;
+    float total = 0.0f;
+    for (int j = 0; j < size(); ++j) {
+        const PairResult& r = result(i, j);
+        total += WIN_SCORE*r.wins + TIE_SCORE*r.ties + LOSS_SCORE*r.losses;
+        rounds += r.rounds();
+    }
+    return rounds ? total / rounds : 0.0f;
+}
@@ -0,0 +1,140 @@
+#include "WarriorAnalysis.h"
+
+#include <vector>
+
+namespace {
+
+// As in pmars (global.h): opcode numbers, and the addressing modes without
+// the A-field flag (0x80) that marks * { }
+enum { MOV, ADD, SUB, MUL, DIV, MOD, JMZ, JMN, DJN, CMP, SLT, SPL, DAT, JMP,
+       SEQ, SNE, NOP, LDP, STP };
+enum { IMMEDIATE, DIRECT, INDIRECT, PREDECR, POSTINC };
+
+struct Analysis {
+    const WarriorCode& code;
+    int coreSize;
+    int length;
+    std::vector<char> state;        // 0 not reached, 1 on the path, 2 done
+    std::vector<int> dataWrites;    // cells of the warrior that get written
+    bool harmful = false, dies = false, cycle = false;
+
+    Analysis(const WarriorCode& code, int coreSize)
+        : code(code), coreSize(coreSize), length(static_cast<int>(code.inst.size())),
+          state(code.inst.size(), 0) {}
+
+    int cell(int pc, int value) const {
+        return static_cast<int>(((static_cast<long>(pc) + value) % coreSize + coreSize) % coreSize);
+    }
+
+    void write(int target) {
+        if (target >= length) harmful = true;
+        else dataWrites.push_back(target);
+    }
+
+    // Address of a jump or write operand; -1 (and harmful) for the indirect
+    // modes, whose target depends on the data.
+    int address(int pc, unsigned char mode, int value) {
+        switch (mode & 0x7f) {
+        case IMMEDIATE: return pc;
+        case DIRECT:    return cell(pc, value);
+        default:        harmful = true; return -1;
+        }
+    }
+
+    void visit(int pc) {
+        if (pc < 0) return;
+        if (pc >= length) {         // empty core
+            dies = true;
+            return;
+        }
+        if (state[pc] == 1) cycle = true;
+        if (state[pc] != 0) return;
+        state[pc] = 1;
+
+        const battle_inst& in = code.inst[pc];
+        const int op = in.opcode >> 3;    // opcode*8 + modifier
+
+        // < > { } change the pointer cell, whatever the instruction does
+        if ((in.a_mode & 0x7f) == PREDECR || (in.a_mode & 0x7f) == POSTINC)
+            write(cell(pc, in.a_value));
+        if ((in.b_mode & 0x7f) == PREDECR || (in.b_mode & 0x7f) == POSTINC)
+            write(cell(pc, in.b_value));
+
+        std::vector<int> next;
+        switch (op) {
+        case DAT:
+            dies = true;
+            break;
+        case MOV: case ADD: case SUB: case MUL: case LDP: {
+            int target = address(pc, in.b_mode, in.b_value);
+            if (target >= 0) write(target);
+            next = {pc + 1};
+            break;
+        }
+        case DIV: case MOD:         // division by zero kills the process
+            harmful = true;
+            break;
+        case DJN: {
+            int target = address(pc, in.b_mode, in.b_value);
+            if (target >= 0) write(target);
+            next = {address(pc, in.a_mode, in.a_value), pc + 1};
+            break;
+        }
+        case JMZ: case JMN: case SPL:
+            next = {address(pc, in.a_mode, in.a_value), pc + 1};
+            break;
+        case JMP:
+            next = {address(pc, in.a_mode, in.a_value)};
+            break;
+        case CMP: case SEQ: case SNE: case SLT:
+            next = {pc + 1, pc + 2};
+            break;
+        case NOP: case STP:
+            next = {pc + 1};
+            break;
+        default:
+            harmful = true;
+        }
+        for (int n : next)
+            if (!harmful) visit(n);
+        state[pc] = 2;
+    }
+};
+
+} // namespace
+
+WarriorClass classifyWarrior(const WarriorCode& code, int coreSize)
+{
+    if (code.inst.empty() || coreSize <= 0) return WarriorClass::Viable;
+
+    Analysis a(code, coreSize);
+    a.visit(a.cell(code.offset, 0));
+    if (a.harmful) return WarriorClass::Viable;
+    // writing code that runs can turn it into anything
+    for (int c : a.dataWrites)
+        if (a.state[c] != 0) return WarriorClass::Viable;
+
+    if (!a.cycle) return WarriorClass::DiesImmediately;
+    if (a.dies) return WarriorClass::Viable;    // it may loop, or may not
+    return a.dataWrites.empty() ? WarriorClass::NeverWrites : WarriorClass::OwnDataWrites;
+}
+
+const char* warriorClassName(WarriorClass c)
+{
+    switch (c) {
+    case WarriorClass::Viable:          return "viable";
+    case WarriorClass::DiesImmediately: return "dies immediately";
+    case WarriorClass::NeverWrites:     return "pure loop, never writes";
+    case WarriorClass::OwnDataWrites:   return "harmless, writes only its own data";
+    }
+    return "?";
+}
+
+bool usesPspace(const WarriorCode& code)
+{
+    for (const battle_inst& in : code.inst) {
+        int op = in.opcode >> 3;
+        if (op == LDP || op == STP) return true;
+    }
+    return false;
+}
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <string>
 #include <algorithm> // for std::max
+#include <cmath>
+#include <cstdint>
 
 // ======================================================================
 //  CoreWar opcode list (ICWS'94 compliant)
@@ -31,6 +33,13 @@ const int numOpcodes = sizeof(opcodeStr) / sizeof(opcodeStr[0]);
 // ======================================================================
 constexpr int SAFE_CODE_LEN = 6;
 
+// Core size the warriors are written for (operand ranges, the assert line)
+static int coreSize = CORESIZE;
+
+void setEncoderCoreSize(int size) {
+    coreSize = size;
+}
+
 // ======================================================================
 //  Dwarf template genome
 //  Used only as a *starting bias*, not a hard template
@@ -57,7 +66,7 @@ const int dwarfGenome[] = {
 // ======================================================================
 inline int safeOperand(int val, bool isDAT) {
     if(isDAT)
-        return (val % CORESIZE + CORESIZE) % CORESIZE;
+        return (val % coreSize + coreSize) % coreSize;
     else
         return (val % 100 + 100) % 100;
 }
@@ -136,6 +145,67 @@ void initGenomeFromDwarf(GAGenome& g, int generation) {
     }
 }
 
+// ======================================================================
+//  Decoded opcode of one instruction
+//
+//  Same deterministic rules as writeWarrior (no DAT in executable code,
+//  no SPL in the last executable slot), without the random operand choices.
+// ======================================================================
+static int decodedOpcode(const GA1DArrayGenome<int>& g, int instrIndex) {
+    int op = getOpcode(g[instrIndex * INSTR_FIELDS]);
+    const int NOP = 14, DAT = 15, SPL = 10;
+    if(instrIndex < SAFE_CODE_LEN) {
+        if(op == DAT) op = NOP;
+        if(op == SPL && instrIndex >= SAFE_CODE_LEN - 1) op = NOP;
+    }
+    return op;
+}
+
+// ======================================================================
+//  Distance between two warriors for fitness sharing
+//
+//  Fraction of instructions whose decoded opcode differs (0 = same code).
+// ======================================================================
+float warriorDistance(const GAGenome& a, const GAGenome& b) {
+    const auto& ga = static_cast<const GA1DArrayGenome<int>&>(a);
+    const auto& gb = static_cast<const GA1DArrayGenome<int>&>(b);
+    const int n = std::min(ga.length(), gb.length()) / INSTR_FIELDS;
+    if(n == 0) return 0.0f;
+
+    int diff = 0;
+    for(int i = 0; i < n; ++i)
+        if(decodedOpcode(ga, i) != decodedOpcode(gb, i)) diff++;
+    return (float)diff / n;
+}
+
+// ======================================================================
+//  Niche keys for bucketed sharing
+//
+//  The instructions are cut into B = ceil(sigma*n) bands, one key (FNV-1a
+//  of the band number and its decoded opcodes) per band. Warriors closer
+//  than sigma differ in fewer than B instructions, so they agree on at
+//  least one whole band and share its bucket: the buckets find every pair
+//  warriorDistance puts within sigma. Too many bands for the buckets means
+//  a big sigma: then there are no keys, and every warrior goes in the
+//  common bucket.
+// ======================================================================
+int warriorNiche(const GAGenome& g, float sigma, unsigned long* keys) {
+    const auto& genome = static_cast<const GA1DArrayGenome<int>&>(g);
+    const int n = genome.length() / INSTR_FIELDS;
+
+    int bands = (int)std::ceil(sigma * n);
+    if(bands < 1) bands = 1;
+    if(bands > n || bands > GASharing::MAX_BUCKETS) return 0;
+    for(int j = 0; j < bands; ++j) {
+        std::uint64_t h = 14695981039346656037ULL;
+        h = (h ^ (std::uint64_t)j) * 1099511628211ULL;
+        for(int i = j * n / bands; i < (j + 1) * n / bands; ++i)
+            h = (h ^ (std::uint64_t)decodedOpcode(genome, i)) * 1099511628211ULL;
+        keys[j] = (unsigned long)h;
+    }
+    return bands;
+}
+
 // ======================================================================
 //  GA initializer
 // ======================================================================
@@ -163,9 +233,12 @@ void writeWarrior(const GA1DArrayGenome<int>& g, const std::string& filename) {
         std::cerr << "Error opening " << filename << "\n";
         return;
     }
+    writeWarrior(g, out);
+}
 
+void writeWarrior(const GA1DArrayGenome<int>& g, std::ostream& out) {
     out << "; Evolved warrior\n";
-    out << "; assert CORESIZE==" << CORESIZE << "\n";
+    out << "; assert CORESIZE==" << coreSize << "\n";
     out << "ORG 0\n";
 
     const int instrCount = g.length() / INSTR_FIELDS;
@@ -219,7 +292,7 @@ void writeWarrior(const GA1DArrayGenome<int>& g, const std::string& filename) {
             // - Random far target improves attack chance
             // ----------------------------------------------------------
             am = '#';
-            av = GARandomInt(SAFE_CODE_LEN + 20, CORESIZE - 1);
+            av = GARandomInt(SAFE_CODE_LEN + 20, coreSize - 1);
         } else {
             if(instrIndex < SAFE_CODE_LEN) {
                 // Short offsets for loops and scanning
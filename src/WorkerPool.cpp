@@ -0,0 +1,149 @@
+#include "WorkerPool.h"
+#include "BattleWire.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <utility>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// --------------------- Worker processes ---------------------------------
+WorkerPool::WorkerPool(std::string program, unsigned n)
+    : program(std::move(program))
+{
+    if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+    workers.resize(n);
+    if (access(this->program.c_str(), X_OK) != 0)
+        std::cerr << "WorkerPool: cannot run " << this->program
+                  << " (build it with 'make' in pmars-0.9.4/src)\n";
+    for (Worker& w : workers) start(w);
+}
+
+WorkerPool::~WorkerPool()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    idle.wait(guard, [this] {
+        for (const Worker& w : workers) if (w.busy) return false;
+        return true;
+    });
+    for (Worker& w : workers) stop(w, true);
+}
+
+// The child gets its end of the socket as stdin and stdout. Both ends are
+// close-on-exec, so workers don't hold each other's sockets open (dup2
+// clears the flag on the copies the child keeps).
+bool WorkerPool::start(Worker& w)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0)
+        return false;
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+    if (pid == 0) {
+        dup2(sv[1], 0);
+        dup2(sv[1], 1);
+        execl(program.c_str(), program.c_str(), static_cast<char*>(nullptr));
+        _exit(127);
+    }
+    close(sv[1]);
+    w.pid = pid;
+    w.fd = sv[0];
+    return true;
+}
+
+// Ask it to quit (or just kill it if it misbehaved) and reap it.
+void WorkerPool::stop(Worker& w, bool quit)
+{
+    if (w.fd >= 0) {
+        if (quit) {
+            battle_header h{BATTLE_MAGIC, BATTLE_QUIT, 0, 0};
+            sendAll(w.fd, &h, sizeof(h));
+        }
+        close(w.fd);
+        w.fd = -1;
+    }
+    if (w.pid > 0) {
+        if (!quit) kill(w.pid, SIGKILL);
+        waitpid(w.pid, nullptr, 0);
+        w.pid = -1;
+    }
+}
+
+// One request/reply on one worker. Anything unexpected means the worker
+// can't be trusted to be in step with us any more.
+bool WorkerPool::exchange(Worker& w, int type, const std::vector<char>& payload,
+                          std::vector<char>& reply)
+{
+    int id = nextId++;
+    if (!sendMessage(w.fd, type, id, payload)) return false;
+
+    battle_header r;
+    return recvMessage(w.fd, r, reply) && r.id == id && r.type == type;
+}
+
+bool WorkerPool::request(int type, const std::vector<char>& payload,
+                         std::vector<char>& reply)
+{
+    Worker* w = nullptr;
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        idle.wait(guard, [&] {
+            for (Worker& c : workers)
+                if (!c.busy) { w = &c; return true; }
+            return false;
+        });
+        w->busy = true;
+    }
+
+    bool ok = false;
+    for (int attempt = 0; attempt < MAX_ATTEMPTS && !ok; ++attempt) {
+        if (w->fd < 0 && !start(*w)) continue;
+        ok = exchange(*w, type, payload, reply);
+        if (!ok) {
+            stop(*w, false);
+            nRestarts++;
+        }
+    }
+    if (!ok)
+        std::cerr << "WorkerPool: request failed after " << MAX_ATTEMPTS
+                  << " attempts\n";
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        w->busy = false;
+    }
+    idle.notify_all();
+    return ok;
+}
+
+// --------------------- Requests -----------------------------------------
+bool WorkerPool::assemble(const std::string& source, const battle_params& params,
+                          WarriorCode& code, int* status)
+{
+    std::vector<char> reply;
+    if (status) *status = BATTLE_BADREQ;
+    if (!request(BATTLE_ASSEMBLE, encodeAssemble(source, params), reply)) return false;
+    return decodeCode(reply, code, status);
+}
+
+bool WorkerPool::run(const battle_params& params,
+                     const std::vector<const WarriorCode*>& warriors,
+                     BattleScores& scores, PspaceState* pspace)
+{
+    std::vector<char> reply;
+    if (!request(pspace ? BATTLE_SESSION : BATTLE_RUN,
+                 encodeRun(params, warriors, false, pspace), reply))
+        return false;
+    return decodeScores(reply, static_cast<int>(warriors.size()), scores, pspace);
+}
@@ -0,0 +1,494 @@
+#include <ga/ga.h>
+#include "Config.h"
+#include "CoreWarEvaluator.h"
+#include "RunConfig.h"
+#include "WarriorEncoder.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <dirent.h>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Throughput benchmarks, written as JSON (stdout, or the file given with -o):
+//   simulator/*   simulator1 on canned warrior pairs, one pmars_worker
+//   evaluator     evaluateFitness on a fixed set of random genomes
+//   assembler/*   asm.c on the .red files of the warrior directories, and on
+//                 a generated warrior with a big FOR/EQU symbol table; the
+//                 sources that don't assemble under the run's parameters are
+//                 left out of the timing (failed)
+//   ga_step       GASimpleGA::step with a fitness that costs nothing; also
+//                 checks that a GA resumed from a snapshot taken halfway
+//                 ends the way the saved one did (resume_matches)
+// Every case does the same work in each of -r repetitions (fixed seeds);
+// the rates are taken from the median time. Anything after the options
+// configures the run as for corewar_ga (RunConfig.h): the evaluator and the
+// GA step use it, the simulator cases use its core size, cycles and
+// processes.
+// Usage: ./corewar_bench [-r repetitions] [-o results.json] [--config file]
+//                        [key=value ...]
+
+static const char* const CORPUS[] = { HILL_DIR, "../pmars-0.9.4/warriors" };
+static constexpr int SIM_ROUNDS = 20;    // per battle of a simulator case
+static constexpr int ASM_PASSES = 20;    // assemblies per source and repetition
+static constexpr unsigned SEED = 1;
+
+// --------------------- Canned pairs -------------------------------------
+struct Pair {
+    const char* name;
+    const char* first;
+    const char* second;
+};
+
+static const char* const IMP = "mov.i 0, 1\n";
+static const char* const LOOP = "jmp 0\n";
+static const char* const DWARF =
+    "        add.ab #4, bomb\n"
+    "        mov.i  bomb, @bomb\n"
+    "        jmp    -2\n"
+    "bomb    dat    #0, #0\n";
+static const char* const PAPER =
+    "        spl    1\n"
+    "        spl    1\n"
+    "        spl    1\n"
+    "silk    spl    @0, }400\n"
+    "        mov.i  }silk, >silk\n"
+    "        mov.i  bomb, }1777\n"
+    "        mov.i  bomb, }3999\n"
+    "bomb    dat    <2667, <5334\n";
+static const char* const SPL_BOMBER =
+    "loop    add.ab #3044, ptr\n"
+    "        mov.i  sbomb, @ptr\n"
+    "        jmp    loop\n"
+    "ptr     dat    #0, #0\n"
+    "sbomb   spl    #0, #0\n";
+
+static const Pair PAIRS[] = {
+    { "imp_vs_imp", IMP, IMP },                 // ties, two processes
+    { "dwarf_vs_paper", DWARF, PAPER },         // a typical fight
+    { "spl_bomber_vs_paper", SPL_BOMBER, PAPER },   // full process queues
+    { "loop_vs_loop", LOOP, LOOP },             // ties, nothing but jumps
+};
+
+// --------------------- Measuring ----------------------------------------
+struct Measurement {
+    std::string name;
+    std::vector<double> seconds;                        // per repetition
+    std::vector<std::pair<std::string, double>> work;   // per repetition
+    std::vector<std::string> notes;                     // "key": value, as JSON
+
+    double median() const {
+        std::vector<double> s = seconds;
+        std::sort(s.begin(), s.end());
+        size_t n = s.size();
+        return n == 0 ? 0.0 : n % 2 ? s[n/2] : (s[n/2 - 1] + s[n/2]) / 2;
+    }
+};
+
+static double timeIt(const std::function<void()>& f)
+{
+    auto start = std::chrono::steady_clock::now();
+    f();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static std::string quote(const std::string& s)
+{
+    std::string q = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') q += '\\';
+        if (static_cast<unsigned char>(c) < 0x20) {
+            char buf[8];
+            std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+            q += buf;
+        } else {
+            q += c;
+        }
+    }
+    return q + "\"";
+}
+
+static std::string number(double x)
+{
+    std::ostringstream out;
+    out.precision(10);
+    out << x;
+    return out.str();
+}
+
+// --------------------- Cases --------------------------------------------
+static bool assembleText(WorkerPool& pool, const char* source, const battle_params& params,
+                         WarriorCode& code)
+{
+    std::string s = std::string(";redcode-94\n;assert 1\n") + source + "end\n";
+    return pool.assemble(s, params, code);
+}
+
+static bool benchSimulator(WorkerPool& pool, const RunConfig& config, int repetitions,
+                           std::vector<Measurement>& out)
+{
+    battle_params params = config.battleParams();
+    params.rounds = SIM_ROUNDS;
+    params.seed = static_cast<int>(SEED);
+    for (const Pair& p : PAIRS) {
+        WarriorCode a, b;
+        if (!assembleText(pool, p.first, params, a) || !assembleText(pool, p.second, params, b)) {
+            std::cerr << "Cannot assemble the " << p.name << " pair\n";
+            return false;
+        }
+        Measurement m;
+        m.name = std::string("simulator/") + p.name;
+        BattleScores scores;
+        for (int r = 0; r < repetitions; ++r) {
+            bool ok = true;
+            m.seconds.push_back(timeIt([&] { ok = pool.run(params, {&a, &b}, scores); }));
+            if (!ok) {
+                std::cerr << "Battle " << p.name << " failed\n";
+                return false;
+            }
+        }
+        m.work = { {"battles", 1}, {"rounds", scores.rounds},
+                   {"instructions", static_cast<double>(scores.instructions)} };
+        m.notes = { "\"wins\": " + std::to_string(scores.score[0]),
+                    "\"ties\": " + std::to_string(scores.score[1]) };
+        out.push_back(m);
+    }
+    return true;
+}
+
+static void benchEvaluator(const RunConfig& config, int repetitions,
+                           std::vector<Measurement>& out)
+{
+    Measurement m;
+    m.name = "evaluator";
+    EvaluatorStats before, after, first = evaluatorStats();
+    for (int r = 0; r < repetitions; ++r) {
+        // the same genomes (and warriors: writeWarrior draws on GARandom) every time
+        GAResetRNG(SEED);
+        std::vector<GA1DArrayGenome<int>> genomes;
+        for (int i = 0; i < config.population; ++i) {
+            genomes.emplace_back(config.genomeSize());
+            initGenome(genomes.back());
+        }
+        before = evaluatorStats();
+        std::cout.setstate(std::ios::failbit);      // the evaluator's log
+        m.seconds.push_back(timeIt([&] {
+            for (const GA1DArrayGenome<int>& g : genomes) evaluateFitness(g);
+        }));
+        std::cout.clear();
+        after = evaluatorStats();
+    }
+    m.work = { {"evaluations", static_cast<double>(after.evaluations - before.evaluations)},
+               {"battles", static_cast<double>(after.battles - before.battles)},
+               {"rounds", static_cast<double>(after.rounds - before.rounds)},
+               {"instructions", static_cast<double>(after.instructions - before.instructions)} };
+
+    // How busy each battle runner was while the evaluations ran
+    double total = 0;
+    for (double t : m.seconds) total += t;
+    std::string busy;
+    std::int64_t stolen = 0;
+    for (size_t i = 0; i < after.runnerBusy.size(); ++i) {
+        double b = after.runnerBusy[i] - (i < first.runnerBusy.size() ? first.runnerBusy[i] : 0.0);
+        busy += (i ? ", " : "") + number(total > 0 ? b / total : 0.0);
+        stolen += after.runnerSteals[i] - (i < first.runnerSteals.size() ? first.runnerSteals[i] : 0);
+    }
+    m.notes = { "\"runner_utilization\": [" + busy + "]",
+                "\"stolen_battles\": " + std::to_string(stolen) };
+    out.push_back(m);
+}
+
+// FOR/ROF expansion and a big symbol table: EQUATES equates generated with
+// label concatenation, then instructions that use them
+static std::string macroHeavySource()
+{
+    static constexpr int EQUATES = 1000, INSTRUCTIONS = 90;
+    std::ostringstream s;
+    s << ";redcode-94\n;name macro heavy\n;assert 1\n"
+      << "i FOR " << EQUATES << "\n"
+      << "k&i EQU (i*7)%13\n"
+      << "ROF\n"
+      << "j FOR " << INSTRUCTIONS << "\n"
+      << "l&j mov.i #k&j, @l&j\n"
+      << "ROF\n"
+      << "end\n";
+    return s.str();
+}
+
+static std::vector<std::string> corpusSources()
+{
+    std::vector<std::string> sources;
+    for (const char* dir : CORPUS) {
+        DIR* d = opendir(dir);
+        if (!d) {
+            std::cerr << "Cannot open " << dir << "\n";
+            continue;
+        }
+        std::vector<std::string> files;
+        while (dirent* e = readdir(d)) {
+            std::string f = e->d_name;
+            if (f.size() > 4 && f.compare(f.size() - 4, 4, ".red") == 0)
+                files.push_back(std::string(dir) + "/" + f);
+        }
+        closedir(d);
+        std::sort(files.begin(), files.end());
+        for (const std::string& f : files) {
+            std::ifstream in(f, std::ios::binary);
+            std::ostringstream text;
+            text << in.rdbuf();
+            sources.push_back(text.str());
+        }
+    }
+    return sources;
+}
+
+// Each repetition assembles the sources `passes` times. The sources that
+// don't assemble (a failed ;assert under these parameters) are found first
+// and left out, so the time is that of real assemblies.
+static void benchAssembler(WorkerPool& pool, const RunConfig& config, int repetitions,
+                           const std::string& name, const std::vector<std::string>& sources,
+                           int passes, std::vector<Measurement>& out)
+{
+    const battle_params params = config.battleParams();
+    std::vector<std::string> good;
+    double bytes = 0;
+    for (const std::string& s : sources) {
+        WarriorCode code;
+        if (!pool.assemble(s, params, code)) continue;
+        good.push_back(s);
+        bytes += s.size();
+    }
+
+    Measurement m;
+    m.name = name;
+    for (int r = 0; r < repetitions; ++r) {
+        m.seconds.push_back(timeIt([&] {
+            for (int p = 0; p < passes; ++p)
+                for (const std::string& s : good) {
+                    WarriorCode code;
+                    pool.assemble(s, params, code);
+                }
+        }));
+    }
+    m.work = { {"files", static_cast<double>(good.size()) * passes},
+               {"bytes", bytes * passes} };
+    m.notes = { "\"failed\": " + std::to_string(sources.size() - good.size()) };
+    out.push_back(m);
+}
+
+static float nullFitness(GAGenome&) { return 0.0f; }
+
+// A few distinct scores, so that most individuals tie (the order of ties is
+// what a resumed GA is most likely to get wrong)
+static float tiedFitness(GAGenome& g)
+{
+    const auto& genome = static_cast<const GA1DArrayGenome<int>&>(g);
+    unsigned h = 0;
+    for (int i = 0; i < genome.length(); ++i) h = h*31 + static_cast<unsigned>(genome.gene(i));
+    return static_cast<float>(h % 4);
+}
+
+// The GA as corewar_ga sets it up, minus the battles and the log files
+static void setUpGa(GASimpleGA& ga, const RunConfig& config)
+{
+    ga.populationSize(config.population);
+    ga.nGenerations(config.generations);
+    ga.pMutation(config.mutation);
+    ga.pCrossover(config.crossover);
+    ga.selector(GAAliasSelector());
+    if (config.sharing > 0.0) {
+        GASharing share((float)config.sharing);
+        share.bucketFunction(warriorNiche);
+        share.offset(lowestFitness());
+        ga.scaling(share);
+    }
+    ga.recordDiversity(gaTrue);
+}
+
+// A GA that loads a snapshot taken halfway must end with the population the
+// saved one ended with.
+static bool gaResumeMatches(const RunConfig& config)
+{
+    GA1DArrayGenome<int> genome(config.genomeSize(), tiedFitness);
+    genome.initializer(initGenome);
+    genome.comparator(warriorDistance);
+
+    GASimpleGA ga(genome);
+    setUpGa(ga, config);
+    ga.initialize(SEED);
+    while (ga.generation() < config.generations / 2) ga.step();
+    GASnapshot snapshot;
+    if (ga.save(snapshot) != 0) return false;
+    while (!ga.done()) ga.step();
+
+    GASimpleGA resumed(genome);
+    setUpGa(resumed, config);
+    snapshot.rewind();
+    if (resumed.load(snapshot) != 0) return false;
+    while (!resumed.done()) resumed.step();
+
+    const GAPopulation& a = ga.population();
+    const GAPopulation& b = resumed.population();
+    if (a.size() != b.size()) return false;
+    for (int i = 0; i < a.size(); ++i) {
+        const auto& x = static_cast<const GA1DArrayGenome<int>&>(a.individual(i));
+        const auto& y = static_cast<const GA1DArrayGenome<int>&>(b.individual(i));
+        if (x.score() != y.score()) return false;
+        for (int k = 0; k < x.length(); ++k)
+            if (x.gene(k) != y.gene(k)) return false;
+    }
+    return true;
+}
+
+static void benchGaStep(const RunConfig& config, int repetitions, std::vector<Measurement>& out)
+{
+    Measurement m;
+    m.name = "ga_step";
+    for (int r = 0; r < repetitions; ++r) {
+        GA1DArrayGenome<int> genome(config.genomeSize(), nullFitness);
+        genome.initializer(initGenome);
+        genome.comparator(warriorDistance);
+        GASimpleGA ga(genome);
+        setUpGa(ga, config);
+        ga.initialize(SEED);
+        m.seconds.push_back(timeIt([&] { while (!ga.done()) ga.step(); }));
+    }
+    m.work = { {"generations", static_cast<double>(config.generations)},
+               {"individuals", static_cast<double>(config.generations) * config.population} };
+    const bool resumes = gaResumeMatches(config);
+    if (!resumes) std::cerr << "ga_step: a resumed GA does not repeat the saved one\n";
+    m.notes = { std::string("\"resume_matches\": ") + (resumes ? "true" : "false") };
+    out.push_back(m);
+}
+
+// --------------------- Output -------------------------------------------
+static std::string cpuModel()
+{
+    std::ifstream in("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(in, line))
+        if (line.compare(0, 10, "model name") == 0) {
+            size_t colon = line.find(':');
+            if (colon != std::string::npos) return line.substr(line.find_first_not_of(" \t", colon + 1));
+        }
+    return "unknown";
+}
+
+static void writeJson(std::ostream& out, const RunConfig& config, int repetitions,
+                      const std::vector<Measurement>& results)
+{
+    char host[256] = "unknown";
+    gethostname(host, sizeof(host) - 1);
+    char date[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+#ifdef NDEBUG
+    const char* assertions = "off";
+#else
+    const char* assertions = "on";
+#endif
+
+    out << "{\n  \"benchmark\": \"corewar_bench\",\n  \"environment\": {\n"
+        << "    \"date\": " << quote(date) << ",\n"
+        << "    \"host\": " << quote(host) << ",\n"
+        << "    \"cpu\": " << quote(cpuModel()) << ",\n"
+        << "    \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "    \"compiler\": " << quote(__VERSION__) << ",\n"
+        << "    \"assertions\": " << quote(assertions) << ",\n"
+        << "    \"pmars_worker\": " << quote(config.pmarsWorker) << ",\n"
+        << "    \"workers\": " << config.workers << ",\n"
+        << "    \"core_size\": " << config.coreSize << ",\n"
+        << "    \"cycles\": " << config.cycles << ",\n"
+        << "    \"processes\": " << config.processes << ",\n"
+        << "    \"population\": " << config.population << ",\n"
+        << "    \"generations\": " << config.generations << ",\n"
+        << "    \"racing\": " << (config.racing ? "true" : "false") << ",\n"
+        << "    \"max_rounds\": " << config.maxRounds << ",\n"
+        << "    \"simulator_rounds\": " << SIM_ROUNDS << ",\n"
+        << "    \"repetitions\": " << repetitions << ",\n"
+        << "    \"seed\": " << SEED << "\n  },\n  \"results\": [";
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Measurement& m = results[i];
+        const double t = m.median();
+        out << (i ? ",\n" : "\n") << "    {\n      \"name\": " << quote(m.name) << ",\n"
+            << "      \"median_seconds\": " << number(t) << ",\n"
+            << "      \"min_seconds\": "
+            << number(*std::min_element(m.seconds.begin(), m.seconds.end())) << ",\n"
+            << "      \"max_seconds\": "
+            << number(*std::max_element(m.seconds.begin(), m.seconds.end()));
+        for (const auto& w : m.work) {
+            out << ",\n      \"" << w.first << "\": " << number(w.second)
+                << ",\n      \"" << w.first << "_per_second\": "
+                << number(t > 0 ? w.second / t : 0.0);
+        }
+        for (const std::string& note : m.notes)
+            out << ",\n      " << note;
+        out << "\n    }";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    int repetitions = 5;
+    const char* outFile = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "+r:o:")) != -1) {
+        switch (opt) {
+        case 'r': repetitions = std::max(1, std::atoi(optarg)); break;
+        case 'o': outFile = optarg; break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-r repetitions] [-o results.json]"
+                      << " [--config file] [key=value ...]\n";
+            return 1;
+        }
+    }
+
+    // the rest configures the run, as for corewar_ga
+    std::vector<char*> rest = { argv[0] };
+    rest.insert(rest.end(), argv + optind, argv + argc);
+    RunConfig settings;
+    if (!loadRunConfig(static_cast<int>(rest.size()), rest.data(), settings)) return 1;
+    const RunConfig& config = settings;
+    initEvaluator(config);
+    setEncoderCoreSize(config.coreSize);
+
+    std::vector<Measurement> results;
+    {
+        WorkerPool pool(config.pmarsWorker, 1);
+        std::cerr << "Simulator...\n";
+        if (!benchSimulator(pool, config, repetitions, results)) return 1;
+        std::cerr << "Assembler...\n";
+        benchAssembler(pool, config, repetitions, "assembler/corpus", corpusSources(),
+                       ASM_PASSES, results);
+        benchAssembler(pool, config, repetitions, "assembler/macro_heavy",
+                       {macroHeavySource()}, ASM_PASSES, results);
+    }
+    std::cerr << "Evaluator...\n";
+    benchEvaluator(config, repetitions, results);
+    std::cerr << "GA step...\n";
+    benchGaStep(config, repetitions, results);
+
+    if (outFile) {
+        std::ofstream out(outFile);
+        writeJson(out, config, repetitions, results);
+        if (!out) {
+            std::cerr << "Cannot write " << outFile << "\n";
+            return 1;
+        }
+    } else {
+        writeJson(std::cout, config, repetitions, results);
+    }
+    return 0;
+}
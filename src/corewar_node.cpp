@@ -0,0 +1,24 @@
+#include "BattleNode.h"
+#include "Config.h"
+#include "WorkerPool.h"
+#include <cstdlib>
+#include <iostream>
+
+// Farm node: runs battles sent by a GA (BattleFarm) on the local pmars
+// workers. Start one per machine, then run the GA with
+//   COREWAR_NODES=host1:port,host2:port ./corewar_ga ...
+// Usage: ./corewar_node [port] [workers]   (workers 0 = one per core)
+int main(int argc, char* argv[])
+{
+    int port = argc > 1 ? std::atoi(argv[1]) : FARM_PORT;
+    unsigned workers = argc > 2 ? static_cast<unsigned>(std::atoi(argv[2])) : 0;
+
+    WorkerPool pool(PMARS_WORKER, workers);
+    BattleNode node(pool, port);
+    if (!node.good()) return 1;
+
+    std::cout << "corewar_node: " << pool.concurrency()
+              << " workers, listening on port " << node.port() << std::endl;
+    node.serve();
+    return 0;
+}
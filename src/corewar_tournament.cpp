@@ -0,0 +1,142 @@
+#include <ga/ga.h>
+#include "Config.h"
+#include "RunConfig.h"
+#include "Tournament.h"
+#include "WarriorEncoder.h"
+#include "WorkerPool.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Round robin over a hill (a directory of .red/.rcb files, or single files) and,
+// optionally, the population of a GA checkpoint. Prints the standings;
+// -o also writes the win/tie/loss matrix as CSV. key=value arguments set up
+// the run as for corewar_ga (RunConfig.h): give the checkpoint's run the same
+// instructions and core_size, and the battles are played under its
+// parameters.
+// Usage: ./corewar_tournament [-r rounds] [-s seed] [-c checkpoint]
+//                             [-o matrix.csv] [key=value ...]
+//                             [hill dir or .red/.rcb files...]
+
+// The warriors of a checkpointed population, as "pop<i>"
+static int addPopulation(Tournament& t, const char* checkpoint, const RunConfig& config)
+{
+    GA1DArrayGenome<int> genome(config.genomeSize());
+    GASimpleGA ga(genome);
+    if (ga.resume(checkpoint) != 0) {
+        std::cerr << "Cannot read checkpoint " << checkpoint << "\n";
+        return -1;
+    }
+    const GAPopulation& pop = ga.population();
+    int added = 0;
+    for (int i = 0; i < pop.size(); ++i) {
+        std::ostringstream source;
+        writeWarrior(static_cast<const GA1DArrayGenome<int>&>(pop.individual(i)), source);
+        if (t.add("pop" + std::to_string(i), source.str()) >= 0) added++;
+    }
+    return added;
+}
+
+static void writeMatrix(const Tournament& t, const char* file)
+{
+    std::ofstream out(file);
+    out << "warrior";
+    for (int j = 0; j < t.size(); ++j) out << "," << t.name(j);
+    out << "\n";
+    for (int i = 0; i < t.size(); ++i) {
+        out << t.name(i);
+        for (int j = 0; j < t.size(); ++j) {
+            const PairResult& r = t.result(i, j);
+            out << "," << r.wins << "/" << r.ties << "/" << r.losses;
+        }
+        out << "\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int rounds = TOURNAMENT_ROUNDS;
+    unsigned seed = 1;
+    const char* checkpoint = nullptr;
+    const char* matrixFile = nullptr;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:s:c:o:")) != -1) {
+        switch (opt) {
+        case 'r': rounds = std::atoi(optarg); break;
+        case 's': seed = static_cast<unsigned>(std::atoi(optarg)); break;
+        case 'c': checkpoint = optarg; break;
+        case 'o': matrixFile = optarg; break;
+        default:
+            std::cerr << "Usage: " << argv[0] << " [-r rounds] [-s seed] [-c checkpoint]"
+                      << " [-o matrix.csv] [key=value ...] [hill dir or .red/.rcb files...]\n";
+            return 1;
+        }
+    }
+
+    std::vector<char*> settings = { argv[0] };
+    std::vector<const char*> hill;
+    for (int a = optind; a < argc; ++a) {
+        if (std::strchr(argv[a], '=')) settings.push_back(argv[a]);
+        else hill.push_back(argv[a]);
+    }
+    RunConfig config;
+    if (!loadRunConfig(static_cast<int>(settings.size()), settings.data(), config)) return 1;
+    setEncoderCoreSize(config.coreSize);
+
+    WorkerPool pool(config.pmarsWorker, config.workers);
+    Tournament t(pool, config.battleParams());
+
+    if (checkpoint && addPopulation(t, checkpoint, config) < 0) return 1;
+    if (hill.empty())
+        t.addDirectory(HILL_DIR);
+    for (const char* file : hill) {
+        struct stat st;
+        if (stat(file, &st) == 0 && S_ISDIR(st.st_mode))
+            t.addDirectory(file);
+        else
+            t.addFile(file);
+    }
+    if (t.size() < 2) {
+        std::cerr << "Need at least two warriors\n";
+        return 1;
+    }
+
+    std::cout << t.size() << " warriors, " << t.size()*(t.size()-1)/2 << " pairs, "
+              << rounds << " rounds each, " << pool.concurrency() << " workers\n";
+    int failed = t.run(rounds, seed);
+    if (failed)
+        std::cerr << failed << " pairs could not be played\n";
+
+    std::vector<int> order(t.size());
+    for (int i = 0; i < t.size(); ++i) order[i] = i;
+    std::stable_sort(order.begin(), order.end(),
+                     [&t](int a, int b) { return t.score(a) > t.score(b); });
+
+    std::cout << "rank   score    wins   ties losses  warrior\n";
+    for (int rank = 0; rank < t.size(); ++rank) {
+        int i = order[rank];
+        PairResult total;
+        for (int j = 0; j < t.size(); ++j) {
+            total.wins += t.result(i, j).wins;
+            total.ties += t.result(i, j).ties;
+            total.losses += t.result(i, j).losses;
+        }
+        std::cout << std::setw(4) << rank + 1 << " " << std::fixed << std::setprecision(3)
+                  << std::setw(7) << t.score(i) << " " << std::setw(7) << total.wins
+                  << " " << std::setw(6) << total.ties << " " << std::setw(6) << total.losses
+                  << "  " << t.name(i) << "\n";
+    }
+
+    if (matrixFile) writeMatrix(t, matrixFile);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,485 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+// Replays a battle trace written by pmars -t or a sampled pmars_worker
+// (the format is in pmars-0.9.4/src/trace.h).
+// Usage: ./corewar_trace [--round R] [--events | --map N] <file.trc>
+//   default:  per round the outcome, how each warrior died (whose write made
+//             the cell that killed its last process) and per warrior the
+//             instructions executed, peak processes, cells written and cells
+//             it owns at the end (it wrote them last); totals at the end
+//   --events: every event, decoded
+//   --map N:  the core every N instructions: each character is a stretch of
+//             core, shown as the warrior that wrote there last ('.' nobody)
+//   --round R only round R
+
+namespace {
+
+const char* const eventName[] = { "EXEC", "READ", "WRITE", "DEC", "INC", "SPL", "DAT", "MARK" };
+
+struct Warrior {
+    std::string name;
+    int offset = 0;
+    std::vector<battle_inst> code;
+};
+
+struct Trace {
+    trace_header h;
+    std::vector<Warrior> warriors;
+    std::vector<unsigned char> events;
+};
+
+bool readTrace(const char* file, Trace& t)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in) {
+        std::cerr << "Cannot open " << file << "\n";
+        return false;
+    }
+    if (!in.read(reinterpret_cast<char*>(&t.h), sizeof(t.h)) || t.h.magic != TRACE_MAGIC) {
+        std::cerr << file << " is not a battle trace\n";
+        return false;
+    }
+    if (t.h.version != TRACE_VERSION || t.h.byteOrder != BATTLE_BYTEORDER ||
+        t.h.coreSize < 1 || t.h.warriors < 1 || t.h.warriors > 36) {
+        std::cerr << file << " is a battle trace this reader can't read\n";
+        return false;
+    }
+    t.warriors.resize(t.h.warriors);
+    for (Warrior& w : t.warriors) {
+        trace_warrior tw;
+        if (!in.read(reinterpret_cast<char*>(&tw), sizeof(tw)) ||
+            tw.length < 0 || tw.nameLen < 0 || tw.nameLen > 4096) {
+            std::cerr << file << " is cut short\n";
+            return false;
+        }
+        w.name.resize(tw.nameLen);
+        w.code.resize(tw.length);
+        w.offset = tw.offset;
+        if (!in.read(&w.name[0], tw.nameLen) ||
+            !in.read(reinterpret_cast<char*>(w.code.data()), tw.length * sizeof(battle_inst))) {
+            std::cerr << file << " is cut short\n";
+            return false;
+        }
+    }
+    t.events.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// One event of the stream, decoded
+struct Event {
+    int kind = TR_MARK;
+    int mark = TRM_STOP;         // TR_MARK
+    int warrior = 0;             // executing (TRM_WARRIOR: the one named)
+    long addr = 0;               // address events
+    std::vector<long> values;    // TRM_ROUND, TRM_END
+};
+
+// Decodes the event stream, keeping track of whose turn it is and where each
+// warrior executed last the way trace.c does
+class Decoder {
+public:
+    explicit Decoder(const Trace& t) : t_(t), lastExec_(t.h.warriors), alive_(t.h.warriors) {}
+
+    // false at TRM_STOP or the end of the data (truncated() says which)
+    bool next(Event& e)
+    {
+        if (at_ >= t_.events.size()) {
+            truncated_ = true;
+            return false;
+        }
+        int tag = t_.events[at_++];
+        e.kind = TR_KIND(tag);
+        e.values.clear();
+        if (e.kind == TR_MARK) {
+            e.mark = TR_ARG(tag);
+            e.warrior = current_;
+            switch (e.mark) {
+            case TRM_DIE:
+                alive_[current_] = false;
+                break;
+            case TRM_WARRIOR:
+                e.warrior = next_ = static_cast<int>(varint());
+                if (next_ >= t_.h.warriors) return fail();
+                break;
+            case TRM_ROUND:
+                startRound(e);
+                if (truncated_) return false;
+                break;
+            case TRM_END:
+                e.values.push_back(varint());
+                break;
+            case TRM_STOP:
+                return false;
+            default:
+                return fail();
+            }
+            return !truncated_;
+        }
+        if (e.kind == TR_EXEC) {
+            int w = next_ >= 0 ? next_ : successor();
+            next_ = -1;
+            current_ = w;
+            e.addr = exec_ = fold(lastExec_[w] + distance(tag));
+            lastExec_[w] = exec_;
+        } else if (e.kind <= TR_INC) {
+            e.addr = fold(exec_ + distance(tag));
+        }
+        e.warrior = current_;
+        return !truncated_;
+    }
+
+    bool truncated() const { return truncated_; }
+
+private:
+    unsigned long varint()
+    {
+        unsigned long v = 0;
+        for (int shift = 0; at_ < t_.events.size() && shift < 64; shift += 7) {
+            unsigned char b = t_.events[at_++];
+            v |= static_cast<unsigned long>(b & 0x7f) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        truncated_ = true;
+        return 0;
+    }
+
+    long distance(int tag)
+    {
+        unsigned long z = TR_ARG(tag);
+        if (z == TR_BIG) z = varint();
+        return z & 1 ? -static_cast<long>(z >> 1) - 1 : static_cast<long>(z >> 1);
+    }
+
+    long fold(long a) const { return ((a % t_.h.coreSize) + t_.h.coreSize) % t_.h.coreSize; }
+
+    int successor() const
+    {
+        int w = current_;
+        do {
+            if (++w == t_.h.warriors) w = 0;
+        } while (!alive_[w] && w != current_);
+        return w;
+    }
+
+    void startRound(Event& e)
+    {
+        e.values.push_back(varint());                   // round
+        long starter = static_cast<long>(varint());
+        e.values.push_back(starter);
+        for (int i = 0; i < t_.h.warriors; ++i) {
+            long pos = static_cast<long>(varint());
+            e.values.push_back(pos);
+            lastExec_[i] = fold(pos + t_.warriors[i].offset);
+            alive_[i] = true;
+        }
+        if (starter >= t_.h.warriors) {
+            fail();
+            return;
+        }
+        current_ = static_cast<int>((starter + t_.h.warriors - 1) % t_.h.warriors);
+        next_ = -1;
+    }
+
+    bool fail()
+    {
+        truncated_ = true;
+        return false;
+    }
+
+    const Trace& t_;
+    size_t at_ = 0;
+    std::vector<long> lastExec_;
+    std::vector<bool> alive_;
+    int current_ = 0, next_ = -1;
+    long exec_ = 0;
+    bool truncated_ = false;
+};
+
+// --------------------- Replay ---
+
+struct WarriorRound {
+    long executed = 0, writes = 0, processes = 1, peak = 1, owned = 0;
+    long diedAt = -1;            // instruction of the round, -1 alive
+    long diedCell = 0;
+    int killer = -1;             // who wrote the cell it died on last, -1 nobody
+    long killerAt = -1;          // when
+};
+
+struct Totals {
+    long wins = 0, ties = 0, losses = 0;
+    std::vector<long> killedBy;  // by warrior, the last one: core never written
+};
+
+class Replay {
+public:
+    Replay(const Trace& t, int onlyRound, long mapEvery)
+        : t_(t), onlyRound_(onlyRound), mapEvery_(mapEvery),
+          owner_(t.h.coreSize), written_(t.h.coreSize), w_(t.h.warriors), totals_(t.h.warriors)
+    {
+        for (Totals& tt : totals_) tt.killedBy.assign(t.h.warriors + 1, 0);
+    }
+
+    void event(const Event& e)
+    {
+        if (e.kind == TR_MARK && e.mark == TRM_ROUND) {
+            startRound(e);
+            return;
+        }
+        if (!showing()) return;
+        WarriorRound& w = w_[e.warrior];
+        switch (e.kind) {
+        case TR_EXEC:
+            ++w.executed;
+            ++instruction_;
+            if (mapEvery_ > 0 && instruction_ % mapEvery_ == 0) map();
+            break;
+        case TR_WRITE:
+        case TR_DEC:
+        case TR_INC:
+            ++w.writes;
+            owner_[e.addr] = e.warrior;
+            written_[e.addr] = instruction_;
+            break;
+        case TR_SPL:
+            w.peak = std::max(w.peak, ++w.processes);
+            break;
+        case TR_DAT:
+            --w.processes;
+            w.diedCell = lastExecCell(e.warrior);
+            break;
+        case TR_MARK:
+            if (e.mark == TRM_DIE) {
+                w.diedAt = instruction_;
+                w.killer = owner_[w.diedCell];
+                w.killerAt = written_[w.diedCell];
+            } else if (e.mark == TRM_END)
+                endRound(e.values.empty() ? 0 : e.values[0]);
+            break;
+        }
+        if (e.kind == TR_EXEC) exec_[e.warrior] = e.addr;
+    }
+
+    void finish(bool truncated) const
+    {
+        if (truncated) std::cout << "(the trace is cut short)\n";
+        if (mapEvery_ > 0 || rounds_ == 0) return;
+        std::cout << "\n" << rounds_ << " round(s) of " << t_.h.rounds << " traced\n";
+        for (int i = 0; i < t_.h.warriors; ++i) {
+            const Totals& tt = totals_[i];
+            std::cout << "  " << name(i) << ": " << tt.wins << " won, " << tt.ties << " tied, "
+                      << tt.losses << " lost";
+            bool first = true;
+            for (int k = 0; k <= t_.h.warriors; ++k) {
+                if (!tt.killedBy[k]) continue;
+                std::cout << (first ? "; died on cells written by " : ", ")
+                          << (k == t_.h.warriors ? std::string("nobody") : name(k))
+                          << " x" << tt.killedBy[k];
+                first = false;
+            }
+            std::cout << "\n";
+        }
+    }
+
+private:
+    bool showing() const { return round_ > 0 && (onlyRound_ == 0 || round_ == onlyRound_); }
+
+    std::string name(int i) const
+    {
+        const std::string& n = t_.warriors[i].name;
+        return n.empty() ? "warrior " + std::to_string(i) : std::to_string(i) + " " + n;
+    }
+
+    long lastExecCell(int w) const { return exec_[w]; }
+
+    void startRound(const Event& e)
+    {
+        round_ = static_cast<int>(e.values[0]);
+        if (!showing()) return;
+        instruction_ = 0;
+        std::fill(owner_.begin(), owner_.end(), -1);
+        std::fill(written_.begin(), written_.end(), -1);
+        exec_.assign(t_.h.warriors, 0);
+        for (int i = 0; i < t_.h.warriors; ++i) {
+            w_[i] = WarriorRound();
+            long pos = e.values[2 + i];
+            for (size_t j = 0; j < t_.warriors[i].code.size(); ++j)
+                owner_[(pos + j) % t_.h.coreSize] = i;
+        }
+        if (mapEvery_ > 0) {
+            std::cout << "Round " << round_ << ", " << name(static_cast<int>(e.values[1]))
+                      << " starts\n";
+            map();
+        }
+    }
+
+    void endRound(long left)
+    {
+        for (int c = 0; c < t_.h.coreSize; ++c)
+            if (owner_[c] >= 0) ++w_[owner_[c]].owned;
+
+        std::vector<int> survivors;
+        for (int i = 0; i < t_.h.warriors; ++i)
+            if (w_[i].diedAt < 0) survivors.push_back(i);
+        ++rounds_;
+        for (int i = 0; i < t_.h.warriors; ++i) {
+            Totals& tt = totals_[i];
+            if (w_[i].diedAt >= 0) {
+                ++tt.losses;
+                ++tt.killedBy[w_[i].killer >= 0 ? w_[i].killer : t_.h.warriors];
+            } else if (survivors.size() == 1 && t_.h.warriors > 1)
+                ++tt.wins;
+            else
+                ++tt.ties;
+        }
+        if (mapEvery_ > 0) {
+            map();
+            return;
+        }
+
+        std::cout << "Round " << round_ << ": " << instruction_ << " instructions, ";
+        if (survivors.size() == 1 && t_.h.warriors > 1)
+            std::cout << name(survivors[0]) << " wins";
+        else if (survivors.empty())
+            std::cout << "nobody left";
+        else
+            std::cout << survivors.size() << " left (tie)";
+        if (static_cast<long>(survivors.size()) != left)
+            std::cout << " (pmars counted " << left << ")";
+        std::cout << "\n";
+        for (int i = 0; i < t_.h.warriors; ++i) {
+            const WarriorRound& w = w_[i];
+            std::cout << "  " << name(i) << ": " << w.executed << " executed, peak "
+                      << w.peak << " processes, " << w.writes << " writes, owns " << w.owned
+                      << " cells";
+            if (w.diedAt >= 0) {
+                std::cout << "; died at " << w.diedAt << " executing " << w.diedCell << ", ";
+                if (w.killer < 0)
+                    std::cout << "a cell nobody wrote";
+                else
+                    std::cout << "written by " << (w.killer == i ? "itself" : name(w.killer))
+                              << (w.killerAt < 0 ? " (its code)" : " at " + std::to_string(w.killerAt));
+            } else
+                std::cout << "; " << w.processes << " processes at the end";
+            std::cout << "\n";
+        }
+    }
+
+    void map() const
+    {
+        const int cols = 64, rows = 16;
+        long per = (t_.h.coreSize + cols * rows - 1) / (cols * rows);
+        std::cout << "  at " << instruction_ << ":";
+        for (int i = 0; i < t_.h.warriors; ++i)
+            std::cout << " " << mapChar(i) << "=" << w_[i].processes;
+        std::cout << "\n";
+        for (long c = 0; c < t_.h.coreSize; c += per * cols) {
+            std::cout << "  ";
+            for (long x = c; x < std::min<long>(c + per * cols, t_.h.coreSize); x += per) {
+                int who = -1;
+                long when = -2;
+                for (long k = x; k < std::min<long>(x + per, t_.h.coreSize); ++k)
+                    if (owner_[k] >= 0 && written_[k] > when) {
+                        who = owner_[k];
+                        when = written_[k];
+                    }
+                std::cout << (who < 0 ? '.' : mapChar(who));
+            }
+            std::cout << "\n";
+        }
+    }
+
+    static char mapChar(int w) { return w < 10 ? static_cast<char>('0' + w) : static_cast<char>('a' + w - 10); }
+
+    const Trace& t_;
+    int onlyRound_;
+    long mapEvery_;
+    int round_ = 0, rounds_ = 0;
+    long instruction_ = 0;
+    std::vector<int> owner_;
+    std::vector<long> written_;
+    std::vector<long> exec_;
+    std::vector<WarriorRound> w_;
+    std::vector<Totals> totals_;
+};
+
+void dumpEvents(const Trace& t, int onlyRound)
+{
+    Decoder d(t);
+    Event e;
+    int round = 0;
+    long instruction = 0;
+    while (d.next(e)) {
+        if (e.kind == TR_MARK && e.mark == TRM_ROUND) {
+            round = static_cast<int>(e.values[0]);
+            instruction = 0;
+        }
+        if (onlyRound && round != onlyRound) continue;
+        if (e.kind == TR_EXEC) ++instruction;
+        std::cout << instruction << " w" << e.warrior << " ";
+        if (e.kind != TR_MARK) {
+            std::cout << eventName[e.kind];
+            if (e.kind <= TR_INC) std::cout << " " << e.addr;
+        } else if (e.mark == TRM_ROUND) {
+            std::cout << "ROUND " << e.values[0] << " starter " << e.values[1] << " at";
+            for (size_t i = 2; i < e.values.size(); ++i) std::cout << " " << e.values[i];
+        } else if (e.mark == TRM_END)
+            std::cout << "END " << e.values[0] << " left";
+        else if (e.mark == TRM_DIE)
+            std::cout << "DIE";
+        else
+            std::cout << "TURN";
+        std::cout << "\n";
+    }
+    if (d.truncated()) std::cout << "(the trace is cut short)\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int onlyRound = 0;
+    long mapEvery = 0;
+    bool events = false;
+    const char* file = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--events") == 0) events = true;
+        else if (std::strcmp(argv[i], "--map") == 0 && i + 1 < argc) mapEvery = std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--round") == 0 && i + 1 < argc) onlyRound = std::atoi(argv[++i]);
+        else file = argv[i];
+    }
+    if (!file || mapEvery < 0 || (events && mapEvery)) {
+        std::cerr << "Usage: " << argv[0] << " [--round R] [--events | --map N] <file.trc>\n";
+        return 1;
+    }
+
+    Trace t;
+    if (!readTrace(file, t)) return 1;
+
+    std::cout << "Core " << t.h.coreSize << ", " << t.h.cycles << " cycles, "
+              << t.h.processes << " processes, " << t.h.rounds << " rounds\n";
+    for (int i = 0; i < t.h.warriors; ++i)
+        std::cout << "  " << i << " " << (t.warriors[i].name.empty() ? "-" : t.warriors[i].name)
+                  << ": " << t.warriors[i].code.size() << " instructions\n";
+
+    if (events) {
+        dumpEvents(t, onlyRound);
+        return 0;
+    }
+    Replay r(t, onlyRound, mapEvery);
+    Decoder d(t);
+    Event e;
+    while (d.next(e)) r.event(e);
+    r.finish(d.truncated());
+    return 0;
+}
@@ -2,17 +2,19 @@
 #include "CoreWarEvaluator.h"
 #include "WarriorEncoder.h"
 #include "Config.h"
+#include "Checkpoint.h"
+#include "HallOfFame.h"
+#include "Surrogate.h"
+#include "RunConfig.h"
+#include <algorithm>
 #include <iostream>
-#include <cstdlib> // for atof, atoi
-
-// Default GA parameters
-static int population = 20;
-static int generations = 100;
-static double mutation = 0.05;
-static double crossover = 0.9;
+#include <memory>
+#include <thread>
 
 static float fitnessWrapper(GAGenome& g);
-static void parse_input_arguments(int argc, char* argv[]);
+static bool parse_input_arguments(int argc, char* argv[], RunConfig& config);
+static void updateHallOfFame(GASimpleGA& ga);
+static void reportRunners();
 
 // GA fitness wrapper
 float fitnessWrapper(GAGenome& g)
@@ -21,46 +23,172 @@ float fitnessWrapper(GAGenome& g)
     return evaluateFitness(genome);
 }
 
-void parse_input_arguments(int argc, char* argv[])
+bool parse_input_arguments(int argc, char* argv[], RunConfig& config)
 {
-    // Parse command line arguments
-    // Usage: ./corewar_ga <population> <generations> <mutation> <crossover>
-    if (argc > 1) population = std::atoi(argv[1]);
-    if (argc > 2) generations = std::atoi(argv[2]);
-    if (argc > 3) mutation = std::atof(argv[3]);
-    if (argc > 4) crossover = std::atof(argv[4]);
+    // Parse command line arguments (see RunConfig.h)
+    // Usage: ./corewar_ga [--config file] [key=value ...]
+    //                     <population> <generations> <mutation> <crossover> [sharing] [checkpoint]
+    if (!loadRunConfig(argc, argv, config)) {
+        std::cerr << "Usage: " << argv[0] << " [--config file] [key=value ...] <population>"
+                  << " <generations> <mutation> <crossover> [sharing] [checkpoint]\n";
+        return false;
+    }
 
     std::cout << "GA parameters:\n";
-    std::cout << "Population: " << population
-              << ", Generations: " << generations
-              << ", Mutation: " << mutation
-              << ", Crossover: " << crossover << "\n";
+    std::cout << "Population: " << config.population
+              << ", Generations: " << config.generations
+              << ", Mutation: " << config.mutation
+              << ", Crossover: " << config.crossover
+              << ", Sharing: " << config.sharing << "\n";
+    if (!config.resume.empty())
+        std::cout << "Resuming from: " << config.resume << "\n";
+    std::cout << "Run configuration:\n";
+    printRunConfig(std::cout, config);
+    return true;
 }
 
-int main(int argc, char* argv[])
+// The best warrior goes into the hall of fame. If that changes it, every
+// score is out of date: score the population again (only the battles
+// against the new member are played, the rest comes from the matrix).
+void updateHallOfFame(GASimpleGA& ga)
 {
+    auto& best = static_cast<GA1DArrayGenome<int>&>(ga.population().best());
+    if (!addToHallOfFame(best)) return;
 
-    parse_input_arguments(argc, argv);
+    GAPopulation& pop = const_cast<GAPopulation&>(ga.population());
+    for (int i = 0; i < pop.size(); ++i)
+        pop.individual(i).evaluate(gaTrue);
+    pop.evaluate(gaTrue);   // statistics and sort order are stale too
+}
+
+// How busy the battle runners were over the run, and how much the
+// scheduler had to move between them.
+void reportRunners()
+{
+    EvaluatorStats stats = evaluatorStats();
+    if (stats.runnerSeconds <= 0) return;
+    std::int64_t jobs = 0, stolen = 0;
+    std::cout << "Battle runners busy:";
+    for (size_t i = 0; i < stats.runnerBusy.size(); ++i) {
+        std::cout << " " << static_cast<int>(100.0 * stats.runnerBusy[i] / stats.runnerSeconds + 0.5) << "%";
+        jobs += stats.runnerJobs[i];
+        stolen += stats.runnerSteals[i];
+    }
+    std::cout << " (" << jobs << " battles, " << stolen << " stolen)\n";
+    if (stats.failedBattles > 0)
+        std::cout << stats.failedBattles << " battles could not be played\n";
+}
+
+int main(int argc, char* argv[])
+{
+    RunConfig settings;
+    if (!parse_input_arguments(argc, argv, settings)) return 1;
+    const RunConfig& config = settings;   // fixed from here on
+    initEvaluator(config);
+    setEncoderCoreSize(config.coreSize);
 
     // Create a genome and use Dwarf-based initialization
-    GA1DArrayGenome<int> genome(GENOME_SIZE, fitnessWrapper);
+    GA1DArrayGenome<int> genome(config.genomeSize(), fitnessWrapper);
     genome.initializer(initGenome);
+    // Distance over the decoded opcodes (diversity and sharing). It replaces
+    // the element comparator, so GALib's vectorized gene count isn't used.
+    genome.comparator(warriorDistance);
 
     // Configure GA
     GASimpleGA ga(genome);
-    ga.populationSize(population);
-    ga.nGenerations(generations);
-    ga.pMutation(mutation);
-    ga.pCrossover(crossover);
+    ga.populationSize(config.population);
+
+    // The population goes in before selector and scaling (setting the
+    // population replaces those). GASimpleGA rewrites its genomes in place,
+    // so the diversity table (recordDiversity below) is computed afresh every
+    // generation: spread it over one thread per worker.
+    GAPopulation pop(genome, config.population);
+    pop.diversityThreads(config.workers > 0 ? config.workers
+                                            : std::max(1u, std::thread::hardware_concurrency()));
+
+    // Surrogate pre-screening of offspring: it is the population evaluator
+    std::unique_ptr<Surrogate> surrogate;
+    if (config.surrogateFraction > 0.0f) {
+        surrogate = std::make_unique<Surrogate>(config.surrogateFraction,
+                                                config.surrogateExplore);
+        surrogate->install(pop);
+    }
+    ga.population(pop);
+    ga.nGenerations(config.generations);
+    ga.pMutation(config.mutation);
+    ga.pCrossover(config.crossover);
+
+    // Fitness-proportional selection via alias tables (no sort per generation)
+    ga.selector(GAAliasSelector());
+
+    // Fitness sharing on the decoded code, compared within the band buckets
+    if (config.sharing > 0.0) {
+        GASharing share((float)config.sharing);
+        share.bucketFunction(warriorNiche);
+        share.offset(lowestFitness());   // the scores can be negative
+        ga.scaling(share);
+    }
+
+    // Per-generation scores as a binary columnar log (read it with ./scorelog)
+    ga.scoreFilename("generations.gasl");
+    ga.scoreFormat(GAStatistics::BinaryScores);
+    ga.selectScores(GAStatistics::AllScores);
+    ga.recordDiversity(gaTrue);
+    ga.flushFrequency(10);
+
+    // Co-evolution against a hall of fame of past best warriors
+    std::unique_ptr<HallOfFame> hof;
+    if (config.hallOfFame > 0) {
+        battle_params params = config.battleParams();
+        params.rounds = config.hofRounds;
+        hof = std::make_unique<HallOfFame>(config.hallOfFame, params);
+        if (hof->load(config.hofFile))
+            std::cout << "Hall of fame: " << hof->members().size() << " members, "
+                      << hof->results().size() << " results from " << config.hofFile << "\n";
+        useHallOfFame(hof.get());
+    }
+
+    // Run GA. A resumed run takes population, scores, statistics, RNG state
+    // and the evaluation count from the checkpoint; only the generation limit
+    // comes from the command line (so a finished run can be extended).
+    Checkpointer checkpoint(config.checkpointFile);
+    if (!config.resume.empty()) {
+        std::int64_t evaluations;
+        if (!resumeCheckpoint(ga, config.resume, evaluations, surrogate.get())) {
+            std::cerr << "Cannot resume from " << config.resume << "\n";
+            return 1;
+        }
+        resumeEvaluations(evaluations);
+        ga.nGenerations(config.generations);
+        std::cout << "Resumed at generation " << ga.generation()
+                  << ", evaluation " << evaluations << "\n";
+    } else {
+        ga.initialize(config.seed);
+        if (hof) updateHallOfFame(ga);
+        checkpoint.save(ga, evaluatorStats().evaluations, surrogate.get());
+    }
 
-    // Run GA
-    ga.evolve();
+    while (!ga.done()) {
+        ga.step();
+        if (hof) updateHallOfFame(ga);
+        if (ga.generation() % config.checkpointInterval == 0) {
+            checkpoint.save(ga, evaluatorStats().evaluations, surrogate.get());
+            if (hof) hof->save(config.hofFile);
+        }
+    }
+    if (hof) hof->save(config.hofFile);
+    ga.flushScores();
+    // Save the finished run too, so it can be extended from its last generation
+    checkpoint.save(ga, evaluatorStats().evaluations, surrogate.get());
+    checkpoint.wait();
 
     // Write best warrior
     auto& best = static_cast<GA1DArrayGenome<int>&>(ga.population().best());
     writeWarrior(best, "best.red");
 
     std::cout << "Best fitness: " << best.score() << std::endl;
+    reportRunners();
+    if (surrogate) surrogate->report();
 
     return 0;
 }
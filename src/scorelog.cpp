@@ -0,0 +1,89 @@
+#include <ga/GAScoreLog.h>
+#include <ga/GAStatistics.h>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+// Reader for the binary score log written by GAStatistics (BinaryScores).
+// Usage: ./scorelog [--csv] <file>
+//   default: one line summary per column (first, last, min, max)
+//   --csv:   every generation as CSV on stdout
+
+static const char* columnName[GAScoreLog::NCOLUMNS] = {
+    "mean", "max", "min", "dev", "diversity", "best"
+};
+
+static void writeCsv(GAScoreLogReader& in)
+{
+    std::cout << "generation";
+    for (const char* name : columnName) std::cout << "," << name;
+    std::cout << ",evaluations\n";
+
+    GAScoreRow r;
+    while (in.next(r)) {
+        std::cout << r.gen;
+        for (int k = 0; k < GAScoreLog::NCOLUMNS; ++k) {
+            std::cout << ",";
+            if (r.columns & (1 << k)) std::cout << r.col[k];
+        }
+        std::cout << ",";
+        if (r.columns & GAStatistics::Evaluations) std::cout << (unsigned long)r.evals;
+        std::cout << "\n";
+    }
+}
+
+static void writeSummary(GAScoreLogReader& in)
+{
+    GAScoreRow r, first, last;
+    float lo[GAScoreLog::NCOLUMNS], hi[GAScoreLog::NCOLUMNS];
+    int seen = 0;
+    long rows = 0;
+
+    while (in.next(r)) {
+        if (rows == 0) first = r;
+        for (int k = 0; k < GAScoreLog::NCOLUMNS; ++k) {
+            if (!(r.columns & (1 << k))) continue;
+            if (!(seen & (1 << k))) lo[k] = hi[k] = r.col[k];
+            lo[k] = std::min(lo[k], r.col[k]);
+            hi[k] = std::max(hi[k], r.col[k]);
+        }
+        seen |= r.columns;
+        last = r;
+        rows++;
+    }
+
+    std::cout << "Generations: " << rows;
+    if (rows > 0) std::cout << " (" << first.gen << " - " << last.gen << ")";
+    std::cout << "\n";
+    if (rows == 0) return;
+
+    for (int k = 0; k < GAScoreLog::NCOLUMNS; ++k) {
+        if (!(seen & (1 << k))) continue;
+        std::cout << columnName[k]
+                  << ": first " << first.col[k] << ", last " << last.col[k]
+                  << ", min " << lo[k] << ", max " << hi[k] << "\n";
+    }
+    if (last.columns & GAStatistics::Evaluations)
+        std::cout << "evaluations: " << (unsigned long)last.evals << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+    bool csv = false;
+    const char* file = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--csv") == 0) csv = true;
+        else file = argv[i];
+    }
+    if (!file) {
+        std::cerr << "Usage: " << argv[0] << " [--csv] <scorelog>\n";
+        return 1;
+    }
+
+    GAScoreLogReader in(file);
+    if (!in.good()) return 1;
+
+    if (csv) writeCsv(in);
+    else writeSummary(in);
+    return 0;
+}